@@ -88,9 +88,11 @@ from ._common import ZombieProcess
 from ._common import memoize_when_activated
 from ._common import wrap_numbers as _wrap_numbers
 from ._compat import PY3 as _PY3
+from ._compat import Mapping as _Mapping
 from ._compat import PermissionError
 from ._compat import ProcessLookupError
 from ._compat import SubprocessTimeoutExpired as _SubprocessTimeoutExpired
+from ._compat import basestring as _basestring
 from ._compat import long
 
 
@@ -178,10 +180,11 @@ __all__ = [
     # "RLIMIT_NICE", "RLIMIT_RTPRIO", "RLIMIT_RTTIME", "RLIMIT_SIGPENDING",
 
     # classes
-    "Process", "Popen",
+    "Process", "Popen", "BaselineStore",
 
     # functions
-    "pid_exists", "pids", "process_iter", "wait_procs",             # proc
+    "pid_exists", "pids", "pids_since", "process_iter", "wait_procs",  # proc
+    "oneshot_many",
     "virtual_memory", "swap_memory",                                # memory
     "cpu_times", "cpu_percent", "cpu_times_percent", "cpu_count",   # cpu
     "cpu_stats",  # "cpu_freq", "getloadavg"
@@ -189,7 +192,7 @@ __all__ = [
     "net_if_stats",
     "disk_io_counters", "disk_partitions", "disk_usage",            # disk
     # "sensors_temperatures", "sensors_battery", "sensors_fans"     # sensors
-    "users", "boot_time",                                           # others
+    "users", "boot_time", "collect",                                # others
 ]
 
 
@@ -290,6 +293,25 @@ def _pprint_secs(secs):
     return datetime.datetime.fromtimestamp(secs).strftime(fmt)
 
 
+def _filter_names(rawdict, match):
+    """Apply a name filter (see _common.name_filter()) to a
+    {device_name: ...} dict returned by platforms whose implementation
+    doesn't filter devices while parsing (Linux does).
+    """
+    if match is None or LINUX:
+        return rawdict
+    return dict((k, v) for k, v in rawdict.items() if match(k))
+
+
+def _nowrap_name(name, include, exclude):
+    """Name of the wrap_numbers() cache for a (possibly filtered)
+    call. Filtered calls track their subset of devices separately.
+    """
+    if include is None and exclude is None:
+        return name
+    return "%s:%r" % (name, (include, exclude))
+
+
 # =====================================================================
 # --- Process class
 # =====================================================================
@@ -356,6 +378,7 @@ class Process(object):
         self._last_sys_cpu_times = None
         self._last_proc_cpu_times = None
         self._exitcode = _SENTINEL
+        self._exit_rusage = None
         # cache creation time for later use in is_running() method
         try:
             self.create_time()
@@ -505,19 +528,11 @@ class Process(object):
         AccessDenied or ZombieProcess exception is raised when
         retrieving that particular process information.
         """
-        valid_names = _as_dict_attrnames
         if attrs is not None:
-            if not isinstance(attrs, (list, tuple, set, frozenset)):
-                raise TypeError("invalid attrs type %s" % type(attrs))
-            attrs = set(attrs)
-            invalid_names = attrs - valid_names
-            if invalid_names:
-                raise ValueError("invalid attr name%s %s" % (
-                    "s" if len(invalid_names) > 1 else "",
-                    ", ".join(map(repr, invalid_names))))
+            attrs = set(_check_attrs(attrs))
 
         retdict = {}
-        ls = attrs or valid_names
+        ls = attrs or _as_dict_attrnames
         with self.oneshot():
             for name in ls:
                 try:
@@ -829,6 +844,16 @@ class Process(object):
                         cpus = tuple(range(len(cpu_times(percpu=True))))
                 self._proc.cpu_affinity_set(list(set(cpus)))
 
+    # Linux only
+    if hasattr(_psplatform.Process, "cpu_affinity_mask"):
+
+        def cpu_affinity_mask(self):
+            """Return process CPU affinity as an integer bitmask where
+            bit N is set if the process is allowed to run on CPU N.
+            Cheaper than cpu_affinity() on systems with many CPUs.
+            """
+            return self._proc.cpu_affinity_mask()
+
     # Linux, FreeBSD, SunOS
     if hasattr(_psplatform.Process, "cpu_num"):
 
@@ -878,6 +903,37 @@ class Process(object):
             """
             return self._proc.threads()
 
+    # Linux only
+    if hasattr(_psplatform.Process, "ns_pids"):
+
+        def ns_pids(self):
+            """Return the PIDs of this process in each PID namespace it
+            belongs to, from ours to the innermost one (e.g. the PID
+            inside a container). The list has only one element if the
+            process isn't in a nested namespace.
+            """
+            return self._proc.ns_pids()
+
+    # Linux only
+    if hasattr(_psplatform.Process, "sample_thread_states"):
+
+        def sample_thread_states(self, hz=100, duration=1.0):
+            """Sample the state of all process threads *hz* times per
+            second for *duration* seconds, and return where threads
+            spent their time as a list of
+            (status, wchan, syscall, samples, percent) namedtuples
+            sorted by *samples*, where *wchan* is the kernel function
+            and *syscall* the syscall number threads were blocked in.
+            Sampling is done in C without holding the GIL, and this
+            call blocks for *duration* seconds.
+            """
+            if hz <= 0:
+                raise ValueError("hz is not positive (got %r)" % hz)
+            if duration < 0:
+                raise ValueError("duration is not positive (got %r)" %
+                                 duration)
+            return self._proc.sample_thread_states(hz, duration)
+
     @_assert_pid_not_reused
     def children(self, recursive=False):
         """Return the children of this process as a list of Process
@@ -1082,6 +1138,19 @@ class Process(object):
         """
         return self._proc.memory_full_info()
 
+    # Linux only
+    if hasattr(_psplatform.Process, "memory_info_status"):
+
+        def memory_info_status(self):
+            """Return a (rss_anon, rss_file, rss_shmem, swap, hwm)
+            namedtuple, in bytes, where RSS is split into anonymous,
+            file-backed and shared memory, and hwm is the peak RSS.
+            Unlike memory_full_info() this doesn't need to walk the
+            process address space, so it's as cheap as memory_info()
+            and it's a better choice to get *swap* for many processes.
+            """
+            return self._proc.memory_info_status()
+
     def memory_percent(self, memtype="rss"):
         """Compare process memory to total physical system memory and
         calculate process memory utilization as a percentage.
@@ -1139,6 +1208,24 @@ class Process(object):
                 nt = _psplatform.pmmap_ext
                 return [nt(*x) for x in it]
 
+    # Linux only
+    if hasattr(_psplatform.Process, "working_set"):
+
+        def working_set(self, interval=1.0, method=None):
+            """Estimate the process working set size, that is the
+            amount of memory (in bytes) it accesses during *interval*
+            seconds, which is usually a lot less than RSS. This call
+            blocks for *interval* seconds.
+
+            *method* can be "page_idle" (requires root and a kernel
+            with idle page tracking support), "clear_refs" or None
+            to use "page_idle" if available.
+            """
+            if interval < 0:
+                raise ValueError("interval is not positive (got %r)" %
+                                 interval)
+            return self._proc.working_set(interval, method=method)
+
     def open_files(self):
         """Return files opened by process as a list of
         (path, fd) namedtuples including the absolute file name
@@ -1249,7 +1336,7 @@ class Process(object):
         else:  # pragma: no cover
             self._proc.kill()
 
-    def wait(self, timeout=None):
+    def wait(self, timeout=None, rusage=False):
         """Wait for process to terminate and, if process is a children
         of os.getpid(), also return its exit code, else None.
         On Windows there's no such limitation (exit code is always
@@ -1261,13 +1348,27 @@ class Process(object):
         If *timeout* (in seconds) is specified and process is still
         alive raise TimeoutExpired.
 
+        If *rusage* is True (POSIX only) return a (exit_code, rusage)
+        tuple instead, where rusage is a namedtuple with the CPU
+        times, peak RSS, page faults and context switches of the
+        terminated process, as returned by wait4(2). rusage is None
+        if the process is not a children of os.getpid() or if it
+        was already reaped by a previous wait() without *rusage*.
+
         To wait for multiple Process(es) use psutil.wait_procs().
         """
         if timeout is not None and not timeout >= 0:
             raise ValueError("timeout must be a positive integer")
-        if self._exitcode is not _SENTINEL:
-            return self._exitcode
-        self._exitcode = self._proc.wait(timeout)
+        if rusage and not POSIX:
+            raise NotImplementedError("rusage is supported on POSIX only")
+        if self._exitcode is _SENTINEL:
+            if rusage:
+                self._exitcode, self._exit_rusage = self._proc.wait(
+                    timeout, rusage=True)
+            else:
+                self._exitcode = self._proc.wait(timeout)
+        if rusage:
+            return (self._exitcode, self._exit_rusage)
         return self._exitcode
 
 
@@ -1276,7 +1377,21 @@ _as_dict_attrnames = set(
     [x for x in dir(Process) if not x.startswith('_') and x not in
      ['send_signal', 'suspend', 'resume', 'terminate', 'kill', 'wait',
       'is_running', 'as_dict', 'parent', 'parents', 'children', 'rlimit',
-      'memory_info_ex', 'oneshot']])
+      'memory_info_ex', 'oneshot', 'working_set', 'sample_thread_states']])
+
+
+def _check_attrs(attrs):
+    """Validate *attrs* argument of as_dict() and process_iter()
+    and return it as a list with no duplicates.
+    """
+    if not isinstance(attrs, (list, tuple, set, frozenset)):
+        raise TypeError("invalid attrs type %s" % type(attrs))
+    invalid_names = set(attrs) - _as_dict_attrnames
+    if invalid_names:
+        raise ValueError("invalid attr name%s %s" % (
+            "s" if len(invalid_names) > 1 else "",
+            ", ".join(map(repr, invalid_names))))
+    return list(collections.OrderedDict.fromkeys(attrs))
 
 
 # =====================================================================
@@ -1355,11 +1470,13 @@ class Popen(Process):
                 raise AttributeError("%s instance has no attribute '%s'"
                                      % (self.__class__.__name__, name))
 
-    def wait(self, timeout=None):
+    def wait(self, timeout=None, rusage=False):
         if self.__subproc.returncode is not None:
+            if rusage:
+                return (self.__subproc.returncode, self._exit_rusage)
             return self.__subproc.returncode
-        ret = super(Popen, self).wait(timeout)
-        self.__subproc.returncode = ret
+        ret = super(Popen, self).wait(timeout, rusage=rusage)
+        self.__subproc.returncode = ret[0] if rusage else ret
         return ret
 
 
@@ -1376,6 +1493,25 @@ def pids():
     return ret
 
 
+def pids_since(previous):
+    """Given the PIDs returned by a previous call to pids() (or any
+    iterable of PIDs) return a (pids, new, gone) tuple of sorted
+    lists: the PIDs currently running, the ones which appeared and
+    the ones which disappeared in the meantime.
+    """
+    global _LOWEST_PID
+    if hasattr(_psplatform, "pids_since"):
+        cur, new, gone = [x.tolist() for x in _psplatform.pids_since(previous)]
+    else:
+        cur = sorted(_psplatform.pids())
+        a = set(cur)
+        b = set(previous)
+        new = sorted(a - b)
+        gone = sorted(b - a)
+    _LOWEST_PID = cur[0]
+    return (cur, new, gone)
+
+
 def pid_exists(pid):
     """Return True if given PID exists in the current process list.
     This is faster than doing "pid in psutil.pids()" and
@@ -1394,10 +1530,91 @@ def pid_exists(pid):
         return _psplatform.pid_exists(pid)
 
 
+# Linux only
+if hasattr(_psplatform, "pid_namespace_map"):
+
+    def pid_namespace_map():
+        """Return a {(pidns, ns_pid): pid, ...} dict translating PIDs
+        as seen inside PID namespaces (e.g. containers) into PIDs as
+        seen by us, for all processes, where *pidns* is the inode
+        number identifying the namespace (see "ls -i /proc/self/ns/pid").
+        Processes in nested namespaces are included only if we have
+        the privileges to inspect them (usually root).
+        """
+        return _psplatform.pid_namespace_map()
+
+    __all__.append("pid_namespace_map")
+
+
 _pmap = {}
 
 
-def process_iter(attrs=None, ad_value=None):
+class _LazyInfo(_Mapping):
+    """A read-only dict-like object which is set as Process.info by
+    process_iter(attrs, lazy=True). Each attribute is retrieved on
+    first access and then cached. Attributes are retrieved as if they
+    were all in the same oneshot() context, whose caches are kept
+    here between accesses, so that the Process lock is only held
+    while retrieving an attribute.
+    """
+    __slots__ = ["_proc", "_attrs", "_ad_value", "_values", "_caches"]
+
+    def __init__(self, proc, attrs, ad_value):
+        self._proc = proc
+        self._attrs = attrs
+        self._ad_value = ad_value
+        self._values = {}
+        self._caches = None
+
+    def _fetch(self, name):
+        proc = self._proc
+        with proc._lock:
+            if hasattr(proc, "_cache"):
+                # already in a oneshot() context (e.g. the caller's)
+                return getattr(proc, name)()
+            with proc.oneshot():
+                if self._caches is not None:
+                    proc._cache = self._caches[0]
+                    if hasattr(proc._proc, "_cache"):
+                        proc._proc._cache = self._caches[1]
+                try:
+                    return getattr(proc, name)()
+                finally:
+                    self._caches = (proc._cache,
+                                    getattr(proc._proc, "_cache", {}))
+
+    def __getitem__(self, name):
+        try:
+            return self._values[name]
+        except KeyError:
+            if name not in self._attrs:
+                raise
+        try:
+            if name == 'pid':
+                ret = self._proc.pid
+            else:
+                ret = self._fetch(name)
+        except (AccessDenied, NoSuchProcess):
+            # NoSuchProcess: unlike as_dict() we can't skip the process
+            # since it has already been returned
+            ret = self._ad_value
+        self._values[name] = ret
+        return ret
+
+    def __iter__(self):
+        return iter(self._attrs)
+
+    def __len__(self):
+        return len(self._attrs)
+
+    def __repr__(self):
+        info = ", ".join("%r: %s" % (
+            name, repr(self._values[name]) if name in self._values else
+            "<not fetched>") for name in self._attrs)
+        return "%s({%s})" % (self.__class__.__name__, info)
+
+
+def process_iter(attrs=None, ad_value=None, lazy=False):
     """Return a generator yielding a Process instance for all
     running processes.
 
@@ -1417,24 +1634,36 @@ def process_iter(attrs=None, ad_value=None):
     to returned Process instance.
     If *attrs* is an empty list it will retrieve all process info
     (slow).
+
+    If *lazy* is True 'info' is a read-only dict-like object which
+    retrieves each attribute only when it's accessed for the first
+    time, so that processes which are filtered out by looking at a
+    cheap attribute (e.g. name) don't pay for the others. They are
+    retrieved as if they were all in the same oneshot() context.
     """
     global _pmap
 
     def add(pid):
         proc = Process(pid)
-        if attrs is not None:
-            proc.info = proc.as_dict(attrs=attrs, ad_value=ad_value)
         pmap[proc.pid] = proc
         return proc
 
     def remove(pid):
         pmap.pop(pid, None)
 
+    if attrs is not None and lazy:
+        attrs = _check_attrs(attrs) or sorted(_as_dict_attrnames)
+    else:
+        lazy = False
     pmap = _pmap.copy()
-    a = set(pids())
-    b = set(pmap.keys())
-    new_pids = a - b
-    gone_pids = b - a
+    if hasattr(_psplatform, "pids_since"):
+        # Diff the PIDs natively, without creating 2 sets of ints.
+        new_pids, gone_pids = _psplatform.pids_since(pmap)[1:]
+    else:
+        a = set(pids())
+        b = set(pmap.keys())
+        new_pids = a - b
+        gone_pids = b - a
     for pid in gone_pids:
         remove(pid)
     try:
@@ -1442,37 +1671,72 @@ def process_iter(attrs=None, ad_value=None):
         for pid, proc in ls:
             try:
                 if proc is None:  # new process
-                    yield add(pid)
+                    ret = add(pid)
+                elif proc.is_running():
+                    ret = proc
                 else:
-                    # use is_running() to check whether PID has been
-                    # reused by another process in which case yield a
+                    # PID has been reused by another process; use a
                     # new Process instance
-                    if proc.is_running():
-                        if attrs is not None:
-                            proc.info = proc.as_dict(
-                                attrs=attrs, ad_value=ad_value)
-                        yield proc
-                    else:
-                        yield add(pid)
+                    ret = add(pid)
+                if lazy:
+                    ret.info = _LazyInfo(ret, attrs, ad_value)
+                elif attrs is not None:
+                    ret.info = ret.as_dict(attrs=attrs, ad_value=ad_value)
             except NoSuchProcess:
                 remove(pid)
+                continue
             except AccessDenied:
                 # Process creation time can't be determined hence there's
                 # no way to tell whether the pid of the cached process
                 # has been reused. Just return the cached version.
                 if proc is None and pid in pmap:
                     try:
-                        yield pmap[pid]
+                        ret = pmap[pid]
                     except KeyError:
                         # If we get here it is likely that 2 threads were
                         # using process_iter().
-                        pass
+                        continue
                 else:
                     raise
+            yield ret
     finally:
         _pmap = pmap
 
 
+@contextlib.contextmanager
+def oneshot_many(procs):
+    """Like Process.oneshot(), but for many processes at once.
+    Enters the oneshot() context of all the given Process instances
+    and, where supported (Linux), reads the files most process info
+    is extracted from for all of them in a single pass, so that
+    subsequent method calls are served from the cache.
+
+    >>> import psutil
+    >>> procs = list(psutil.process_iter())
+    >>> with psutil.oneshot_many(procs):
+    ...     for p in procs:
+    ...         p.name(), p.ppid(), p.memory_info()  # cached
+    ...
+    >>>
+    """
+    ctxs = []
+    prefetch = []
+    try:
+        for proc in procs:
+            if not hasattr(proc, "_cache"):
+                # not already in a oneshot() context
+                prefetch.append(proc._proc)
+            ctx = proc.oneshot()
+            ctx.__enter__()
+            ctxs.append(ctx)
+        if prefetch and hasattr(_psplatform, "oneshot_prefetch"):
+            _psplatform.oneshot_prefetch(prefetch)
+        yield
+    finally:
+        for ctx in reversed(ctxs):
+            ctx.__exit__(None, None, None)
+
+
 def wait_procs(procs, timeout=None, callback=None):
     """Convenience function which waits for a list of processes to
     terminate.
@@ -1564,6 +1828,30 @@ def wait_procs(procs, timeout=None, callback=None):
     return (list(gone), list(alive))
 
 
+# Linux only
+if hasattr(_psplatform, "ExitAccountant"):
+    ExitAccountant = _psplatform.ExitAccountant
+    __all__.append("ExitAccountant")
+
+
+# Linux only
+if hasattr(_psplatform, "file_users"):
+
+    def file_users(path):
+        """Return the processes using a file, like lsof / fuser do,
+        as a list of (pid, fd, type, path) namedtuples, where type is
+        one of "fd", "mmap", "cwd", "root" or "exe" and fd is -1 if
+        type is not "fd".
+
+        If *path* is a mount point all processes using any file on
+        that filesystem are returned.
+        Processes which can't be inspected (AccessDenied) are skipped.
+        """
+        return _psplatform.file_users(path)
+
+    __all__.append("file_users")
+
+
 # =====================================================================
 # --- CPU related functions
 # =====================================================================
@@ -1620,17 +1908,10 @@ def cpu_times(percpu=False):
         return _psplatform.per_cpu_times()
 
 
-try:
-    _last_cpu_times = cpu_times()
-except Exception:
-    # Don't want to crash at import time.
-    _last_cpu_times = None
-
-try:
-    _last_per_cpu_times = cpu_times(percpu=True)
-except Exception:
-    # Don't want to crash at import time.
-    _last_per_cpu_times = None
+# Set on first cpu_percent() call rather than at import time, which
+# would read /proc/stat (or equivalent) twice on every import.
+_last_cpu_times = None
+_last_per_cpu_times = None
 
 
 def _cpu_tot_time(times):
@@ -1689,7 +1970,36 @@ def _cpu_times_deltas(t1, t2):
     return _psplatform.scputimes(*field_deltas)
 
 
-def cpu_percent(interval=None, percpu=False):
+_CPU_GROUPS = ("cpu", "core", "socket", "numa")
+
+
+def _check_cpu_group(per):
+    if per is not None and per not in _CPU_GROUPS:
+        raise ValueError("per must be one of %s (got %r)" % (
+            ", ".join(repr(x) for x in _CPU_GROUPS), per))
+    if per not in (None, "cpu") and \
+            not hasattr(_psplatform, "cpu_topology"):
+        raise NotImplementedError("per=%r is not supported" % per)
+
+
+def _cpu_times_grouped(per, tot1, tot2):
+    """Sum the per-CPU times of two cpu_times(percpu=True) results by
+    physical core, socket or NUMA node, and return an ordered
+    {group: (t1, t2)} dict.
+    """
+    index = _CPU_GROUPS.index(per) - 1
+    groups = {}
+    for topo, t1, t2 in zip(_psplatform.cpu_topology(), tot1, tot2):
+        groups.setdefault(topo[index], []).append((t1, t2))
+    ret = collections.OrderedDict()
+    for key in sorted(groups):
+        t1s, t2s = zip(*groups[key])
+        ret[key] = (_psplatform.scputimes(*map(sum, zip(*t1s))),
+                    _psplatform.scputimes(*map(sum, zip(*t2s))))
+    return ret
+
+
+def cpu_percent(interval=None, percpu=False, per=None):
     """Return a float representing the current system-wide CPU
     utilization as a percentage.
 
@@ -1709,6 +2019,12 @@ def cpu_percent(interval=None, percpu=False):
     to second CPU and so on.
     The order of the list is consistent across calls.
 
+    *per* can be used instead of *percpu* to group CPUs (Linux only):
+    "cpu" is the same as percpu=True, while "core", "socket" and
+    "numa" return a {group: percent} dict, summing the times of the
+    logical CPUs of each physical core (a (socket, core_id) tuple),
+    socket or NUMA node.
+
     Examples:
 
       >>> # blocking, system-wide
@@ -1729,6 +2045,9 @@ def cpu_percent(interval=None, percpu=False):
     blocking = interval is not None and interval > 0.0
     if interval is not None and interval < 0:
         raise ValueError("interval is not positive (got %r)" % interval)
+    _check_cpu_group(per)
+    if per is not None:
+        percpu = True
 
     def calculate(t1, t2):
         times_delta = _cpu_times_deltas(t1, t2)
@@ -1750,8 +2069,8 @@ def cpu_percent(interval=None, percpu=False):
         else:
             t1 = _last_cpu_times
             if t1 is None:
-                # Something bad happened at import time. We'll
-                # get a meaningful result on the next call. See:
+                # First call. We'll get a meaningful result on the
+                # next call. See:
                 # https://github.com/giampaolo/psutil/pull/715
                 t1 = cpu_times()
         _last_cpu_times = cpu_times()
@@ -1765,11 +2084,15 @@ def cpu_percent(interval=None, percpu=False):
         else:
             tot1 = _last_per_cpu_times
             if tot1 is None:
-                # Something bad happened at import time. We'll
-                # get a meaningful result on the next call. See:
+                # First call. We'll get a meaningful result on the
+                # next call. See:
                 # https://github.com/giampaolo/psutil/pull/715
                 tot1 = cpu_times(percpu=True)
         _last_per_cpu_times = cpu_times(percpu=True)
+        if per not in (None, "cpu"):
+            groups = _cpu_times_grouped(per, tot1, _last_per_cpu_times)
+            return collections.OrderedDict(
+                (k, calculate(t1, t2)) for k, (t1, t2) in groups.items())
         for t1, t2 in zip(tot1, _last_per_cpu_times):
             ret.append(calculate(t1, t2))
         return ret
@@ -1778,11 +2101,11 @@ def cpu_percent(interval=None, percpu=False):
 # Use separate global vars for cpu_times_percent() so that it's
 # independent from cpu_percent() and they can both be used within
 # the same program.
-_last_cpu_times_2 = _last_cpu_times
-_last_per_cpu_times_2 = _last_per_cpu_times
+_last_cpu_times_2 = None
+_last_per_cpu_times_2 = None
 
 
-def cpu_times_percent(interval=None, percpu=False):
+def cpu_times_percent(interval=None, percpu=False, per=None):
     """Same as cpu_percent() but provides utilization percentages
     for each specific CPU time as is returned by cpu_times().
     For instance, on Linux we'll get:
@@ -1792,14 +2115,17 @@ def cpu_times_percent(interval=None, percpu=False):
                  irq=0.0, softirq=0.0, steal=0.0, guest=0.0, guest_nice=0.0)
       >>>
 
-    *interval* and *percpu* arguments have the same meaning as in
-    cpu_percent().
+    *interval*, *percpu* and *per* arguments have the same meaning as
+    in cpu_percent().
     """
     global _last_cpu_times_2
     global _last_per_cpu_times_2
     blocking = interval is not None and interval > 0.0
     if interval is not None and interval < 0:
         raise ValueError("interval is not positive (got %r)" % interval)
+    _check_cpu_group(per)
+    if per is not None:
+        percpu = True
 
     def calculate(t1, t2):
         nums = []
@@ -1826,8 +2152,8 @@ def cpu_times_percent(interval=None, percpu=False):
         else:
             t1 = _last_cpu_times_2
             if t1 is None:
-                # Something bad happened at import time. We'll
-                # get a meaningful result on the next call. See:
+                # First call. We'll get a meaningful result on the
+                # next call. See:
                 # https://github.com/giampaolo/psutil/pull/715
                 t1 = cpu_times()
         _last_cpu_times_2 = cpu_times()
@@ -1841,11 +2167,15 @@ def cpu_times_percent(interval=None, percpu=False):
         else:
             tot1 = _last_per_cpu_times_2
             if tot1 is None:
-                # Something bad happened at import time. We'll
-                # get a meaningful result on the next call. See:
+                # First call. We'll get a meaningful result on the
+                # next call. See:
                 # https://github.com/giampaolo/psutil/pull/715
                 tot1 = cpu_times(percpu=True)
         _last_per_cpu_times_2 = cpu_times(percpu=True)
+        if per not in (None, "cpu"):
+            groups = _cpu_times_grouped(per, tot1, _last_per_cpu_times_2)
+            return collections.OrderedDict(
+                (k, calculate(t1, t2)) for k, (t1, t2) in groups.items())
         for t1, t2 in zip(tot1, _last_per_cpu_times_2):
             ret.append(calculate(t1, t2))
         return ret
@@ -1856,6 +2186,66 @@ def cpu_stats():
     return _psplatform.cpu_stats()
 
 
+# Linux only
+if hasattr(_psplatform, "cpu_sched_stats"):
+
+    def cpu_sched_stats(percpu=False):
+        """Return CPU saturation stats as a namedtuple including:
+
+         - running: the number of runnable tasks (including the caller)
+         - blocked: the number of tasks blocked waiting for I/O
+         - run_time: seconds spent running by tasks
+         - run_delay: seconds spent by runnable tasks waiting for a CPU
+         - timeslices: the number of timeslices run
+
+        The last three are cumulative since boot and None if
+        /proc/schedstat is not available. If *percpu* is True they are
+        lists with one value per CPU.
+        """
+        return _psplatform.cpu_sched_stats(percpu=percpu)
+
+    _last_cpu_sched_stats = None
+
+    def cpu_sched_stats_rate(interval=None, percpu=False):
+        """Same as cpu_sched_stats() but return run_time and run_delay
+        as seconds per second (that is the average number of running
+        and waiting tasks) and timeslices per second, over *interval*
+        seconds or since the previous call, see cpu_percent().
+        *running* and *blocked* are the current values.
+        """
+        global _last_cpu_sched_stats
+        if interval is not None and interval < 0:
+            raise ValueError("interval is not positive (got %r)" % interval)
+        if interval is not None and interval > 0.0:
+            t1 = (_timer(), _psplatform.cpu_sched_stats(percpu=True))
+            time.sleep(interval)
+        else:
+            t1 = _last_cpu_sched_stats
+            if t1 is None:
+                # First call. We'll get a meaningful result on the
+                # next call.
+                t1 = (_timer(), _psplatform.cpu_sched_stats(percpu=True))
+        t2 = (_timer(), _psplatform.cpu_sched_stats(percpu=True))
+        _last_cpu_sched_stats = t2
+        elapsed = t2[0] - t1[0]
+        if len(t1[1].run_time) != len(t2[1].run_time):
+            t1 = t2  # CPU hotplug
+
+        def rates(field):
+            ret = []
+            for v1, v2 in zip(getattr(t1[1], field), getattr(t2[1], field)):
+                ret.append(max(0, v2 - v1) / elapsed if elapsed > 0 else 0.0)
+            if percpu:
+                return ret
+            return sum(ret) if t2[1].run_time else None
+
+        return _psplatform.scpusched(
+            t2[1].running, t2[1].blocked, rates("run_time"),
+            rates("run_delay"), rates("timeslices"))
+
+    __all__.extend(["cpu_sched_stats", "cpu_sched_stats_rate"])
+
+
 if hasattr(_psplatform, "cpu_freq"):
 
     def cpu_freq(percpu=False):
@@ -1901,6 +2291,92 @@ if hasattr(_psplatform, "cpu_freq"):
     __all__.append("cpu_freq")
 
 
+# Linux only
+if hasattr(_psplatform, "cpu_affinity_histogram"):
+
+    def cpu_affinity_histogram(pids=None, threads=True, pinned_only=False):
+        """Return a (percpu, tasks) namedtuple where *percpu* is a list
+        telling how many tasks are allowed to run on each CPU, and
+        *tasks* is the number of tasks which were inspected.
+        By default all the threads of all the processes are taken into
+        account. *pids* restricts the scan to a list of PIDs; if
+        *threads* is False only the process' main thread is considered.
+        If *pinned_only* is True tasks which are allowed to run on all
+        online CPUs are not counted.
+        Tasks disappearing in the meantime are skipped.
+        """
+        if pids is None:
+            pids = _psplatform.pids()
+        return _psplatform.cpu_affinity_histogram(
+            pids, threads=threads, pinned_only=pinned_only)
+
+    __all__.append("cpu_affinity_histogram")
+
+
+# Linux only
+if hasattr(_psplatform, "cpu_power_states"):
+
+    def cpu_power_states(percpu=True):
+        """Return the residency of online CPUs in idle states (C-states)
+        and frequencies (P-states) since boot. For each CPU return an
+        (idle, freq) namedtuple where *idle* is a list of
+        (name, latency, usage, time) namedtuples, one per idle state,
+        and *freq* a {MHz: seconds, ...} dict.
+        If *percpu* is False return one namedtuple summing all CPUs.
+        Raise NotImplementedError if neither cpuidle nor cpufreq
+        stats are available (e.g. in most VMs).
+        """
+        return _psplatform.cpu_power_states(percpu=percpu)
+
+    _last_cpu_power_states = None
+
+    def cpu_power_states_percent(interval=None, percpu=True):
+        """Same as cpu_power_states() but return the percentage of time
+        spent in each idle state and frequency, as an
+        (active, idle, freq) namedtuple where *active* is the time not
+        spent idle, *idle* is a {state_name: percent, ...} dict and
+        *freq* a {MHz: percent, ...} dict.
+
+        *interval* has the same meaning as in cpu_percent(). If
+        *percpu* is False percentages are averaged over all CPUs.
+        """
+        global _last_cpu_power_states
+        if interval is not None and interval < 0:
+            raise ValueError("interval is not positive (got %r)" % interval)
+        if interval is not None and interval > 0.0:
+            t1 = (_timer(), _psplatform.cpu_power_states())
+            time.sleep(interval)
+        else:
+            t1 = _last_cpu_power_states
+            if t1 is None:
+                # First call. We'll get a meaningful result on the
+                # next call.
+                t1 = (_timer(), _psplatform.cpu_power_states())
+        t2 = (_timer(), _psplatform.cpu_power_states())
+        _last_cpu_power_states = t2
+        if len(t1[1]) != len(t2[1]):
+            t1 = t2  # CPU hotplug
+        ret = _psplatform.cpu_power_states_percent(
+            t1[1], t2[1], t2[0] - t1[0])
+        if percpu:
+            return ret
+
+        def average(dicts):
+            keys = []
+            for d in dicts:
+                keys.extend(k for k in d if k not in keys)
+            return collections.OrderedDict(
+                (k, round(sum(d.get(k, 0) for d in dicts) / len(dicts), 1))
+                for k in keys)
+
+        return _psplatform.scpupowerpercent(
+            round(sum(x.active for x in ret) / len(ret), 1),
+            average([x.idle for x in ret]),
+            dict(average([x.freq for x in ret])))
+
+    __all__.extend(["cpu_power_states", "cpu_power_states_percent"])
+
+
 if hasattr(os, "getloadavg") or hasattr(_psplatform, "getloadavg"):
     # Perform this hasattr check once on import time to either use the
     # platform based code or proxy straight from the os module.
@@ -1992,6 +2468,65 @@ def swap_memory():
     return _psplatform.swap_memory()
 
 
+# Linux only
+if hasattr(_psplatform, "kernel_memory"):
+
+    def kernel_memory(top=10, delta=False):
+        """Return a breakdown of the memory used by the kernel as a
+        namedtuple including:
+
+         - slab: the *top* slab caches using more memory (None if
+           /proc/slabinfo is not readable)
+         - vmalloc: the *top* functions which allocated more memory
+           via vmalloc() (None if /proc/vmallocinfo is not readable)
+         - hugepages: a {page_size: pool} dict of hugetlb pools
+         - thp: a dict of transparent huge pages event counters
+         - zram: a {device: stats} dict of zram devices
+         - zswap: zswap pool size and amount of data stored in it
+
+        If *delta* is True slab caches report how much they grew
+        (or shrank) since the last call with *delta=True*, so that a
+        growing cache can be spotted.
+        """
+        if top is not None and top < 1:
+            raise ValueError("top must be >= 1 (got %r)" % top)
+        return _psplatform.kernel_memory(top=top, delta=delta)
+
+    __all__.append("kernel_memory")
+
+
+# Linux only
+if hasattr(_psplatform, "vm_events"):
+
+    def vm_events():
+        """Return all the virtual memory event counters maintained by
+        the kernel (page faults, swapping, reclaim, compaction, THP
+        and a lot more, see /proc/vmstat) as a {name: value} dict.
+        Counters are cumulative since boot. See VmEventsSampler to
+        get the per-second rates of some of them.
+        """
+        return _psplatform.vm_events()
+
+    VmEventsSampler = _psplatform.VmEventsSampler
+    __all__.extend(["vm_events", "VmEventsSampler"])
+
+
+# Linux only
+if hasattr(_psplatform, "working_set"):
+
+    def working_set_many(pids, interval=1.0, method=None):
+        """Same as Process.working_set() but for many processes at
+        once, waiting *interval* seconds only once. Return a
+        {pid: bytes} dict. Processes which disappear or can't be
+        accessed are left out.
+        """
+        if interval < 0:
+            raise ValueError("interval is not positive (got %r)" % interval)
+        return _psplatform.working_set(pids, interval, method=method)
+
+    __all__.append("working_set_many")
+
+
 # =====================================================================
 # --- disks/paritions related functions
 # =====================================================================
@@ -2033,7 +2568,8 @@ def disk_partitions(all=False):
         return ret
 
 
-def disk_io_counters(perdisk=False, nowrap=True):
+def disk_io_counters(perdisk=False, nowrap=True, include=None,
+                     exclude=None):
     """Return system disk I/O statistics as a namedtuple including
     the following fields:
 
@@ -2062,15 +2598,21 @@ def disk_io_counters(perdisk=False, nowrap=True):
     "disk_io_counters.cache_clear()" can be used to invalidate the
     cache.
 
+    *include* and *exclude* are glob patterns (e.g. "sd*") or compiled
+    regular expressions (or lists of them) restricting the disks which
+    are returned or summed. On Linux other disks are not even parsed.
+
     On recent Windows versions 'diskperf -y' command may need to be
     executed first otherwise this function won't find any disk.
     """
-    kwargs = dict(perdisk=perdisk) if LINUX else {}
-    rawdict = _psplatform.disk_io_counters(**kwargs)
+    match = _common.name_filter(include, exclude)
+    kwargs = dict(perdisk=perdisk, match=match) if LINUX else {}
+    rawdict = _filter_names(_psplatform.disk_io_counters(**kwargs), match)
     if not rawdict:
         return {} if perdisk else None
     if nowrap:
-        rawdict = _wrap_numbers(rawdict, 'psutil.disk_io_counters')
+        rawdict = _wrap_numbers(rawdict, _nowrap_name(
+            'psutil.disk_io_counters', include, exclude))
     nt = getattr(_psplatform, "sdiskio", _common.sdiskio)
     if perdisk:
         for disk, fields in rawdict.items():
@@ -2085,12 +2627,30 @@ disk_io_counters.cache_clear = functools.partial(
 disk_io_counters.cache_clear.__doc__ = "Clears nowrap argument cache"
 
 
+if hasattr(_psplatform, "disk_mount_disks"):
+
+    def disk_mount_disks(all=False):
+        """Return a {mountpoint: [disk, ...]} dict mapping each mounted
+        filesystem to the whole disks it's stored on, resolving
+        partitions, device-mapper (LVM, LUKS) and MD RAID devices.
+        Disk names are the same ones used by
+        disk_io_counters(perdisk=True), so that the two can be joined
+        to get per-filesystem I/O rates.
+
+        *all* has the same meaning as in disk_partitions().
+        """
+        return _psplatform.disk_mount_disks(all=all)
+
+    __all__.append("disk_mount_disks")
+
+
 # =====================================================================
 # --- network related functions
 # =====================================================================
 
 
-def net_io_counters(pernic=False, nowrap=True):
+def net_io_counters(pernic=False, nowrap=True, include=None,
+                    exclude=None):
     """Return network I/O statistics as a namedtuple including
     the following fields:
 
@@ -2115,12 +2675,20 @@ def net_io_counters(pernic=False, nowrap=True):
     but never decrease.
     "disk_io_counters.cache_clear()" can be used to invalidate the
     cache.
+
+    *include* and *exclude* are glob patterns (e.g. "eth*") or compiled
+    regular expressions (or lists of them) restricting the interfaces
+    which are returned or summed. On Linux other interfaces are not
+    even parsed.
     """
-    rawdict = _psplatform.net_io_counters()
+    match = _common.name_filter(include, exclude)
+    kwargs = dict(match=match) if LINUX else {}
+    rawdict = _filter_names(_psplatform.net_io_counters(**kwargs), match)
     if not rawdict:
         return {} if pernic else None
     if nowrap:
-        rawdict = _wrap_numbers(rawdict, 'psutil.net_io_counters')
+        rawdict = _wrap_numbers(rawdict, _nowrap_name(
+            'psutil.net_io_counters', include, exclude))
     if pernic:
         for nic, fields in rawdict.items():
             rawdict[nic] = _common.snetio(*fields)
@@ -2163,7 +2731,29 @@ def net_connections(kind='inet'):
     return _psplatform.net_connections(kind)
 
 
-def net_if_addrs():
+# Linux only
+if hasattr(_psplatform, "port_owners"):
+
+    def port_owners(port, proto="tcp", state=CONN_LISTEN):
+        """Return the inet sockets bound to a local *port* as a list of
+        (fd, family, type, laddr, raddr, status, pid) namedtuples, same
+        as net_connections(). *proto* is one of "tcp", "tcp4", "tcp6",
+        "udp", "udp4", "udp6", "inet", "inet4" or "inet6". *state*
+        filters TCP sockets by status (None means any). For UDP
+        sockets, which have no state, CONN_LISTEN means not connected.
+
+        It's a lot faster than net_connections(), as only the matching
+        sockets are looked up in the processes' fds, and the scan stops
+        as soon as all of them are found. As such, for a socket shared
+        by many processes (e.g. pre-fork servers) only the one with the
+        lowest PID is reported.
+        """
+        return _psplatform.port_owners(port, proto, state)
+
+    __all__.append("port_owners")
+
+
+def net_if_addrs(include=None, exclude=None):
     """Return the addresses associated to each NIC (network interface
     card) installed on the system as a dictionary whose keys are the
     NIC names and value is a list of namedtuples for each address
@@ -2180,7 +2770,11 @@ def net_if_addrs():
 
     Note: you can have more than one address of the same family
     associated with each interface.
+
+    *include* and *exclude* restrict the returned NICs, see
+    net_io_counters().
     """
+    match = _common.name_filter(include, exclude)
     has_enums = sys.version_info >= (3, 4)
     if has_enums:
         import socket
@@ -2188,6 +2782,8 @@ def net_if_addrs():
     rawlist.sort(key=lambda x: x[1])  # sort by family
     ret = collections.defaultdict(list)
     for name, fam, addr, mask, broadcast, ptp in rawlist:
+        if match is not None and not match(name):
+            continue
         if has_enums:
             try:
                 fam = socket.AddressFamily(fam)
@@ -2211,7 +2807,7 @@ def net_if_addrs():
     return dict(ret)
 
 
-def net_if_stats():
+def net_if_stats(include=None, exclude=None):
     """Return information about each NIC (network interface card)
     installed on the system as a dictionary whose keys are the
     NIC names and value is a namedtuple with the following fields:
@@ -2222,8 +2818,13 @@ def net_if_stats():
      - speed: the NIC speed expressed in mega bits (MB); if it can't
               be determined (e.g. 'localhost') it will be set to 0.
      - mtu: the maximum transmission unit expressed in bytes.
+
+    *include* and *exclude* restrict the returned NICs, see
+    net_io_counters().
     """
-    return _psplatform.net_if_stats()
+    match = _common.name_filter(include, exclude)
+    kwargs = dict(match=match) if LINUX else {}
+    return _filter_names(_psplatform.net_if_stats(**kwargs), match)
 
 
 # =====================================================================
@@ -2325,6 +2926,282 @@ def users():
     return _psplatform.users()
 
 
+_COLLECTORS = {
+    "cpu_times": lambda: cpu_times(),
+    "per_cpu_times": lambda: cpu_times(percpu=True),
+    "cpu_stats": lambda: cpu_stats(),
+    "cpu_count": lambda: cpu_count(),
+    "boot_time": lambda: boot_time(),
+    "virtual_memory": lambda: virtual_memory(),
+    "swap_memory": lambda: swap_memory(),
+}
+if hasattr(_psplatform, "cpu_sched_stats"):
+    _COLLECTORS["cpu_sched_stats"] = lambda: cpu_sched_stats()
+
+
+def collect(names):
+    """Return the result of many system-wide functions at once as a
+    {name: result} dict. *names* is a list of names among
+    "cpu_times", "per_cpu_times", "cpu_stats", "cpu_count",
+    "boot_time", "virtual_memory", "swap_memory" and (Linux only)
+    "cpu_sched_stats".
+    Where supported (Linux) the files those metrics are extracted
+    from (/proc/stat, /proc/meminfo, ...) are read only once, so
+    all the results refer to the same instant.
+
+    >>> import psutil
+    >>> psutil.collect(["cpu_times", "cpu_stats", "virtual_memory"])
+    {'cpu_times': scputimes(...), 'cpu_stats': scpustats(...), ...}
+    """
+    if isinstance(names, _basestring):
+        raise TypeError("names must be a list of strings, not a string")
+    names = list(names)
+    for name in names:
+        if name not in _COLLECTORS:
+            raise ValueError("invalid name %r; choose between %s" % (
+                name, ", ".join(repr(x) for x in sorted(_COLLECTORS))))
+    if not hasattr(_psplatform, "system_snapshot"):
+        return dict((name, _COLLECTORS[name]()) for name in names)
+    with _psplatform.system_snapshot():
+        return dict((name, _COLLECTORS[name]()) for name in names)
+
+
+# --- baselines store
+
+_baseline_ntuples = {}
+
+
+def _baseline_encode(obj):
+    """Turn obj into something which can be serialized as JSON,
+    preserving tuples, namedtuples, sets and non-string dict keys.
+    """
+    if isinstance(obj, tuple):
+        if hasattr(obj, "_fields"):
+            return {"n": [type(obj).__name__, list(obj._fields),
+                          [_baseline_encode(x) for x in obj]]}
+        return {"t": [_baseline_encode(x) for x in obj]}
+    if isinstance(obj, list):
+        return [_baseline_encode(x) for x in obj]
+    if isinstance(obj, (set, frozenset)):
+        return {"s": [_baseline_encode(x) for x in obj]}
+    if isinstance(obj, dict):
+        return {"d": [[_baseline_encode(k), _baseline_encode(v)]
+                      for k, v in obj.items()]}
+    return obj
+
+
+def _baseline_decode(obj):
+    if isinstance(obj, list):
+        return [_baseline_decode(x) for x in obj]
+    if not isinstance(obj, dict):
+        return obj
+    (tag, value), = obj.items()
+    if tag == "n":
+        name, fields, values = value
+        key = (str(name), tuple(str(x) for x in fields))
+        try:
+            ntuple = _baseline_ntuples[key]
+        except KeyError:
+            ntuple = _baseline_ntuples[key] = collections.namedtuple(*key)
+        return ntuple(*[_baseline_decode(x) for x in values])
+    if tag == "t":
+        return tuple(_baseline_decode(x) for x in value)
+    if tag == "s":
+        return set(_baseline_decode(x) for x in value)
+    if tag == "d":
+        return dict((_baseline_decode(k), _baseline_decode(v))
+                    for k, v in value)
+    raise ValueError("invalid tag %r" % tag)
+
+
+def _boot_id():
+    if hasattr(_psplatform, "boot_id"):
+        return _psplatform.boot_id()
+    # boot_time() may vary by a second across calls
+    return "%d" % round(boot_time(), -1)
+
+
+class BaselineStore(object):
+    """Persist the baselines of the non-blocking rate functions
+    (cpu_percent(), cpu_times_percent(), cpu_sched_stats_rate()) and
+    of the counters wrapping detection (net_io_counters() and
+    disk_io_counters() *nowrap* argument) in a state file, so that
+    short-lived programs (e.g. started by cron) get the values since
+    the previous run rather than sleeping for an interval.
+    Baselines are discarded if the system was rebooted in between.
+
+    >>> import psutil
+    >>> with psutil.BaselineStore("/var/tmp/collector.state") as store:
+    ...     psutil.cpu_percent()  # since the previous run
+    ...     store.rates("net", psutil.net_io_counters())
+    ...
+    5.1
+    snetio(bytes_sent=1274.2, bytes_recv=9031.7, ...)
+    """
+
+    _MAGIC = b"psutilbs"
+    _VERSION = 1
+
+    def __init__(self, path):
+        self._path = path
+        self._rates = {}
+
+    def __repr__(self):
+        return "%s.%s(path=%r)" % (
+            self.__class__.__module__, self.__class__.__name__, self._path)
+
+    def __enter__(self):
+        self.load()
+        return self
+
+    def __exit__(self, *args):
+        self.save()
+
+    def _read(self):
+        import json
+        import struct
+        import zlib
+
+        header = struct.Struct("<8sIII")
+        # save() replaces the file rather than rewriting it, so this
+        # always reads one complete version, also if runs overlap.
+        with open(self._path, "rb") as f:
+            data = f.read()
+        if len(data) < header.size:
+            return None
+        magic, version, length, crc = header.unpack(data[:header.size])
+        payload = data[header.size:]
+        if magic != self._MAGIC or version != self._VERSION or \
+                len(payload) != length or \
+                zlib.crc32(payload) & 0xffffffff != crc:
+            return None  # not ours, or corrupted
+        return json.loads(payload.decode("utf8"))
+
+    def _write(self, state):
+        import json
+        import struct
+        import tempfile
+        import zlib
+
+        payload = json.dumps(state, separators=(",", ":")).encode("utf8")
+        data = struct.pack(
+            "<8sIII", self._MAGIC, self._VERSION, len(payload),
+            zlib.crc32(payload) & 0xffffffff) + payload
+        # write a temporary file (mode 0600) in the same directory and
+        # atomically rename it
+        fd, tmp = tempfile.mkstemp(
+            prefix=os.path.basename(self._path) + ".", suffix=".tmp",
+            dir=os.path.dirname(os.path.abspath(self._path)))
+        try:
+            with os.fdopen(fd, "wb") as f:
+                f.write(data)
+                f.flush()
+                os.fsync(f.fileno())
+            getattr(os, "replace", os.rename)(tmp, self._path)
+        except BaseException:
+            try:
+                os.remove(tmp)
+            except OSError:
+                pass
+            raise
+
+    def load(self):
+        """Restore the baselines saved by the previous run. Baselines
+        which are already set in this process are left untouched.
+        Return False if there's nothing to restore (first run, file
+        not valid or the system was rebooted).
+        """
+        global _last_cpu_times, _last_per_cpu_times
+        global _last_cpu_times_2, _last_per_cpu_times_2
+        try:
+            state = self._read()
+        except (IOError, OSError, ValueError):
+            return False
+        if not isinstance(state, dict) or \
+                state.get("boot_id") != _boot_id():
+            return False
+        try:
+            state = _baseline_decode(state["baselines"])
+        except (KeyError, TypeError, ValueError):
+            return False
+
+        if _last_cpu_times is None:
+            _last_cpu_times = state.get("cpu_times")
+        if _last_per_cpu_times is None:
+            _last_per_cpu_times = state.get("per_cpu_times")
+        if _last_cpu_times_2 is None:
+            _last_cpu_times_2 = state.get("cpu_times_2")
+        if _last_per_cpu_times_2 is None:
+            _last_per_cpu_times_2 = state.get("per_cpu_times_2")
+        if "cpu_sched_stats" in state and \
+                globals().get("_last_cpu_sched_stats", ()) is None:
+            globals()["_last_cpu_sched_stats"] = state["cpu_sched_stats"]
+        wn = _common._wn
+        with wn.lock:
+            for name, (cache, reminders, reminder_keys) in \
+                    state.get("wrap_numbers", {}).items():
+                if name not in wn.cache:
+                    wn.cache[name] = cache
+                    wn.reminders[name] = collections.defaultdict(
+                        int, reminders)
+                    wn.reminder_keys[name] = collections.defaultdict(
+                        set, reminder_keys)
+        for name, value in state.get("rates", {}).items():
+            self._rates.setdefault(name, value)
+        return True
+
+    def save(self):
+        """Save the current baselines to the state file."""
+        wn = _common._wn
+        with wn.lock:
+            wrap_numbers = dict(
+                (name, (wn.cache[name], dict(wn.reminders[name]),
+                        dict(wn.reminder_keys[name])))
+                for name in wn.cache)
+        baselines = {
+            "cpu_times": _last_cpu_times,
+            "per_cpu_times": _last_per_cpu_times,
+            "cpu_times_2": _last_cpu_times_2,
+            "per_cpu_times_2": _last_per_cpu_times_2,
+            "wrap_numbers": wrap_numbers,
+            "rates": self._rates,
+        }
+        sched = globals().get("_last_cpu_sched_stats")
+        if sched is not None:
+            baselines["cpu_sched_stats"] = sched
+        self._write({"boot_id": _boot_id(),
+                     "baselines": _baseline_encode(baselines)})
+
+    def rates(self, name, counters):
+        """Return the per-second rate of each field of *counters* (a
+        namedtuple such as net_io_counters() return value, or a dict
+        of namedtuples such as net_io_counters(pernic=True)) since
+        the previous call with the same *name*, possibly made by a
+        previous run. The first call returns zeros. Counters which
+        decreased (reset or wrapped) are reported as zero.
+        """
+        now = _timer()
+        last = self._rates.get(name)
+        self._rates[name] = (now, counters)
+
+        def calc(t1, t2, elapsed):
+            if t1 is None or len(t1) != len(t2) or elapsed <= 0:
+                return type(t2)(*[0.0] * len(t2))
+            return type(t2)(*[max(y - x, 0) / elapsed
+                              for x, y in zip(t1, t2)])
+
+        if last is None:
+            # First call. We'll get a meaningful result on the next call.
+            last = (now, None)
+        elapsed = now - last[0]
+        if isinstance(counters, tuple):
+            prev = last[1] if isinstance(last[1], tuple) else None
+            return calc(prev, counters, elapsed)
+        prev = last[1] if isinstance(last[1], dict) else {}
+        return dict((k, calc(prev.get(k), v, elapsed))
+                    for k, v in counters.items())
+
+
 # =====================================================================
 # --- Windows services
 # =====================================================================
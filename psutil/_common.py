@@ -13,8 +13,10 @@ from __future__ import print_function
 import collections
 import contextlib
 import errno
+import fnmatch
 import functools
 import os
+import re
 import socket
 import stat
 import sys
@@ -65,8 +67,9 @@ __all__ = [
     'ENCODING', 'ENCODING_ERRS', 'AF_INET6',
     # named tuples
     'pconn', 'pcputimes', 'pctxsw', 'pgids', 'pio', 'pionice', 'popenfile',
-    'pthread', 'puids', 'sconn', 'scpustats', 'sdiskio', 'sdiskpart',
-    'sdiskusage', 'snetio', 'snicaddr', 'snicstats', 'sswap', 'suser',
+    'prusage', 'pthread', 'puids', 'sconn', 'scpustats', 'sdiskio',
+    'sdiskpart', 'sdiskusage', 'snetio', 'snicaddr', 'snicstats', 'sswap',
+    'suser',
     # utility functions
     'conn_tmap', 'deprecated_method', 'isfile_strict', 'memoize',
     'parse_environ_block', 'path_exists_strict', 'usage_percent',
@@ -237,6 +240,10 @@ pctxsw = namedtuple('pctxsw', ['voluntary', 'involuntary'])
 # psutil.Process.connections()
 pconn = namedtuple('pconn', ['fd', 'family', 'type', 'laddr', 'raddr',
                              'status'])
+# psutil.Process.wait(rusage=True)
+prusage = namedtuple('prusage', ['user', 'system', 'maxrss', 'minor_faults',
+                                 'major_faults', 'vol_ctx_switches',
+                                 'invol_ctx_switches'])
 
 # psutil.connections() and psutil.Process.connections()
 addr = namedtuple('addr', ['ip', 'port'])
@@ -498,6 +505,14 @@ def memoize_when_activated(fun):
         stored as a "_cache" instance attribute."""
         proc._cache = {}
 
+    def cache_set(proc, value):
+        """Pre-populate cache with a value computed elsewhere. This is
+        a NOOP if the cache is not active."""
+        try:
+            proc._cache[fun] = value
+        except AttributeError:
+            pass
+
     def cache_deactivate(proc):
         """Deactivate and clear cache."""
         try:
@@ -507,6 +522,7 @@ def memoize_when_activated(fun):
 
     wrapper.cache_activate = cache_activate
     wrapper.cache_deactivate = cache_deactivate
+    wrapper.cache_set = cache_set
     return wrapper
 
 
@@ -627,6 +643,43 @@ def conn_to_ntuple(fd, fam, type_, laddr, raddr, status, status_map, pid=None):
         return sconn(fd, fam, type_, laddr, raddr, status, pid)
 
 
+def name_filter(include=None, exclude=None):
+    """Return a function telling whether a device name (NIC, disk)
+    matches any of the *include* patterns and none of the *exclude*
+    ones, or None if both are None. Patterns are either glob strings,
+    which must match the whole name, or compiled regular expressions,
+    which are searched. A single pattern can be passed instead of a
+    list.
+    """
+    def compile(patterns, argname):
+        if isinstance(patterns, (str, type(u""))) or \
+                hasattr(patterns, "search"):
+            patterns = [patterns]
+        ret = []
+        for pat in patterns:
+            if isinstance(pat, (str, type(u""))):
+                ret.append(re.compile(fnmatch.translate(pat)).match)
+            elif hasattr(pat, "search"):
+                ret.append(pat.search)
+            else:
+                raise TypeError(
+                    "invalid %s pattern %r (expected a glob string or a "
+                    "compiled regex)" % (argname, pat))
+        return ret
+
+    if include is None and exclude is None:
+        return None
+    inc = compile(include, "include") if include is not None else None
+    exc = compile(exclude, "exclude") if exclude is not None else []
+
+    def match(name):
+        if inc is not None and not any(m(name) for m in inc):
+            return False
+        return not any(m(name) for m in exc)
+
+    return match
+
+
 def deprecated_method(replacement):
     """A decorator which can be used to mark a method as deprecated
     'replcement' is the method name which will be called instead.
@@ -715,16 +768,20 @@ class _WrapNumbers:
         return new_dict
 
     def cache_clear(self, name=None):
-        """Clear the internal cache, optionally only for function 'name'."""
+        """Clear the internal cache, optionally only for function 'name'
+        (including its filtered variants, named 'name:...').
+        """
         with self.lock:
             if name is None:
                 self.cache.clear()
                 self.reminders.clear()
                 self.reminder_keys.clear()
             else:
-                self.cache.pop(name, None)
-                self.reminders.pop(name, None)
-                self.reminder_keys.pop(name, None)
+                for key in list(self.cache):
+                    if key == name or key.startswith(name + ":"):
+                        self.cache.pop(key, None)
+                        self.reminders.pop(key, None)
+                        self.reminder_keys.pop(key, None)
 
     def cache_info(self):
         """Return internal cache dicts as a tuple of 3 elements."""
@@ -24,7 +24,7 @@ __all__ = [
     # literals
     "u", "b",
     # collections module
-    "lru_cache",
+    "lru_cache", "Mapping",
     # shutil module
     "which", "get_terminal_size",
     # contextlib module
@@ -428,6 +428,13 @@ except ImportError:
                 return fallback
 
 
+# python 3.3
+try:
+    from collections.abc import Mapping
+except ImportError:
+    from collections import Mapping
+
+
 # python 3.3
 try:
     from subprocess import TimeoutExpired as SubprocessTimeoutExpired
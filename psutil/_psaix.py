@@ -538,8 +538,8 @@ class Process(object):
             *cext.proc_num_ctx_switches(self.pid))
 
     @wrap_exceptions
-    def wait(self, timeout=None):
-        return _psposix.wait_pid(self.pid, timeout, self._name)
+    def wait(self, timeout=None, rusage=False):
+        return _psposix.wait_pid(self.pid, timeout, self._name, rusage)
 
     if HAS_PROC_IO_COUNTERS:
         @wrap_exceptions
@@ -803,8 +803,8 @@ class Process(object):
         return ret
 
     @wrap_exceptions
-    def wait(self, timeout=None):
-        return _psposix.wait_pid(self.pid, timeout, self._name)
+    def wait(self, timeout=None, rusage=False):
+        return _psposix.wait_pid(self.pid, timeout, self._name, rusage)
 
     @wrap_exceptions
     def nice_get(self):
@@ -6,17 +6,25 @@
 
 from __future__ import division
 
+import array
+import atexit
 import base64
+import binascii
 import collections
+import contextlib
 import errno
+import fcntl
 import functools
 import glob
+import io
 import os
 import re
 import socket
+import stat
 import struct
 import sys
-import traceback
+import threading
+import time
 import warnings
 from collections import defaultdict
 from collections import namedtuple
@@ -77,8 +85,8 @@ __extra__all__ = [
 
 
 POWER_SUPPLY_PATH = "/sys/class/power_supply"
+PAGE_IDLE_BITMAP = "/sys/kernel/mm/page_idle/bitmap"
 HAS_PROC_SMAPS = os.path.exists('/proc/%s/smaps' % os.getpid())
-HAS_PROC_SMAPS_ROLLUP = os.path.exists('/proc/%s/smaps_rollup' % os.getpid())
 HAS_PROC_IO_PRIORITY = hasattr(cext, "proc_ioprio_get")
 HAS_CPU_AFFINITY = hasattr(cext, "proc_cpu_affinity_get")
 
@@ -101,6 +109,10 @@ LITTLE_ENDIAN = sys.byteorder == 'little'
 # * https://lkml.org/lkml/2015/8/17/234
 DISK_SECTOR_SIZE = 512
 
+# ioctl() returning the parent of a namespace: _IO(0xb7, 0x2), see
+# "man ioctl_ns"
+NS_GET_PARENT = 0xb702
+
 if enum is None:
     AF_LINK = socket.AF_PACKET
 else:
@@ -181,6 +193,9 @@ popenfile = namedtuple(
 pmem = namedtuple('pmem', 'rss vms shared text lib data dirty')
 # psutil.Process().memory_full_info()
 pfullmem = namedtuple('pfullmem', pmem._fields + ('uss', 'pss', 'swap'))
+# psutil.Process().memory_info_status()
+pmemstatus = namedtuple(
+    'pmemstatus', ['rss_anon', 'rss_file', 'rss_shmem', 'swap', 'hwm'])
 # psutil.Process().memory_maps(grouped=True)
 pmmap_grouped = namedtuple(
     'pmmap_grouped',
@@ -197,6 +212,52 @@ pio = namedtuple('pio', ['read_count', 'write_count',
 pcputimes = namedtuple('pcputimes',
                        ['user', 'system', 'children_user', 'children_system',
                         'iowait'])
+# psutil.Process.sample_thread_states()
+pthreadstate = namedtuple('pthreadstate', ['status', 'wchan', 'syscall',
+                                           'samples', 'percent'])
+# psutil.cpu_affinity_histogram()
+scpuaffinity = namedtuple('scpuaffinity', ['percpu', 'tasks'])
+# psutil.cpu_sched_stats()
+scpusched = namedtuple('scpusched', ['running', 'blocked', 'run_time',
+                                     'run_delay', 'timeslices'])
+# psutil.cpu_power_states()
+scpupower = namedtuple('scpupower', ['idle', 'freq'])
+# psutil.cpu_power_states().idle
+scpuidle = namedtuple('scpuidle', ['name', 'latency', 'usage', 'time'])
+# psutil.cpu_power_states_percent()
+scpupowerpercent = namedtuple('scpupowerpercent', ['active', 'idle', 'freq'])
+# psutil.kernel_memory()
+skernelmem = namedtuple(
+    'skernelmem', ['slab', 'vmalloc', 'hugepages', 'thp', 'zram', 'zswap'])
+# psutil.kernel_memory().slab
+sslab = namedtuple('sslab', ['name', 'active_objs', 'num_objs', 'objsize',
+                             'size'])
+# psutil.kernel_memory().vmalloc
+svmalloc = namedtuple('svmalloc', ['caller', 'size', 'areas'])
+# psutil.kernel_memory().hugepages
+shugepages = namedtuple('shugepages', ['total', 'free', 'reserved',
+                                       'surplus'])
+# psutil.kernel_memory().zram
+szram = namedtuple('szram', ['orig_data_size', 'compr_data_size',
+                             'mem_used_total', 'mem_limit', 'mem_used_max',
+                             'same_pages', 'pages_compacted', 'huge_pages'])
+# psutil.kernel_memory().zswap
+szswap = namedtuple('szswap', ['pool', 'stored'])
+# psutil.ExitAccountant().tasks()
+sexitedtask = namedtuple(
+    'sexitedtask', ['pid', 'tgid', 'ppid', 'uid', 'name', 'exitcode',
+                    'create_time', 'elapsed', 'user', 'system',
+                    'minor_faults', 'major_faults', 'peak_rss',
+                    'read_chars', 'write_chars', 'read_bytes', 'write_bytes',
+                    'vol_ctx_switches', 'invol_ctx_switches', 'cpu_delay',
+                    'blkio_delay', 'swapin_delay'])
+# psutil.ExitAccountant().summary()
+sexitsummary = namedtuple(
+    'sexitsummary', ['processes', 'threads', 'user', 'system', 'peak_rss',
+                     'read_bytes', 'write_bytes', 'cpu_delay', 'blkio_delay',
+                     'swapin_delay'])
+# psutil.file_users()
+sfileuser = namedtuple('sfileuser', ['pid', 'fd', 'type', 'path'])
 
 
 # =====================================================================
@@ -243,6 +304,9 @@ def is_storage_device(name):
     "nvme0n1p1"). If name is a virtual device (e.g. "loop1", "ram")
     return True.
     """
+    ret = _block_topology.is_disk(name)
+    if ret is not None:
+        return ret
     # Re-adapted from iostat source code, see:
     # https://github.com/sysstat/sysstat/blob/
     #     97912938cd476645b267280069e83b1c8dc0e1c7/common.c#L208
@@ -256,6 +320,53 @@ def is_storage_device(name):
     return os.access(path, os.F_OK)
 
 
+# Per-thread {path: bytes} cache of the system-wide procfs files read
+# within a system_snapshot() context.
+_snapshot = threading.local()
+
+
+@contextlib.contextmanager
+def system_snapshot():
+    """Within this context system-wide procfs files such as /proc/stat
+    and /proc/meminfo are read only once (on first use) and all the
+    functions parsing them are served from the same content. Used by
+    psutil.collect(). Nested contexts share the outermost cache.
+    """
+    if getattr(_snapshot, "files", None) is not None:
+        yield
+        return
+    _snapshot.files = {}
+    try:
+        yield
+    finally:
+        _snapshot.files = None
+
+
+def open_snapshot(path):
+    """Like open_binary(), but if called within a system_snapshot()
+    context the file is read only once and its content is cached.
+    """
+    files = getattr(_snapshot, "files", None)
+    if files is None:
+        return open_binary(path)
+    try:
+        data = files[path]
+    except KeyError:
+        with open_binary(path) as f:
+            data = files[path] = f.read()
+    return io.BytesIO(data)
+
+
+@memoize
+def _has_proc_smaps_rollup():
+    # /proc/{pid}/smaps_rollup was added in Linux 4.14
+    return os.path.exists('/proc/%s/smaps_rollup' % os.getpid())
+
+
+# Set on first use by set_scputimes_ntuple(), which reads /proc/stat.
+scputimes = None
+
+
 @memoize
 def set_scputimes_ntuple(procfs_path):
     """Set a namedtuple of variable fields depending on the CPU times
@@ -265,7 +376,7 @@ def set_scputimes_ntuple(procfs_path):
     Used by cpu_times() function.
     """
     global scputimes
-    with open_binary('%s/stat' % procfs_path) as f:
+    with open_snapshot('%s/stat' % procfs_path) as f:
         values = f.readline().split()[1:]
     fields = ['user', 'nice', 'system', 'idle', 'iowait', 'irq', 'softirq']
     vlen = len(values)
@@ -281,14 +392,6 @@ def set_scputimes_ntuple(procfs_path):
     scputimes = namedtuple('scputimes', fields)
 
 
-try:
-    set_scputimes_ntuple("/proc")
-except Exception:  # pragma: no cover
-    # Don't want to crash at import time.
-    traceback.print_exc()
-    scputimes = namedtuple('scputimes', 'user system idle')(0.0, 0.0, 0.0)
-
-
 # =====================================================================
 # --- prlimit
 # =====================================================================
@@ -413,7 +516,7 @@ def virtual_memory():
     """
     missing_fields = []
     mems = {}
-    with open_binary('%s/meminfo' % get_procfs_path()) as f:
+    with open_snapshot('%s/meminfo' % get_procfs_path()) as f:
         for line in f:
             fields = line.split()
             mems[fields[0]] = int(fields[1]) * 1024
@@ -526,7 +629,7 @@ def virtual_memory():
 def swap_memory():
     """Return swap memory metrics."""
     mems = {}
-    with open_binary('%s/meminfo' % get_procfs_path()) as f:
+    with open_snapshot('%s/meminfo' % get_procfs_path()) as f:
         for line in f:
             fields = line.split()
             mems[fields[0]] = int(fields[1]) * 1024
@@ -546,7 +649,7 @@ def swap_memory():
     percent = usage_percent(used, total, round_=1)
     # get pgin/pgouts
     try:
-        f = open_binary("%s/vmstat" % get_procfs_path())
+        f = open_snapshot("%s/vmstat" % get_procfs_path())
     except IOError as err:
         # see https://github.com/giampaolo/psutil/issues/722
         msg = "'sin' and 'sout' swap memory stats couldn't " \
@@ -576,6 +679,208 @@ def swap_memory():
     return _common.sswap(total, used, free, percent, sin, sout)
 
 
+def _slab_caches(procfs_path):
+    ret = {}
+    for name, active_objs, num_objs, objsize, _, pagesperslab, num_slabs in \
+            cext.linux_slabinfo("%s/slabinfo" % procfs_path):
+        size = num_slabs * pagesperslab * PAGESIZE
+        ret[name] = sslab(name, active_objs, num_objs, objsize, size)
+    return ret
+
+
+def _slab_growth(caches):
+    # Return how much each slab cache grew since the last call.
+    global _last_slab_caches
+    with _last_slab_caches_lock:
+        last = _last_slab_caches
+        _last_slab_caches = caches
+    if last is None:
+        # First call. We'll get a meaningful result on the next call.
+        last = caches
+    ret = []
+    for name, cur in caches.items():
+        prev = last.get(name)
+        if prev is None:
+            prev = sslab(name, 0, 0, cur.objsize, 0)
+        if cur.num_objs != prev.num_objs or cur.size != prev.size:
+            ret.append(sslab(name, cur.active_objs - prev.active_objs,
+                             cur.num_objs - prev.num_objs, cur.objsize,
+                             cur.size - prev.size))
+    return ret
+
+
+_last_slab_caches = None
+_last_slab_caches_lock = threading.Lock()
+
+
+def _vmalloc_callers(procfs_path):
+    callers = {}
+    for caller, size in cext.linux_vmallocinfo(
+            "%s/vmallocinfo" % procfs_path):
+        total, areas = callers.get(caller, (0, 0))
+        callers[caller] = (total + size, areas + 1)
+    return [svmalloc(caller, size, areas)
+            for caller, (size, areas) in callers.items()]
+
+
+def _hugepages_pools():
+    # {page_size: shugepages} for all the hugetlb page sizes
+    root = "/sys/kernel/mm/hugepages"
+    fields = ("nr_hugepages", "free_hugepages", "resv_hugepages",
+              "surplus_hugepages")
+    try:
+        names = os.listdir(root)
+    except FileNotFoundError:  # CONFIG_HUGETLBFS not set
+        return {}
+    paths = [b("%s/%s/%s" % (root, name, field))
+             for name in names for field in fields]
+    data = cext.linux_read_files(paths)
+    ret = {}
+    for i, name in enumerate(names):
+        values = data[i * len(fields):(i + 1) * len(fields)]
+        if not name.startswith("hugepages-") or not name.endswith("kB") or \
+                any(isinstance(x, int) for x in values):
+            continue
+        size = int(name[len("hugepages-"):-2]) * 1024
+        ret[size] = shugepages(*[int(x) for x in values])
+    return ret
+
+
+def _zram_devices():
+    ret = {}
+    for path in glob.glob("/sys/block/zram*/mm_stat"):
+        try:
+            values = [int(x) for x in bcat(path).split()]
+        except (IOError, OSError):
+            continue  # device removed in the meantime
+        # older kernels have less fields, newer ones have more
+        values = (values + [0] * len(szram._fields))[:len(szram._fields)]
+        ret[os.path.basename(os.path.dirname(path))] = szram(*values)
+    return ret
+
+
+def kernel_memory(top=10, delta=False):
+    """Return a breakdown of the memory used by the kernel."""
+    procfs_path = get_procfs_path()
+
+    # Both files are readable by root only; /proc/slabinfo also
+    # requires CONFIG_SLUB_DEBUG.
+    try:
+        caches = _slab_caches(procfs_path)
+    except (PermissionError, FileNotFoundError):
+        slab = None
+    else:
+        slab = _slab_growth(caches) if delta else list(caches.values())
+        slab.sort(key=lambda x: x.size, reverse=True)
+        slab = slab[:top]
+    try:
+        vmalloc = _vmalloc_callers(procfs_path)
+    except (PermissionError, FileNotFoundError):
+        vmalloc = None
+    else:
+        vmalloc.sort(key=lambda x: x.size, reverse=True)
+        vmalloc = vmalloc[:top]
+
+    thp = {}
+    with open_binary("%s/vmstat" % procfs_path) as f:
+        for line in f:
+            if line.startswith(b"thp_"):
+                name, value = line.split()
+                thp[decode(name)] = int(value)
+
+    zswap = None
+    mems = {}
+    with open_binary("%s/meminfo" % procfs_path) as f:
+        for line in f:
+            if line.startswith(b"Zswap"):
+                fields = line.split()
+                mems[fields[0]] = int(fields[1]) * 1024
+    if b"Zswap:" in mems:  # Linux >= 5.19
+        zswap = szswap(mems[b"Zswap:"], mems.get(b"Zswapped:", 0))
+
+    return skernelmem(slab, vmalloc, _hugepages_pools(), thp,
+                      _zram_devices(), zswap)
+
+
+def vm_events():
+    """Return all /proc/vmstat counters as a {name: value} dict."""
+    return dict(cext.linux_vmstat("%s/vmstat" % get_procfs_path()))
+
+
+class VmEventsSampler(object):
+    """Sample a set of /proc/vmstat counters and return them as
+    per-second rates.
+
+    *keys* is a list of counter names; by default page faults, swap,
+    direct reclaim, compaction stalls, THP faults and OOM kills
+    counters are used (the ones which exist on this kernel).
+    The line of each counter in /proc/vmstat is looked up once, then
+    only those lines are parsed on every sample.
+    """
+
+    DEFAULT_KEYS = (
+        "pgfault", "pgmajfault", "pswpin", "pswpout", "pgscan_kswapd",
+        "pgscan_direct", "pgsteal_kswapd", "pgsteal_direct", "allocstall",
+        "allocstall_normal", "allocstall_movable", "compact_stall",
+        "thp_fault_alloc", "thp_fault_fallback", "oom_kill")
+    _timer = staticmethod(getattr(time, 'monotonic', time.time))
+
+    def __init__(self, keys=None):
+        self._path = "%s/vmstat" % get_procfs_path()
+        self._slots = None
+        self._last = None
+        if keys is None:
+            names = set(x[0] for x in cext.linux_vmstat(self._path))
+            self.keys = tuple(x for x in self.DEFAULT_KEYS if x in names)
+        else:
+            self.keys = tuple(keys)
+            if not self.keys:
+                raise ValueError("keys must not be empty")
+        self._lookup()
+
+    def _lookup(self):
+        lines = [x[0] for x in cext.linux_vmstat(self._path)]
+        index = dict((name, i) for i, name in enumerate(lines))
+        missing = [x for x in self.keys if x not in index]
+        if missing:
+            raise ValueError("unknown /proc/vmstat counter(s) %s" % (
+                ", ".join(repr(x) for x in missing)))
+        self._slots = [(index[x], x) for x in self.keys]
+
+    def sample(self):
+        """Return the current value of the counters as a
+        {name: value} dict.
+        """
+        values = cext.linux_vmstat_slots(self._path, self._slots)
+        if None in values:
+            # lines moved (can't happen without a reboot, but still)
+            self._lookup()
+            values = cext.linux_vmstat_slots(self._path, self._slots)
+        return dict(zip(self.keys, values))
+
+    def rates(self, interval=None):
+        """Return the per-second rate of the counters as a
+        {name: rate} dict, over *interval* seconds or since the
+        previous call (the first call returns 0.0 rates), same as
+        cpu_percent().
+        """
+        if interval is not None and interval < 0:
+            raise ValueError("interval is not positive (got %r)" % interval)
+        if interval is not None and interval > 0.0:
+            t1 = (self._timer(), self.sample())
+            time.sleep(interval)
+        else:
+            t1 = self._last
+        t2 = (self._timer(), self.sample())
+        self._last = t2
+        if t1 is None:
+            t1 = t2
+        elapsed = t2[0] - t1[0]
+        return dict(
+            (k, max(0, t2[1][k] - t1[1][k]) / elapsed if elapsed > 0 else 0.0)
+            for k in self.keys)
+
+
 # =====================================================================
 # --- CPU
 # =====================================================================
@@ -590,7 +895,7 @@ def cpu_times():
     """
     procfs_path = get_procfs_path()
     set_scputimes_ntuple(procfs_path)
-    with open_binary('%s/stat' % procfs_path) as f:
+    with open_snapshot('%s/stat' % procfs_path) as f:
         values = f.readline().split()
     fields = values[1:len(scputimes._fields) + 1]
     fields = [float(x) / CLOCK_TICKS for x in fields]
@@ -604,7 +909,7 @@ def per_cpu_times():
     procfs_path = get_procfs_path()
     set_scputimes_ntuple(procfs_path)
     cpus = []
-    with open_binary('%s/stat' % procfs_path) as f:
+    with open_snapshot('%s/stat' % procfs_path) as f:
         # get rid of the first line which refers to system wide CPU stats
         f.readline()
         for line in f:
@@ -690,7 +995,7 @@ def cpu_count_cores():
 
 def cpu_stats():
     """Return various CPU stats as a named tuple."""
-    with open_binary('%s/stat' % get_procfs_path()) as f:
+    with open_snapshot('%s/stat' % get_procfs_path()) as f:
         ctx_switches = None
         interrupts = None
         soft_interrupts = None
@@ -709,6 +1014,59 @@ def cpu_stats():
         ctx_switches, interrupts, soft_interrupts, syscalls)
 
 
+def cpu_sched_stats(percpu=False,
+                    _running_re=re.compile(br'\nprocs_running (\d+)'),
+                    _blocked_re=re.compile(br'\nprocs_blocked (\d+)')):
+    """Return the number of runnable and blocked tasks from /proc/stat
+    and the time tasks spent running and waiting for a CPU from
+    /proc/schedstat, if available (CONFIG_SCHEDSTATS).
+    """
+    procfs_path = get_procfs_path()
+    with open_snapshot('%s/stat' % procfs_path) as f:
+        data = f.read()
+    running = int(_running_re.search(data).group(1))
+    blocked = int(_blocked_re.search(data).group(1))
+    try:
+        cpus = cext.linux_schedstat('%s/schedstat' % procfs_path)
+    except FileNotFoundError:
+        if percpu:
+            return scpusched(running, blocked, [], [], [])
+        return scpusched(running, blocked, None, None, None)
+    run_time = [x[1] / 1e9 for x in cpus]
+    run_delay = [x[2] / 1e9 for x in cpus]
+    timeslices = [x[3] for x in cpus]
+    if percpu:
+        return scpusched(running, blocked, run_time, run_delay, timeslices)
+    return scpusched(running, blocked, sum(run_time), sum(run_delay),
+                     sum(timeslices))
+
+
+if HAS_CPU_AFFINITY:
+
+    def cpu_affinity_histogram(pids, threads=True, pinned_only=False):
+        """Return how many tasks (threads or processes) are allowed to
+        run on each CPU, plus the number of tasks which were inspected.
+        The affinity masks are retrieved in C in a single pass, without
+        creating a list per task.
+        """
+        procfs_path = get_procfs_path()
+        if threads:
+            tids = []
+            for pid in pids:
+                try:
+                    names = os.listdir("%s/%s/task" % (procfs_path, pid))
+                except (FileNotFoundError, ProcessLookupError,
+                        PermissionError):
+                    # process is gone or we're not allowed to list
+                    # its threads
+                    continue
+                tids.extend(int(x) for x in names if x.isdigit())
+        else:
+            tids = list(pids)
+        percpu, tasks = cext.cpu_affinity_histogram(tids, pinned_only)
+        return scpuaffinity(percpu, tasks)
+
+
 def _cpu_get_cpuinfo_freq():
     """Return current CPU frequency from cpuinfo if available.
     """
@@ -720,46 +1078,274 @@ def _cpu_get_cpuinfo_freq():
     return ret
 
 
-if os.path.exists("/sys/devices/system/cpu/cpufreq/policy0") or \
-        os.path.exists("/sys/devices/system/cpu/cpu0/cpufreq"):
-    def cpu_freq():
-        """Return frequency metrics for all CPUs.
-        Contrarily to other OSes, Linux updates these values in
-        real-time.
-        """
-        cpuinfo_freqs = _cpu_get_cpuinfo_freq()
+def cpu_freq():
+    """Return frequency metrics for all CPUs.
+    Contrarily to other OSes, Linux updates these values in
+    real-time.
+    """
+    cpuinfo_freqs = _cpu_get_cpuinfo_freq()
+    paths = []
+    if os.path.exists("/sys/devices/system/cpu/cpufreq/policy0") or \
+            os.path.exists("/sys/devices/system/cpu/cpu0/cpufreq"):
         paths = \
             glob.glob("/sys/devices/system/cpu/cpufreq/policy[0-9]*") or \
             glob.glob("/sys/devices/system/cpu/cpu[0-9]*/cpufreq")
-        paths.sort(key=lambda x: int(re.search(r"[0-9]+", x).group()))
-        ret = []
-        pjoin = os.path.join
-        for i, path in enumerate(paths):
-            if len(paths) == len(cpuinfo_freqs):
-                # take cached value from cpuinfo if available, see:
-                # https://github.com/giampaolo/psutil/issues/1851
-                curr = cpuinfo_freqs[i] * 1000
-            else:
-                curr = bcat(pjoin(path, "scaling_cur_freq"), fallback=None)
+    if not paths:
+        # Use /proc/cpuinfo. min and max frequencies are not
+        # available and are set to 0.
+        return [_common.scpufreq(x, 0., 0.) for x in cpuinfo_freqs]
+
+    paths.sort(key=lambda x: int(re.search(r"[0-9]+", x).group()))
+    ret = []
+    pjoin = os.path.join
+    for i, path in enumerate(paths):
+        if len(paths) == len(cpuinfo_freqs):
+            # take cached value from cpuinfo if available, see:
+            # https://github.com/giampaolo/psutil/issues/1851
+            curr = cpuinfo_freqs[i] * 1000
+        else:
+            curr = bcat(pjoin(path, "scaling_cur_freq"), fallback=None)
+        if curr is None:
+            # Likely an old RedHat, see:
+            # https://github.com/giampaolo/psutil/issues/1071
+            curr = bcat(pjoin(path, "cpuinfo_cur_freq"), fallback=None)
             if curr is None:
-                # Likely an old RedHat, see:
-                # https://github.com/giampaolo/psutil/issues/1071
-                curr = bcat(pjoin(path, "cpuinfo_cur_freq"), fallback=None)
-                if curr is None:
-                    raise NotImplementedError(
-                        "can't find current frequency file")
-            curr = int(curr) / 1000
-            max_ = int(bcat(pjoin(path, "scaling_max_freq"))) / 1000
-            min_ = int(bcat(pjoin(path, "scaling_min_freq"))) / 1000
-            ret.append(_common.scpufreq(curr, min_, max_))
+                raise NotImplementedError(
+                    "can't find current frequency file")
+        curr = int(curr) / 1000
+        max_ = int(bcat(pjoin(path, "scaling_max_freq"))) / 1000
+        min_ = int(bcat(pjoin(path, "scaling_min_freq"))) / 1000
+        ret.append(_common.scpufreq(curr, min_, max_))
+    return ret
+
+
+CPU_SYSFS_PATH = "/sys/devices/system/cpu"
+# Max number of cpuidle / cpufreq files kept open by cpu_power_states()
+# (about 9 per CPU). Beyond that they're opened on every call, so as not
+# to eat the process RLIMIT_NOFILE.
+CPU_POWER_MAX_FDS = 256
+
+
+def _parse_cpu_list(s):
+    # "0-3,6" -> [0, 1, 2, 3, 6]
+    ret = []
+    for chunk in s.split(","):
+        if "-" in chunk:
+            lo, hi = chunk.split("-")
+            ret.extend(range(int(lo), int(hi) + 1))
+        elif chunk:
+            ret.append(int(chunk))
+    return ret
+
+
+def _format_cpu_list(cpus):
+    # [0, 1, 2, 3, 6] -> "0-3,6"
+    ranges = []
+    for cpu in sorted(set(cpus)):
+        if ranges and ranges[-1][1] == cpu - 1:
+            ranges[-1][1] = cpu
+        else:
+            ranges.append([cpu, cpu])
+    return ",".join(str(lo) if lo == hi else "%s-%s" % (lo, hi)
+                    for lo, hi in ranges)
+
+
+class _CpuPowerFiles:
+    """Keeps the cpuidle usage / time files and the cpufreq
+    time_in_state files of all online CPUs open, so that reading them
+    costs one pread() each, all done in one cext.linux_read_files()
+    call. Static info (idle state names and latencies) is read once.
+    The files are re-opened when the set of online CPUs changes or a
+    file can no longer be read (e.g. the cpufreq driver is reloaded).
+    If more than CPU_POWER_MAX_FDS files are needed (big hosts) or they
+    can't be opened (e.g. EMFILE), only their paths are kept and they
+    are opened and closed on every call instead.
+    """
+
+    def __init__(self):
+        self.root = None
+        self.online = None
+        # [(cpu, [(state_name, latency), ...], has_freq_stats), ...]
+        self.layout = []
+        # the fds or (if there are too many) the paths of the files
+        self.files = []
+        self.lock = threading.Lock()
+
+    def close(self):
+        for fd in self.files:
+            if isinstance(fd, int):
+                os.close(fd)
+        self.files = []
+        self.layout = []
+        self.online = None
+
+    def open(self, paths):
+        # All or nothing.
+        fds = []
+        try:
+            for path in paths:
+                fds.append(os.open(path, os.O_RDONLY))
+        except OSError as err:
+            debug(err)
+            for fd in fds:
+                os.close(fd)
+            return [b(x) for x in paths]
+        return fds
+
+    def scan(self, root, online):
+        self.close()
+        layout = []
+        paths = []
+        for cpu in _parse_cpu_list(online.decode().strip()):
+            base = "%s/cpu%s" % (root, cpu)
+            states = []
+            names = glob.glob("%s/cpuidle/state[0-9]*" % base)
+            names.sort(key=lambda x: int(x.rsplit("state", 1)[1]))
+            for path in names:
+                try:
+                    name = cat("%s/name" % path).strip()
+                    latency = int(cat("%s/latency" % path)) / 1000000.0
+                except (FileNotFoundError, PermissionError):
+                    break
+                files = ["%s/usage" % path, "%s/time" % path]
+                if not all(os.access(x, os.R_OK) for x in files):
+                    break
+                states.append((name, latency))
+                paths.extend(files)
+            path = "%s/cpufreq/stats/time_in_state" % base
+            has_freq = os.access(path, os.R_OK)
+            if has_freq:
+                paths.append(path)
+            layout.append((cpu, states, has_freq))
+        if len(paths) <= CPU_POWER_MAX_FDS:
+            self.files = self.open(paths)
+        else:
+            self.files = [b(x) for x in paths]
+        self.layout = layout
+        self.root = root
+        self.online = online
+
+    def read(self, root):
+        """Return the layout and the content of all the files."""
+        online_path = b("%s/online" % root)
+        with self.lock:
+            if root != self.root:
+                self.close()
+            for _ in range(2):
+                if self.online is None:
+                    self.scan(root, bcat(online_path))
+                data = cext.linux_read_files([online_path] + self.files)
+                if isinstance(data[0], int):
+                    raise OSError(data[0], os.strerror(data[0]), online_path)
+                if data[0] == self.online and \
+                        not any(isinstance(x, int) for x in data[1:]):
+                    return self.layout, data[1:]
+                self.online = None  # CPU hotplug or driver change
+            err = [x for x in data[1:] if isinstance(x, int)][0]
+            raise OSError(err, os.strerror(err))
+
+
+_cpu_power_files = _CpuPowerFiles()
+
+
+def cpu_power_states(percpu=True):
+    """Return idle states (C-states) and frequencies (P-states)
+    residency of online CPUs.
+    """
+    layout, data = _cpu_power_files.read(CPU_SYSFS_PATH)
+    if not any(states or has_freq for _, states, has_freq in layout):
+        raise NotImplementedError(
+            "neither cpuidle nor cpufreq stats are available")
+    data = iter(data)
+    ret = []
+    for _, states, has_freq in layout:
+        idle = [scpuidle(name, latency, int(next(data)),
+                         int(next(data)) / 1000000.0)
+                for name, latency in states]
+        freq = {}
+        if has_freq:
+            # "{kHz} {time in 10ms units}" lines
+            for line in next(data).splitlines():
+                khz, ticks = line.split()
+                freq[int(khz) / 1000.0] = int(ticks) / 100.0
+        ret.append(scpupower(idle, freq))
+    if percpu:
         return ret
 
-else:
-    def cpu_freq():
-        """Alternate implementation using /proc/cpuinfo.
-        min and max frequencies are not available and are set to None.
-        """
-        return [_common.scpufreq(x, 0., 0.) for x in _cpu_get_cpuinfo_freq()]
+    # Sum the times of same-named idle states and frequencies. CPUs
+    # may differ (e.g. big.LITTLE), hence the dicts.
+    idle = collections.OrderedDict()
+    freq = {}
+    for cpu in ret:
+        for state in cpu.idle:
+            if state.name in idle:
+                prev = idle[state.name]
+                state = scpuidle(state.name, max(prev.latency, state.latency),
+                                 prev.usage + state.usage,
+                                 prev.time + state.time)
+            idle[state.name] = state
+        for mhz, secs in cpu.freq.items():
+            freq[mhz] = freq.get(mhz, 0) + secs
+    return scpupower(list(idle.values()), freq)
+
+
+def cpu_power_states_percent(t1, t2, elapsed):
+    """Given two cpu_power_states(percpu=True) results taken *elapsed*
+    seconds apart return the percentage of time each CPU spent in each
+    idle state (and not idle) and at each frequency.
+    """
+    ret = []
+    for cpu1, cpu2 in zip(t1, t2):
+        idle = collections.OrderedDict()
+        prev = dict((x.name, x.time) for x in cpu1.idle)
+        for state in cpu2.idle:
+            delta = state.time - prev.get(state.name, state.time)
+            perc = delta / elapsed * 100 if elapsed > 0 else 0.0
+            idle[state.name] = round(min(max(0.0, perc), 100.0), 1)
+        active = round(max(0.0, 100.0 - sum(idle.values())), 1)
+        deltas = dict((mhz, max(0, secs - cpu1.freq.get(mhz, secs)))
+                      for mhz, secs in cpu2.freq.items())
+        total = sum(deltas.values())
+        freq = dict((mhz, round(delta / total * 100, 1) if total else 0.0)
+                    for mhz, delta in deltas.items())
+        ret.append(scpupowerpercent(active, idle, freq))
+    return ret
+
+
+_cpu_topology_cache = {}
+
+
+def cpu_topology():
+    """Return a list of (core, socket, numa_node) tuples, one for each
+    online CPU, in the same order as per_cpu_times(). *core* is a
+    (socket, core_id) tuple. The map is cached until the set of online
+    CPUs changes.
+    """
+    online = bcat("%s/online" % CPU_SYSFS_PATH).strip()
+    try:
+        return _cpu_topology_cache[online]
+    except KeyError:
+        pass
+    cpus = _parse_cpu_list(online.decode())
+    paths = []
+    for cpu in cpus:
+        for name in ("physical_package_id", "core_id"):
+            paths.append(b("%s/cpu%s/topology/%s" % (CPU_SYSFS_PATH, cpu,
+                                                     name)))
+    data = cext.linux_read_files(paths)
+    ret = []
+    for i, cpu in enumerate(cpus):
+        socket_, core = data[i * 2:i * 2 + 2]
+        # topology files may be missing (e.g. some ARM VMs)
+        socket_ = 0 if isinstance(socket_, int) else int(socket_)
+        core = cpu if isinstance(core, int) else int(core)
+        # cpuN/nodeM symlinks exist only if CONFIG_NUMA is set
+        nodes = glob.glob("%s/cpu%s/node[0-9]*" % (CPU_SYSFS_PATH, cpu))
+        node = int(os.path.basename(nodes[0])[4:]) if nodes else 0
+        ret.append(((socket_, core), socket_, node))
+    _cpu_topology_cache.clear()
+    _cpu_topology_cache[online] = ret
+    return ret
 
 
 # =====================================================================
@@ -1020,9 +1606,86 @@ def net_connections(kind='inet'):
     return _connections.retrieve(kind)
 
 
-def net_io_counters():
+def port_owners(port, kind='tcp', state=_common.CONN_LISTEN):
+    """Return the inet sockets bound to a local *port*, along with the
+    PID and fd of the process holding them. Rather than mapping the
+    sockets of all processes as net_connections() does, the matching
+    sockets are found first, then /proc/*/fd is scanned in C only
+    until all of them are resolved.
+    """
+    tmap = _connections.tmap
+    if kind not in tmap or kind in ('all', 'unix'):
+        raise ValueError("invalid %r kind argument; choose between %s" % (
+            kind, ', '.join(repr(x) for x in sorted(tmap)
+                            if x not in ('all', 'unix'))))
+    if not 0 <= port <= 65535:
+        raise ValueError("invalid port %r" % port)
+    procfs_path = get_procfs_path()
+    # sl: local_address rem_address st tx:rx tr:when retrnsmt uid
+    # timeout inode
+    regex = re.compile(
+        br"^ *\d+: ([0-9A-F]+:" + ("%04X" % port).encode('ascii') +
+        br") ([0-9A-F]+:[0-9A-F]{4}) ([0-9A-F]{2})(?: +\S+){5} +(\d+)",
+        re.MULTILINE)
+    sockets = {}
+    # sockets no longer held by any process (e.g. TIME_WAIT), which
+    # all have inode 0
+    orphans = []
+    for proto_name, family, type_ in tmap[kind]:
+        path = "%s/net/%s" % (procfs_path, proto_name)
+        try:
+            data = bcat(path)
+        except FileNotFoundError:
+            if proto_name.endswith('6'):
+                continue  # IPv6 not supported
+            raise
+        for laddr, raddr, status, inode in regex.findall(data):
+            if type_ == socket.SOCK_STREAM:
+                status = TCP_STATUSES[decode(status)]
+                if state is not None and status != state:
+                    continue
+            else:
+                # UDP sockets have no state; "listening" ones are
+                # the ones not connected to a remote address
+                status = _common.CONN_NONE
+                if state == _common.CONN_LISTEN:
+                    if not raddr.endswith(b":0000"):
+                        continue
+                elif state not in (None, _common.CONN_NONE):
+                    continue
+            try:
+                laddr = Connections.decode_address(decode(laddr), family)
+                raddr = Connections.decode_address(decode(raddr), family)
+            except _Ipv6UnsupportedError:
+                continue
+            if inode == b"0":
+                orphans.append((family, type_, laddr, raddr, status))
+            else:
+                sockets[int(inode)] = (family, type_, laddr, raddr, status)
+
+    ret = []
+    owned = set()
+    if sockets:
+        for inode, pid, fd in cext.linux_socket_owners(procfs_path,
+                                                       list(sockets)):
+            owned.add(inode)
+            family, type_, laddr, raddr, status = sockets[inode]
+            ret.append(_common.sconn(fd, family, type_, laddr, raddr,
+                                     status, pid))
+    # sockets owned by processes we're not allowed to inspect, or by
+    # no process at all
+    for inode in set(sockets) - owned:
+        orphans.append(sockets[inode])
+    for family, type_, laddr, raddr, status in orphans:
+        ret.append(_common.sconn(-1, family, type_, laddr, raddr, status,
+                                 None))
+    return ret
+
+
+def net_io_counters(match=None):
     """Return network I/O statistics for every network interface
-    installed on the system as a dict of raw tuples.
+    installed on the system as a dict of raw tuples. If *match* is
+    given only the interfaces whose name it's true for are parsed.
     """
     with open_text("%s/net/dev" % get_procfs_path()) as f:
         lines = f.readlines()
@@ -1031,6 +1694,8 @@ def net_io_counters():
         colon = line.rfind(':')
         assert colon > 0, repr(line)
         name = line[:colon].strip()
+        if match is not None and not match(name):
+            continue
         fields = line[colon + 1:].strip().split()
 
         # in
@@ -1057,12 +1722,12 @@ def net_io_counters():
     return retdict
 
 
-def net_if_stats():
+def net_if_stats(match=None):
     """Get NIC stats (isup, duplex, speed, mtu)."""
     duplex_map = {cext.DUPLEX_FULL: NIC_DUPLEX_FULL,
                   cext.DUPLEX_HALF: NIC_DUPLEX_HALF,
                   cext.DUPLEX_UNKNOWN: NIC_DUPLEX_UNKNOWN}
-    names = net_io_counters().keys()
+    names = net_io_counters(match=match).keys()
     ret = {}
     for name in names:
         try:
@@ -1090,10 +1755,234 @@ def net_if_stats():
 
 disk_usage = _psposix.disk_usage
 
+# see: linux/netlink.h
+NETLINK_KOBJECT_UEVENT = 15
+
+_blocktopo = namedtuple(
+    '_blocktopo', ['disks', 'partitions', 'devnos', 'slaves', 'generation'])
+
+
+class BlockTopology:
+    """A cache of the block devices topology, built from /sys/class/block:
+
+    - disks: the set of whole disks (e.g. "sda", "nvme0n1", "dm-0", "md0",
+      "loop0"), that is everything listed in /sys/block
+    - partitions: a {partition: disk} dict (e.g. {"sda1": "sda"})
+    - devnos: a {(major, minor): name} dict
+    - slaves: a {name: [name, ...]} dict of the devices a device-mapper or
+      MD device is built on top of (e.g. {"dm-0": ["sda2"]})
+
+    Names are the same ones used in /proc/diskstats. The cache is
+    invalidated when /proc/partitions content changes or when the
+    kernel sends a "block" uevent (via a NETLINK_KOBJECT_UEVENT socket),
+    which also catches changes /proc/partitions doesn't show. The
+    socket alone is not enough: the kernel sends uevents to the initial
+    network namespace only, so in a container with its own netns it
+    works but never receives anything. Also, looking up an unknown
+    name triggers a refresh (once, until the topology changes), in case
+    an event was missed.
+    """
 
-def disk_io_counters(perdisk=False):
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._topo = None
+        self._sock = None
+        self._sock_pid = None
+        # names which were not found after the last refresh
+        self._unknown = set()
+
+    # --- invalidation
+
+    def _open_socket(self):
+        try:
+            sock = socket.socket(
+                socket.AF_NETLINK, socket.SOCK_DGRAM, NETLINK_KOBJECT_UEVENT)
+        except (AttributeError, socket.error) as err:
+            debug(err)
+            return None
+        try:
+            sock.setblocking(False)
+            sock.bind((0, 1))  # kernel events multicast group
+        except socket.error as err:
+            debug(err)
+            sock.close()
+            return None
+        return sock
+
+    def _poll_events(self):
+        """Drain pending uevents and return True if any block device
+        was added / removed / changed.
+        """
+        if self._sock_pid != os.getpid():
+            # first call or we forked (the socket is shared with the
+            # parent, which may consume our events)
+            if self._sock is not None:
+                self._sock.close()
+            self._sock = self._open_socket()
+            self._sock_pid = os.getpid()
+            return True
+        if self._sock is None:
+            return False
+        changed = False
+        while True:
+            try:
+                data = self._sock.recv(65536)
+            except socket.error as err:
+                if err.errno in (errno.EAGAIN, errno.EWOULDBLOCK):
+                    break
+                # ENOBUFS: the receive queue overflowed; events lost
+                debug(err)
+                changed = True
+                break
+            if b"\0SUBSYSTEM=block\0" in data:
+                changed = True
+        return changed
+
+    def close(self):
+        with self._lock:
+            if self._sock is not None:
+                self._sock.close()
+                self._sock = None
+            self._sock_pid = None
+            self._topo = None
+
+    def _generation(self):
+        try:
+            return bcat("%s/partitions" % get_procfs_path())
+        except (IOError, OSError):
+            return None
+
+    # --- cache management
+
+    def _scan(self):
+        disks = set()
+        partitions = {}
+        devnos = {}
+        slaves = {}
+        root = "/sys/class/block"
+        try:
+            entries = os.listdir(root)
+        except OSError as err:
+            # no sysfs (e.g. containers, chroots); is_storage_device()
+            # falls back on checking /sys/block
+            debug(err)
+            return disks, partitions, devnos, slaves
+        for entry in entries:
+            path = os.path.join(root, entry)
+            name = entry.replace('!', '/')
+            try:
+                dev = cat(os.path.join(path, "dev")).strip()
+                major, minor = dev.split(':')
+                devnos[(int(major), int(minor))] = name
+                if os.path.exists(os.path.join(path, "partition")):
+                    parent = os.path.basename(
+                        os.path.dirname(os.path.realpath(path)))
+                    partitions[name] = parent.replace('!', '/')
+                else:
+                    disks.add(name)
+                    names = os.listdir(os.path.join(path, "slaves"))
+                    if names:
+                        slaves[name] = [x.replace('!', '/') for x in names]
+            except (IOError, OSError, ValueError) as err:
+                # device removed in the meantime, or old kernel
+                debug(err)
+        return disks, partitions, devnos, slaves
+
+    def _refresh(self):
+        # must be called with the lock held
+        topo = _blocktopo(*self._scan() + (self._generation(), ))
+        if self._topo is None or topo[:4] != self._topo[:4]:
+            # names which were unknown may exist now
+            self._unknown = set()
+        self._topo = topo
+        return topo
+
+    def refresh(self):
+        """Rebuild the cache and return it."""
+        with self._lock:
+            return self._refresh()
+
+    def _refresh_on_miss(self, key):
+        # An unknown name may be a device added after the last refresh
+        # (and whose uevent we missed). Refresh only once per name, until
+        # the topology changes.
+        with self._lock:
+            if key in self._unknown:
+                return self._topo
+            topo = self._refresh()
+            self._unknown.add(key)
+            return topo
+
+    def get(self):
+        """Return the cached topology, refreshing it first if it's
+        known to be stale.
+        """
+        with self._lock:
+            topo = self._topo
+            changed = self._poll_events() or (
+                topo is not None and topo.generation != self._generation())
+        if topo is None or changed:
+            topo = self.refresh()
+        return topo
+
+    def _cached(self):
+        # Like get() but doesn't check whether the cache is stale:
+        # callers which do many lookups are supposed to call get()
+        # first.
+        return self._topo or self.get()
+
+    # --- lookups
+
+    def is_disk(self, name):
+        """Return True if name is a whole disk, False if it's a
+        partition, None if it's unknown.
+        """
+        topo = self._cached()
+        if name not in topo.disks and name not in topo.partitions:
+            topo = self._refresh_on_miss(name)
+        if name in topo.disks:
+            return True
+        if name in topo.partitions:
+            return False
+        return None
+
+    def name_from_devno(self, major, minor):
+        key = (major, minor)
+        topo = self._cached()
+        if key not in topo.devnos:
+            topo = self._refresh_on_miss(key)
+        return topo.devnos.get(key)
+
+    def physical_disks(self, name):
+        """Return the list of whole disks the given device (a disk, a
+        partition, a device-mapper or MD device) is stored on.
+        """
+        topo = self._cached()
+        ret = []
+        seen = set()
+        stack = [name]
+        while stack:
+            name = stack.pop()
+            if name in seen:
+                continue
+            seen.add(name)
+            if name in topo.partitions:
+                name = topo.partitions[name]
+            if name in topo.slaves:
+                stack.extend(topo.slaves[name])
+            elif name in topo.disks and name not in ret:
+                ret.append(name)
+        return sorted(ret)
+
+
+_block_topology = BlockTopology()
+atexit.register(_block_topology.close)
+
+
+def disk_io_counters(perdisk=False, match=None):
     """Return disk I/O statistics for every disk installed on the
-    system as a dict of raw tuples.
+    system as a dict of raw tuples. If *match* is given only the disks
+    whose name it's true for are parsed.
     """
     def read_procfs():
         # OK, this is a bit confusing. The format of /proc/diskstats can
@@ -1117,6 +2006,9 @@ def disk_io_counters(perdisk=False):
         for line in lines:
             fields = line.split()
             flen = len(fields)
+            if match is not None and flen >= 7 and \
+                    not match(fields[3] if flen == 15 else fields[2]):
+                continue
             if flen == 15:
                 # Linux 2.4
                 name = fields[3]
@@ -1143,9 +2035,11 @@ def disk_io_counters(perdisk=False):
             for root, _, files in os.walk(os.path.join('/sys/block', block)):
                 if 'stat' not in files:
                     continue
+                name = os.path.basename(root)
+                if match is not None and not match(name):
+                    continue
                 with open_text(os.path.join(root, 'stat')) as f:
                     fields = f.read().strip().split()
-                name = os.path.basename(root)
                 (reads, reads_merged, rbytes, rtime, writes, writes_merged,
                     wbytes, wtime, _, busy_time) = map(int, fields[:10])
                 yield (name, reads, writes, rbytes, wbytes, rtime,
@@ -1160,6 +2054,13 @@ def disk_io_counters(perdisk=False):
             "%s/diskstats nor /sys/block filesystem are available on this "
             "system" % get_procfs_path())
 
+    if not perdisk:
+        # is_storage_device() relies on this being fresh
+        try:
+            _block_topology.get()
+        except (IOError, OSError) as err:
+            debug(err)
+
     retdict = {}
     for entry in gen:
         (name, reads, writes, rbytes, wbytes, rtime, wtime, reads_merged,
@@ -1200,6 +2101,11 @@ class RootFsDeviceFinder:
         self.major = os.major(dev)
         self.minor = os.minor(dev)
 
+    def ask_block_topology(self):
+        name = _block_topology.name_from_devno(self.major, self.minor)
+        if name:
+            return "/dev/%s" % name
+
     def ask_proc_partitions(self):
         with open_text("%s/partitions" % get_procfs_path()) as f:
             for line in f.readlines()[2:]:
@@ -1239,6 +2145,10 @@ class RootFsDeviceFinder:
 
     def find(self):
         path = None
+        try:
+            path = self.ask_block_topology()
+        except (IOError, OSError) as err:
+            debug(err)
         if path is None:
             try:
                 path = self.ask_proc_partitions()
@@ -1301,6 +2211,32 @@ def disk_partitions(all=False):
     return retlist
 
 
+def disk_mount_disks(all=False):
+    """Return a {mountpoint: [disk, ...]} dict mapping mounted
+    filesystems to the whole disks they're stored on.
+    """
+    topo = _block_topology.get()
+    ret = {}
+    for part in disk_partitions(all=all):
+        name = None
+        try:
+            st = os.stat(part.device)
+        except (IOError, OSError):
+            # e.g. /dev not mounted in a container
+            st = None
+        if st is not None and stat.S_ISBLK(st.st_mode):
+            name = topo.devnos.get(
+                (os.major(st.st_rdev), os.minor(st.st_rdev)))
+        if name is None and part.device.startswith("/dev/"):
+            name = os.path.basename(os.path.realpath(part.device))
+        if name is None:
+            continue
+        disks = _block_topology.physical_disks(name)
+        if disks:
+            ret[part.mountpoint] = disks
+    return ret
+
+
 # =====================================================================
 # --- sensors
 # =====================================================================
@@ -1569,7 +2505,7 @@ def boot_time():
     """Return the system boot time expressed in seconds since the epoch."""
     global BOOT_TIME
     path = '%s/stat' % get_procfs_path()
-    with open_binary(path) as f:
+    with open_snapshot(path) as f:
         for line in f:
             if line.startswith(b'btime'):
                 ret = float(line.strip().split()[1])
@@ -1579,14 +2515,46 @@ def boot_time():
             "line 'btime' not found in %s" % path)
 
 
+def boot_id():
+    """Return a random ID which identifies the current boot."""
+    return cat('%s/sys/kernel/random/boot_id' % get_procfs_path()).strip()
+
+
 # =====================================================================
 # --- processes
 # =====================================================================
 
 
+def _int_array(data):
+    ret = array.array('i')
+    if PY3:
+        ret.frombytes(data)
+    else:
+        ret.fromstring(data)
+    return ret
+
+
+def pids_array():
+    """Returns a sorted array('i') of the PIDs currently running on
+    the system.
+    """
+    return _int_array(cext.linux_pids(get_procfs_path()))
+
+
 def pids():
     """Returns a list of PIDs currently running on the system."""
-    return [int(x) for x in os.listdir(b(get_procfs_path())) if x.isdigit()]
+    return pids_array().tolist()
+
+
+def pids_since(previous):
+    """Given an iterable of previously seen PIDs return a
+    (current, new, gone) tuple of sorted arrays of PIDs.
+    """
+    if not isinstance(previous, array.array) or previous.typecode != 'i':
+        previous = array.array('i', previous)
+    current = pids_array()
+    new, gone = cext.linux_pids_diff(previous, current)
+    return (current, _int_array(new), _int_array(gone))
 
 
 def pid_exists(pid):
@@ -1627,22 +2595,373 @@ def ppid_map():
     """
     ret = {}
     procfs_path = get_procfs_path()
-    for pid in pids():
-        try:
-            with open_binary("%s/%s/stat" % (procfs_path, pid)) as f:
-                data = f.read()
-        except (FileNotFoundError, ProcessLookupError):
+    pids_ = pids()
+    paths = [b("%s/%s/stat" % (procfs_path, pid)) for pid in pids_]
+    for pid, path, data in zip(pids_, paths, cext.linux_read_files(paths)):
+        if isinstance(data, int):
             # Note: we should be able to access /stat for all processes
             # aka it's unlikely we'll bump into EPERM, which is good.
-            pass
-        else:
-            rpar = data.rfind(b')')
-            dset = data[rpar + 2:].split()
-            ppid = int(dset[1])
-            ret[pid] = ppid
+            if data in (errno.ENOENT, errno.ESRCH):
+                continue
+            raise OSError(data, os.strerror(data), path)
+        rpar = data.rfind(b')')
+        dset = data[rpar + 2:].split()
+        ppid = int(dset[1])
+        ret[pid] = ppid
+    return ret
+
+
+@memoize
+def _has_nspid(procfs_path):
+    # the "NSpid:" line of /proc/{pid}/status was added in Linux 4.1
+    return b"\nNSpid:" in bcat("%s/self/status" % procfs_path)
+
+
+def _parse_nspid(data, _re=re.compile(br'\nNSpid:([\t \d]+)')):
+    # Return the "NSpid:" line of /proc/{pid}/status as a list of ints:
+    # the PID in each namespace, from the outermost to the innermost.
+    m = _re.search(data)
+    if m is None:
+        # Linux < 4.1
+        raise NotImplementedError("NSpid not available in status file")
+    return [int(x) for x in m.group(1).split()]
+
+
+def _pidns_inodes(path, depth):
+    """Return the inode numbers identifying the PID namespace *path*
+    refers to and up to *depth* of its ancestors, innermost first.
+    Ancestors are retrieved via NS_GET_PARENT ioctl() (Linux >= 4.9)
+    and may be less than requested.
+    """
+    fd = os.open(path, os.O_RDONLY)
+    try:
+        ret = [os.fstat(fd).st_ino]
+        while len(ret) <= depth:
+            try:
+                parent = fcntl.ioctl(fd, NS_GET_PARENT)
+            except (IOError, OSError):
+                # ENOTTY: Linux < 4.9; EPERM: outside of our namespace
+                break
+            os.close(fd)
+            fd = parent
+            ret.append(os.fstat(fd).st_ino)
+    finally:
+        os.close(fd)
+    return ret
+
+
+def pid_namespace_map():
+    """Return a {(pidns_inode, ns_pid): pid, ...} dict translating
+    the PID of all processes in each PID namespace they belong to
+    into the PID seen by us.
+    """
+    procfs_path = get_procfs_path()
+    if not _has_nspid(procfs_path):
+        raise NotImplementedError(
+            "pid_namespace_map() requires Linux >= 4.1 (NSpid)")
+    # The outermost namespace is the one procfs was mounted from,
+    # which usually is ours.
+    own = _parse_nspid(bcat("%s/self/status" % procfs_path))
+    own_ns = _pidns_inodes("%s/self/ns/pid" % procfs_path, len(own) - 1)
+    root_ns = own_ns[len(own) - 1] if len(own_ns) == len(own) else None
+    chains = {}  # innermost namespace inode -> inodes of its ancestors
+    ret = {}
+    pids_ = pids()
+    paths = [b("%s/%s/status" % (procfs_path, pid)) for pid in pids_]
+    for pid, path, data in zip(pids_, paths, cext.linux_read_files(paths)):
+        if isinstance(data, int):
+            if data in (errno.ENOENT, errno.ESRCH):
+                continue
+            raise OSError(data, os.strerror(data), path)
+        nspids = _parse_nspid(data)
+        if root_ns is not None:
+            ret[(root_ns, nspids[0])] = pid
+        if len(nspids) == 1:
+            continue  # not in a nested namespace
+        # Only containerized processes are stat()ed. This requires
+        # the same privileges needed to ptrace() the process.
+        nspath = "%s/%s/ns/pid" % (procfs_path, pid)
+        try:
+            inode = os.stat(nspath).st_ino
+            if inode not in chains:
+                chains[inode] = _pidns_inodes(nspath, len(nspids) - 2)
+        except (PermissionError, FileNotFoundError, ProcessLookupError):
+            continue
+        for i, ns in enumerate(chains[inode]):
+            ret[(ns, nspids[-1 - i])] = pid
     return ret
 
 
+def _exited_task(tup):
+    (pid, tgid, ppid, uid, name, status, btime, etime, utime, stime,
+     minflt, majflt, hiwater_rss, rchar, wchar, read_bytes, write_bytes,
+     nvcsw, nivcsw, cpu_delay, blkio_delay, swapin_delay) = tup
+    # ac_exitcode is a wait() status; ac_tgid is 0 on Linux < 5.17, in
+    # which case threads can't be told apart from processes
+    if os.WIFSIGNALED(status):
+        exitcode = -os.WTERMSIG(status)
+    else:
+        exitcode = os.WEXITSTATUS(status)
+    return sexitedtask(
+        pid, tgid or pid, ppid, uid, name, exitcode, float(btime),
+        etime / 1000000.0, utime / 1000000.0, stime / 1000000.0, minflt,
+        majflt, hiwater_rss * 1024, rchar, wchar, read_bytes, write_bytes,
+        nvcsw, nivcsw, cpu_delay / 1e9, blkio_delay / 1e9,
+        swapin_delay / 1e9)
+
+
+class ExitAccountant(object):
+    """Collect the resource usage of every task (process or thread)
+    exiting on the system, including the ones which live too little
+    to be seen by polling, via TASKSTATS netlink exit notifications.
+
+    Notifications are read by a daemon thread and aggregated by
+    process name. *cpus* is the list of CPUs to listen on (default
+    all), *max_tasks* the number of most recently exited tasks kept
+    by tasks(). Requires CAP_NET_ADMIN (root) and a kernel compiled
+    with CONFIG_TASKSTATS.
+    """
+
+    def __init__(self, cpus=None, max_tasks=1000):
+        if cpus is None:
+            self._cpumask = cat("/sys/devices/system/cpu/possible").strip()
+        else:
+            cpus = list(cpus)
+            if not cpus:
+                raise ValueError("cpus must not be empty")
+            self._cpumask = _format_cpu_list(int(x) for x in cpus)
+        self._tasks = collections.deque(maxlen=max_tasks)
+        self._summary = {}
+        self._overruns = 0
+        self._error = None
+        self._lock = threading.Lock()
+        self._stopping = threading.Event()
+        self._thread = None
+        self._fd = None
+        self._family = None
+
+    def __enter__(self):
+        self.start()
+        return self
+
+    def __exit__(self, *args):
+        self.stop()
+
+    @property
+    def overruns(self):
+        """Number of times notifications were lost because they
+        were not read fast enough.
+        """
+        return self._overruns
+
+    def start(self):
+        """Register for exit notifications and start collecting."""
+        if self._thread is not None:
+            raise RuntimeError("already started")
+        try:
+            self._fd, self._family = cext.linux_taskstats_open(
+                self._cpumask)
+        except OSError as err:
+            if err.errno == errno.ENOENT:
+                raise NotImplementedError(
+                    "TASKSTATS is not available (requires a kernel "
+                    "compiled with CONFIG_TASKSTATS)")
+            raise
+        self._stopping.clear()
+        self._thread = threading.Thread(target=self._run,
+                                        name="psutil-exit-accountant")
+        self._thread.daemon = True
+        self._thread.start()
+
+    def stop(self):
+        """Stop collecting. Data collected so far is kept."""
+        if self._thread is None:
+            return
+        self._stopping.set()
+        self._thread.join()
+        self._thread = None
+        try:
+            cext.linux_taskstats_close(self._fd, self._family, self._cpumask)
+        finally:
+            self._fd = self._family = None
+
+    def _run(self):
+        while not self._stopping.is_set():
+            try:
+                tasks, overruns = cext.linux_taskstats_read(
+                    self._fd, self._family, 0.2)
+            except Exception as err:
+                self._error = err
+                return
+            self._add(tasks, overruns)
+
+    def _add(self, tasks, overruns):
+        with self._lock:
+            self._overruns += overruns
+            for tup in tasks:
+                task = _exited_task(tup)
+                self._tasks.append(task)
+                try:
+                    acc = self._summary[task.name]
+                except KeyError:
+                    acc = self._summary[task.name] = [0] * 10
+                acc[0] += task.pid == task.tgid
+                acc[1] += 1
+                acc[2] += task.user
+                acc[3] += task.system
+                # the RSS high-water mark is shared by all threads
+                acc[4] = max(acc[4], task.peak_rss)
+                acc[5] += task.read_bytes
+                acc[6] += task.write_bytes
+                acc[7] += task.cpu_delay
+                acc[8] += task.blkio_delay
+                acc[9] += task.swapin_delay
+
+    def _check_error(self):
+        if self._error is not None:
+            err, self._error = self._error, None
+            raise err
+
+    def summary(self, reset=False):
+        """Return a {name: sexitsummary, ...} dict aggregating the
+        tasks exited so far by process name. With *reset* start over
+        afterwards.
+        """
+        self._check_error()
+        with self._lock:
+            ret = dict((name, sexitsummary(*acc))
+                       for name, acc in self._summary.items())
+            if reset:
+                self._summary.clear()
+        return ret
+
+    def tasks(self, reset=False):
+        """Return the most recently exited tasks as a list of
+        sexitedtask, oldest first. With *reset* start over
+        afterwards.
+        """
+        self._check_error()
+        with self._lock:
+            ret = list(self._tasks)
+            if reset:
+                self._tasks.clear()
+        return ret
+
+
+def file_users(path):
+    """Return the processes using *path*, either as an open fd, a
+    memory mapping, or their cwd / root directory / executable.
+    If *path* is a mount point every file living on that filesystem
+    is matched (including deleted ones still held open).
+    """
+    st = os.stat(path)
+    dev_only = os.path.ismount(path)
+    ret = cext.linux_file_users(get_procfs_path(), st.st_dev, st.st_ino,
+                                dev_only)
+    return [sfileuser(*x) for x in ret]
+
+
+def oneshot_prefetch(procs):
+    """Read stat, status and statm files of many processes in one go
+    and store them in their oneshot() cache. Used by
+    psutil.oneshot_many().
+    """
+    paths = []
+    for proc in procs:
+        for name in ("stat", "status", "statm"):
+            paths.append(b("%s/%s/%s" % (proc._procfs_path, proc.pid, name)))
+    results = cext.linux_read_files(paths)
+    for i, proc in enumerate(procs):
+        proc._oneshot_prefetch(*results[i * 3:i * 3 + 3])
+
+
+def _pagemap_pfns(procfs_path, pid):
+    return cext.linux_pagemap_pfns("%s/%s/maps" % (procfs_path, pid),
+                                   "%s/%s/pagemap" % (procfs_path, pid))
+
+
+def _clear_refs(procfs_path, pid):
+    # Clear the "referenced" and "accessed" bits of all the process
+    # pages, see "Referenced:" in "man proc".
+    with open("%s/%s/clear_refs" % (procfs_path, pid), "wb") as f:
+        f.write(b"1")
+
+
+def _referenced_bytes(procfs_path, pid,
+                      _re=re.compile(br"\nReferenced:\s+(\d+)")):
+    if _has_proc_smaps_rollup():
+        data = bcat("%s/%s/smaps_rollup" % (procfs_path, pid))
+    else:
+        data = bcat("%s/%s/smaps" % (procfs_path, pid))
+    return sum(map(int, _re.findall(data))) * 1024
+
+
+def working_set(pids, interval, method=None, ignore_errors=True):
+    """Estimate the working set size of a group of processes, that is
+    how much of their memory is accessed in *interval* seconds, and
+    return a {pid: bytes} dict. *method* can be:
+
+    - "page_idle": mark the pages of the processes as idle in the
+      page_idle bitmap, wait, and count the pages which are no longer
+      idle. Requires CONFIG_IDLE_PAGE_TRACKING and root. Pages shared
+      between processes are counted for all of them.
+    - "clear_refs": clear the referenced bit of all the pages of the
+      processes via /proc/{pid}/clear_refs, wait, and sum "Referenced:"
+      fields of /proc/{pid}/smaps. Requires permission to write
+      clear_refs (same user or root).
+    - None: use "page_idle" if available, else "clear_refs".
+
+    With *ignore_errors* processes which disappear or can't be
+    accessed are left out, else the exception is propagated.
+    """
+    auto = method is None
+    if auto:
+        method = "page_idle" if os.access(
+            PAGE_IDLE_BITMAP, os.R_OK | os.W_OK) else "clear_refs"
+    elif method not in ("page_idle", "clear_refs"):
+        raise ValueError("invalid method %r" % method)
+    procfs_path = get_procfs_path()
+
+    def call(fun, pids):
+        ret = {}
+        for pid in pids:
+            try:
+                ret[pid] = fun(procfs_path, pid)
+            except EnvironmentError:
+                if not ignore_errors:
+                    raise
+        return ret
+
+    if method == "page_idle":
+        if not os.access(PAGE_IDLE_BITMAP, os.R_OK | os.W_OK):
+            raise NotImplementedError(
+                "%s is not available (requires root and a kernel "
+                "compiled with CONFIG_IDLE_PAGE_TRACKING)" %
+                PAGE_IDLE_BITMAP)
+        pfns = call(_pagemap_pfns, pids)
+        if any(present and not data for data, present in pfns.values()):
+            # no CAP_SYS_ADMIN: the kernel reports PFNs as 0
+            if not auto:
+                raise PermissionError(
+                    errno.EPERM, "pagemap PFNs are not available")
+            method = "clear_refs"
+        else:
+            cext.linux_page_idle_mark(
+                PAGE_IDLE_BITMAP, b"".join(x[0] for x in pfns.values()))
+            time.sleep(interval)
+            # Re-read the PFNs, so that pages faulted in the meantime
+            # (which are not idle) are counted as well.
+            ret = {}
+            for pid, (data, _) in call(_pagemap_pfns, pfns).items():
+                accessed = cext.linux_page_idle_count(PAGE_IDLE_BITMAP, data)
+                ret[pid] = accessed * PAGESIZE
+            return ret
+
+    pids = list(call(_clear_refs, pids))
+    time.sleep(interval)
+    return call(_referenced_bytes, pids)
+
+
 def wrap_exceptions(fun):
     """Decorator which translates bare OSError and IOError exceptions
     into NoSuchProcess and AccessDenied.
@@ -1693,6 +3012,10 @@ class Process(object):
         in use.
         """
         data = bcat("%s/%s/stat" % (self._procfs_path, self.pid))
+        return self._parse_stat_data(data)
+
+    @staticmethod
+    def _parse_stat_data(data):
         # Process name is between parentheses. It can contain spaces and
         # other parentheses. This is taken into account by looking for
         # the first occurrence of "(" and the last occurrence of ")".
@@ -1725,6 +3048,15 @@ class Process(object):
         with open_binary("%s/%s/status" % (self._procfs_path, self.pid)) as f:
             return f.read()
 
+    @wrap_exceptions
+    @memoize_when_activated
+    def _read_statm_file(self):
+        """Read /proc/{pid}/statm file and return its content.
+        The return value is cached in case oneshot() ctx manager is
+        in use.
+        """
+        return bcat("%s/%s/statm" % (self._procfs_path, self.pid))
+
     @wrap_exceptions
     @memoize_when_activated
     def _read_smaps_file(self):
@@ -1734,13 +3066,28 @@ class Process(object):
     def oneshot_enter(self):
         self._parse_stat_file.cache_activate(self)
         self._read_status_file.cache_activate(self)
+        self._read_statm_file.cache_activate(self)
         self._read_smaps_file.cache_activate(self)
 
     def oneshot_exit(self):
         self._parse_stat_file.cache_deactivate(self)
         self._read_status_file.cache_deactivate(self)
+        self._read_statm_file.cache_deactivate(self)
         self._read_smaps_file.cache_deactivate(self)
 
+    def _oneshot_prefetch(self, stat, status, statm):
+        # Populate oneshot() cache with the content of the files read
+        # by oneshot_prefetch(). A file which could not be read (int
+        # errno) is skipped: it will be read again later and the
+        # proper exception will be raised then.
+        if isinstance(stat, bytes):
+            self._parse_stat_file.cache_set(
+                self, self._parse_stat_data(stat))
+        if isinstance(status, bytes):
+            self._read_status_file.cache_set(self, status)
+        if isinstance(statm, bytes):
+            self._read_statm_file.cache_set(self, statm)
+
     @wrap_exceptions
     def name(self):
         name = self._parse_stat_file()['name']
@@ -1855,8 +3202,8 @@ class Process(object):
         return int(self._parse_stat_file()['cpu_num'])
 
     @wrap_exceptions
-    def wait(self, timeout=None):
-        return _psposix.wait_pid(self.pid, timeout, self._name)
+    def wait(self, timeout=None, rusage=False):
+        return _psposix.wait_pid(self.pid, timeout, self._name, rusage)
 
     @wrap_exceptions
     def create_time(self):
@@ -1882,12 +3229,23 @@ class Process(object):
         # | data   | data + stack                        | drs  | DATA |
         # | dirty  | dirty pages (unused in Linux 2.6)   | dt   |      |
         #  ============================================================
-        with open_binary("%s/%s/statm" % (self._procfs_path, self.pid)) as f:
-            vms, rss, shared, text, lib, data, dirty = \
-                [int(x) * PAGESIZE for x in f.readline().split()[:7]]
+        vms, rss, shared, text, lib, data, dirty = \
+            [int(x) * PAGESIZE for x in self._read_statm_file().split()[:7]]
         return pmem(rss, vms, shared, text, lib, data, dirty)
 
-    if HAS_PROC_SMAPS_ROLLUP or HAS_PROC_SMAPS:
+    @wrap_exceptions
+    def memory_info_status(
+            self,
+            _re=re.compile(
+                br'\n(RssAnon|RssFile|RssShmem|VmSwap|VmHWM):\s+(\d+)')):
+        # Kernel threads have no Vm* / Rss* lines; RssAnon, RssFile and
+        # RssShmem were added in Linux 4.5. Missing fields are 0.
+        fields = dict(_re.findall(self._read_status_file()))
+        return pmemstatus(*[
+            int(fields.get(name, 0)) * 1024 for name in
+            (b'RssAnon', b'RssFile', b'RssShmem', b'VmSwap', b'VmHWM')])
+
+    if HAS_PROC_SMAPS:
 
         @wrap_exceptions
         def _parse_smaps_rollup(self):
@@ -1944,7 +3302,7 @@ class Process(object):
             return (uss, pss, swap)
 
         def memory_full_info(self):
-            if HAS_PROC_SMAPS_ROLLUP:  # faster
+            if _has_proc_smaps_rollup():  # faster
                 uss, pss, swap = self._parse_smaps_rollup()
             else:
                 uss, pss, swap = self._parse_smaps()
@@ -2024,6 +3382,11 @@ class Process(object):
                 ))
             return ls
 
+        @wrap_exceptions
+        def working_set(self, interval, method=None):
+            return working_set([self.pid], interval, method=method,
+                               ignore_errors=False)[self.pid]
+
     @wrap_exceptions
     def cwd(self):
         try:
@@ -2063,17 +3426,19 @@ class Process(object):
         thread_ids.sort()
         retlist = []
         hit_enoent = False
-        for thread_id in thread_ids:
-            fname = "%s/%s/task/%s/stat" % (
-                self._procfs_path, self.pid, thread_id)
-            try:
-                with open_binary(fname) as f:
-                    st = f.read().strip()
-            except (FileNotFoundError, ProcessLookupError):
-                # no such file or directory or no such process;
-                # it means thread disappeared on us
-                hit_enoent = True
-                continue
+        paths = [b("%s/%s/task/%s/stat" % (
+            self._procfs_path, self.pid, thread_id))
+            for thread_id in thread_ids]
+        results = cext.linux_read_files(paths)
+        for thread_id, fname, st in zip(thread_ids, paths, results):
+            if isinstance(st, int):
+                if st in (errno.ENOENT, errno.ESRCH):
+                    # no such file or directory or no such process;
+                    # it means thread disappeared on us
+                    hit_enoent = True
+                    continue
+                raise OSError(st, os.strerror(st), fname)
+            st = st.strip()
             # ignore the first two values ("pid (exe)")
             st = st[st.find(b')') + 2:]
             values = st.split(b' ')
@@ -2085,6 +3450,29 @@ class Process(object):
             self._assert_alive()
         return retlist
 
+    @wrap_exceptions
+    def ns_pids(self):
+        return _parse_nspid(self._read_status_file())
+
+    @wrap_exceptions
+    def sample_thread_states(self, hz, duration):
+        nsamples = max(1, int(round(hz * duration)))
+        taken, hist = cext.linux_sample_thread_states(
+            "%s/%s/task" % (self._procfs_path, self.pid), nsamples, 1.0 / hz)
+        if not taken:
+            self._assert_alive()
+        total = sum(x[3] for x in hist)
+        retlist = []
+        for state, wchan, syscall, count in hist:
+            # syscall is -1 if the thread is blocked but not in a
+            # syscall (e.g. page fault), < -1 if it's running or unknown
+            retlist.append(pthreadstate(
+                PROC_STATUSES.get(chr(state), '?'), wchan or None,
+                syscall if syscall >= -1 else None, count,
+                round(count * 100.0 / total, 1)))
+        retlist.sort(key=lambda x: x.samples, reverse=True)
+        return retlist
+
     @wrap_exceptions
     def nice_get(self):
         # with open_text('%s/%s/stat' % (self._procfs_path, self.pid)) as f:
@@ -2105,6 +3493,13 @@ class Process(object):
         def cpu_affinity_get(self):
             return cext.proc_cpu_affinity_get(self.pid)
 
+        @wrap_exceptions
+        def cpu_affinity_mask(self):
+            # little endian bitset: bit N is set if the process can
+            # run on CPU N
+            data = cext.proc_cpu_affinity_get_mask(self.pid)
+            return int(binascii.hexlify(data[::-1]) or b'0', 16)
+
         def _get_eligible_cpus(
                 self, _re=re.compile(br"Cpus_allowed_list:\t(\d+)-(\d+)")):
             # See: https://github.com/giampaolo/psutil/issues/956
@@ -13,6 +13,7 @@ import time
 from ._common import MACOS
 from ._common import TimeoutExpired
 from ._common import memoize
+from ._common import prusage
 from ._common import sdiskusage
 from ._common import usage_percent
 from ._compat import PY3
@@ -76,7 +77,14 @@ else:  # pragma: no cover
         return num
 
 
-def wait_pid(pid, timeout=None, proc_name=None,
+def _rusage_to_ntuple(ru):
+    # ru_maxrss is in kilobytes, except on macOS where it's in bytes.
+    maxrss = ru.ru_maxrss if MACOS else ru.ru_maxrss * 1024
+    return prusage(ru.ru_utime, ru.ru_stime, maxrss, ru.ru_minflt,
+                   ru.ru_majflt, ru.ru_nvcsw, ru.ru_nivcsw)
+
+
+def wait_pid(pid, timeout=None, proc_name=None, rusage=False,
              _waitpid=os.waitpid,
              _timer=getattr(time, 'monotonic', time.time),
              _min=min,
@@ -98,6 +106,10 @@ def wait_pid(pid, timeout=None, proc_name=None,
 
     If *timeout* != None and process is still alive raise TimeoutExpired.
     timeout=0 is also possible (either return immediately or raise).
+
+    If *rusage* is True wait4() is used instead of waitpid() and a
+    (exit_code, rusage) tuple is returned, where rusage is the resource
+    usage of the terminated process (None if PID is not a children).
     """
     if pid <= 0:
         raise ValueError("can't wait for PID 0")  # see "man waitpid"
@@ -115,10 +127,19 @@ def wait_pid(pid, timeout=None, proc_name=None,
         _sleep(interval)
         return _min(interval * 2, 0.04)
 
+    def result(exit_code, ru=None):
+        if not rusage:
+            return exit_code
+        return (exit_code, _rusage_to_ntuple(ru) if ru is not None else None)
+
     # See: https://linux.die.net/man/2/waitpid
     while True:
         try:
-            retpid, status = os.waitpid(pid, flags)
+            if rusage:
+                retpid, status, ru = os.wait4(pid, flags)
+            else:
+                retpid, status = os.waitpid(pid, flags)
+                ru = None
         except InterruptedError:
             interval = sleep(interval)
         except ChildProcessError:
@@ -130,7 +151,7 @@ def wait_pid(pid, timeout=None, proc_name=None,
             # can't determine its exit status code.
             while _pid_exists(pid):
                 interval = sleep(interval)
-            return
+            return result(None)
         else:
             if retpid == 0:
                 # WNOHANG flag was used and PID is still running.
@@ -140,11 +161,11 @@ def wait_pid(pid, timeout=None, proc_name=None,
                 # Process terminated normally by calling exit(3) or _exit(2),
                 # or by returning from main(). The return value is the
                 # positive integer passed to *exit().
-                return os.WEXITSTATUS(status)
+                return result(os.WEXITSTATUS(status), ru)
             elif os.WIFSIGNALED(status):
                 # Process exited due to a signal. Return the negative value
                 # of that signal.
-                return negsig_to_enum(-os.WTERMSIG(status))
+                return result(negsig_to_enum(-os.WTERMSIG(status)), ru)
             # elif os.WIFSTOPPED(status):
             #     # Process was stopped via SIGSTOP or is being traced, and
             #     # waitpid() was called with WUNTRACED flag. PID is still
@@ -723,5 +723,5 @@ class Process(object):
             *cext.proc_num_ctx_switches(self.pid, self._procfs_path))
 
     @wrap_exceptions
-    def wait(self, timeout=None):
-        return _psposix.wait_pid(self.pid, timeout, self._name)
+    def wait(self, timeout=None, rusage=False):
+        return _psposix.wait_pid(self.pid, timeout, self._name, rusage)
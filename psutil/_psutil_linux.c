@@ -50,6 +50,15 @@ static const int NCPUS_START = sizeof(unsigned long) * CHAR_BIT;
 
 #include "_psutil_common.h"
 #include "_psutil_posix.h"
+#include "arch/linux/fdscan.h"
+#include "arch/linux/kmem.h"
+#include "arch/linux/pageidle.h"
+#include "arch/linux/pids.h"
+#include "arch/linux/readfiles.h"
+#include "arch/linux/schedstat.h"
+#include "arch/linux/taskstats.h"
+#include "arch/linux/tstates.h"
+#include "arch/linux/vmstat.h"
 
 // May happen on old RedHat versions, see:
 // https://github.com/giampaolo/psutil/issues/607
@@ -230,41 +239,81 @@ psutil_linux_sysinfo(PyObject *self, PyObject *args) {
 }
 
 
-/*
- * Return process CPU affinity as a Python list
- */
 #ifdef PSUTIL_HAVE_CPU_AFFINITY
 
-static PyObject *
-psutil_proc_cpu_affinity_get(PyObject *self, PyObject *args) {
-    int cpu, ncpus, count, cpucount_s;
-    pid_t pid;
-    size_t setsize;
-    cpu_set_t *mask = NULL;
-    PyObject *py_list = NULL;
+// The size (in CPUs) of the kernel cpumask, as discovered by the first
+// successful sched_getaffinity() call. Caching it avoids re-doing the
+// EINVAL / CPU_ALLOC() dance on every call, which is costly when
+// querying thousands of threads. Only accessed while holding the GIL
+// or before releasing it.
+static int psutil_ncpus_cached = 0;
 
-    if (!PyArg_ParseTuple(args, _Py_PARSE_PID, &pid))
-        return NULL;
-    ncpus = NCPUS_START;
+
+/*
+ * Allocate a cpu_set_t large enough to hold the kernel cpumask and
+ * fill it with the affinity of the given PID / TID. Return NULL with
+ * errno set on failure (ENOMEM if the set can't be allocated).
+ */
+static cpu_set_t *
+psutil_get_affinity_mask(pid_t pid, size_t *setsize) {
+    int ncpus;
+    cpu_set_t *mask;
+
+    ncpus = psutil_ncpus_cached ? psutil_ncpus_cached : NCPUS_START;
     while (1) {
-        setsize = CPU_ALLOC_SIZE(ncpus);
+        *setsize = CPU_ALLOC_SIZE(ncpus);
         mask = CPU_ALLOC(ncpus);
         if (mask == NULL) {
-            psutil_debug("CPU_ALLOC() failed");
-            return PyErr_NoMemory();
+            errno = ENOMEM;
+            return NULL;
+        }
+        if (sched_getaffinity(pid, *setsize, mask) == 0) {
+            psutil_ncpus_cached = ncpus;
+            return mask;
         }
-        if (sched_getaffinity(pid, setsize, mask) == 0)
-            break;
         CPU_FREE(mask);
         if (errno != EINVAL)
-            return PyErr_SetFromErrno(PyExc_OSError);
+            return NULL;
         if (ncpus > INT_MAX / 2) {
-            PyErr_SetString(PyExc_OverflowError, "could not allocate "
-                            "a large enough CPU set");
+            errno = EOVERFLOW;
             return NULL;
         }
         ncpus = ncpus * 2;
     }
+}
+
+
+static PyObject *
+psutil_set_affinity_err(void) {
+    if (errno == ENOMEM) {
+        psutil_debug("CPU_ALLOC() failed");
+        return PyErr_NoMemory();
+    }
+    if (errno == EOVERFLOW) {
+        PyErr_SetString(PyExc_OverflowError, "could not allocate "
+                        "a large enough CPU set");
+        return NULL;
+    }
+    return PyErr_SetFromErrno(PyExc_OSError);
+}
+
+
+/*
+ * Return process CPU affinity as a Python list
+ */
+static PyObject *
+psutil_proc_cpu_affinity_get(PyObject *self, PyObject *args) {
+    int cpu, count, cpucount_s;
+    pid_t pid;
+    size_t setsize;
+    cpu_set_t *mask = NULL;
+    PyObject *py_list = NULL;
+
+    if (!PyArg_ParseTuple(args, _Py_PARSE_PID, &pid))
+        return NULL;
+    mask = psutil_get_affinity_mask(pid, &setsize);
+    if (mask == NULL)
+        return psutil_set_affinity_err();
 
     py_list = PyList_New(0);
     if (py_list == NULL)
@@ -299,6 +348,159 @@ error:
 }
 
 
+/*
+ * Return process CPU affinity as a compact bitset (bytes), where bit N
+ * (little endian, byte N / 8) is set if the process can run on CPU N.
+ */
+static PyObject *
+psutil_proc_cpu_affinity_get_mask(PyObject *self, PyObject *args) {
+    int cpu, ncpus;
+    pid_t pid;
+    size_t setsize;
+    cpu_set_t *mask = NULL;
+    unsigned char *buf;
+    PyObject *py_bytes = NULL;
+
+    if (!PyArg_ParseTuple(args, _Py_PARSE_PID, &pid))
+        return NULL;
+    mask = psutil_get_affinity_mask(pid, &setsize);
+    if (mask == NULL)
+        return psutil_set_affinity_err();
+
+    ncpus = (int)setsize * CHAR_BIT;
+    py_bytes = PyBytes_FromStringAndSize(NULL, setsize);
+    if (py_bytes == NULL) {
+        CPU_FREE(mask);
+        return NULL;
+    }
+    // Don't copy the raw cpu_set_t: it's an array of longs, so its byte
+    // order would depend on the endianness of the platform.
+    buf = (unsigned char *)PyBytes_AS_STRING(py_bytes);
+    memset(buf, 0, setsize);
+    for (cpu = 0; cpu < ncpus; cpu++) {
+        if (CPU_ISSET_S(cpu, setsize, mask))
+            buf[cpu / CHAR_BIT] |= (unsigned char)(1 << (cpu % CHAR_BIT));
+    }
+    CPU_FREE(mask);
+    return py_bytes;
+}
+
+
+/*
+ * Given a sequence of PIDs / TIDs return a list where element N is the
+ * number of tasks which are allowed to run on CPU N. If pinned_only is
+ * true tasks allowed to run on all online CPUs are not counted.
+ * Also return the number of tasks which were actually inspected (the
+ * ones which disappeared in the meantime are skipped).
+ */
+static PyObject *
+psutil_cpu_affinity_histogram(PyObject *self, PyObject *args) {
+    int pinned_only;
+    int cpu, ncpus, maxcpu, nonline, weight, err = 0;
+    long value;
+    long *counts = NULL;
+    pid_t *tids = NULL;
+    Py_ssize_t i, ntids, nscanned = 0;
+    size_t setsize;
+    cpu_set_t *mask = NULL;
+    PyObject *py_seq = NULL;
+    PyObject *py_tids;
+    PyObject *py_counts = NULL;
+    PyObject *py_count;
+
+    if (!PyArg_ParseTuple(args, "Oi", &py_tids, &pinned_only))
+        return NULL;
+    py_seq = PySequence_Fast(py_tids, "sequence argument expected");
+    if (py_seq == NULL)
+        return NULL;
+    ntids = PySequence_Fast_GET_SIZE(py_seq);
+    tids = malloc((ntids ? ntids : 1) * sizeof(pid_t));
+    if (tids == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    for (i = 0; i < ntids; i++) {
+#if PY_MAJOR_VERSION >= 3
+        value = PyLong_AsLong(PySequence_Fast_GET_ITEM(py_seq, i));
+#else
+        value = PyInt_AsLong(PySequence_Fast_GET_ITEM(py_seq, i));
+#endif
+        if (value == -1 && PyErr_Occurred())
+            goto error;
+        tids[i] = (pid_t)value;
+    }
+    Py_CLEAR(py_seq);
+
+    // Discover (and cache) the kernel cpumask size before starting.
+    mask = psutil_get_affinity_mask(0, &setsize);
+    if (mask == NULL) {
+        psutil_set_affinity_err();
+        goto error;
+    }
+    ncpus = (int)setsize * CHAR_BIT;
+    counts = calloc(ncpus, sizeof(long));
+    if (counts == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    nonline = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    maxcpu = nonline > 0 ? nonline : 0;
+
+    Py_BEGIN_ALLOW_THREADS
+    for (i = 0; i < ntids; i++) {
+        if (sched_getaffinity(tids[i], setsize, mask) != 0) {
+            // ESRCH == task is gone in the meantime.
+            if (errno == ESRCH)
+                continue;
+            err = errno;
+            break;
+        }
+        nscanned++;
+        weight = CPU_COUNT_S(setsize, mask);
+        if (pinned_only && weight >= nonline)
+            continue;
+        for (cpu = 0; weight; cpu++) {
+            if (CPU_ISSET_S(cpu, setsize, mask)) {
+                counts[cpu]++;
+                if (cpu >= maxcpu)
+                    maxcpu = cpu + 1;
+                --weight;
+            }
+        }
+    }
+    Py_END_ALLOW_THREADS
+    if (err != 0) {
+        errno = err;
+        PyErr_SetFromErrno(PyExc_OSError);
+        goto error;
+    }
+
+    py_counts = PyList_New(maxcpu);
+    if (py_counts == NULL)
+        goto error;
+    for (cpu = 0; cpu < maxcpu; cpu++) {
+        py_count = PyLong_FromLong(counts[cpu]);
+        if (py_count == NULL)
+            goto error;
+        PyList_SET_ITEM(py_counts, cpu, py_count);
+    }
+
+    CPU_FREE(mask);
+    free(counts);
+    free(tids);
+    return Py_BuildValue("(Nn)", py_counts, nscanned);
+
+error:
+    if (mask)
+        CPU_FREE(mask);
+    free(counts);
+    free(tids);
+    Py_XDECREF(py_seq);
+    Py_XDECREF(py_counts);
+    return NULL;
+}
+
+
 /*
  * Set process CPU affinity; expects a bitmask
  */
@@ -509,6 +711,8 @@ static PyMethodDef mod_methods[] = {
 #ifdef PSUTIL_HAVE_CPU_AFFINITY
     {"proc_cpu_affinity_get", psutil_proc_cpu_affinity_get, METH_VARARGS},
     {"proc_cpu_affinity_set", psutil_proc_cpu_affinity_set, METH_VARARGS},
+    {"proc_cpu_affinity_get_mask", psutil_proc_cpu_affinity_get_mask,
+     METH_VARARGS},
 #endif
     // --- system related functions
     {"disk_partitions", psutil_disk_partitions, METH_VARARGS},
@@ -517,6 +721,27 @@ static PyMethodDef mod_methods[] = {
 
     // --- linux specific
     {"linux_sysinfo", psutil_linux_sysinfo, METH_VARARGS},
+    {"linux_read_files", psutil_linux_read_files, METH_VARARGS},
+    {"linux_pids", psutil_linux_pids, METH_VARARGS},
+    {"linux_pids_diff", psutil_linux_pids_diff, METH_VARARGS},
+    {"linux_pagemap_pfns", psutil_linux_pagemap_pfns, METH_VARARGS},
+    {"linux_page_idle_mark", psutil_linux_page_idle_mark, METH_VARARGS},
+    {"linux_page_idle_count", psutil_linux_page_idle_count, METH_VARARGS},
+    {"linux_slabinfo", psutil_linux_slabinfo, METH_VARARGS},
+    {"linux_vmallocinfo", psutil_linux_vmallocinfo, METH_VARARGS},
+    {"linux_schedstat", psutil_linux_schedstat, METH_VARARGS},
+    {"linux_vmstat", psutil_linux_vmstat, METH_VARARGS},
+    {"linux_vmstat_slots", psutil_linux_vmstat_slots, METH_VARARGS},
+    {"linux_sample_thread_states", psutil_linux_sample_thread_states,
+     METH_VARARGS},
+    {"linux_taskstats_open", psutil_linux_taskstats_open, METH_VARARGS},
+    {"linux_taskstats_read", psutil_linux_taskstats_read, METH_VARARGS},
+    {"linux_taskstats_close", psutil_linux_taskstats_close, METH_VARARGS},
+    {"linux_socket_owners", psutil_linux_socket_owners, METH_VARARGS},
+    {"linux_file_users", psutil_linux_file_users, METH_VARARGS},
+#ifdef PSUTIL_HAVE_CPU_AFFINITY
+    {"cpu_affinity_histogram", psutil_cpu_affinity_histogram, METH_VARARGS},
+#endif
     // --- others
     {"set_debug", psutil_set_debug, METH_VARARGS},
 
@@ -0,0 +1,489 @@
+/*
+ * Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+Reverse lookups of the files and sockets processes hold open. Rather
+than listing /proc/{pid}/fd of every process from Python (a string per
+fd, plus a readlink() or stat() call going through the interpreter),
+the fd directories are scanned in C with readlinkat(2) / fstatat(2),
+without holding the GIL:
+
+- sockets: "socket:[12345]" links are looked up in a sorted array of
+  inodes, and the scan stops as soon as every inode was found (after
+  finishing the current process, which may hold more than one fd
+  referencing it).
+- files: every fd, memory mapping (/proc/{pid}/map_files), cwd, root
+  and exe is stat()ed and matched by (st_dev, st_ino), or by st_dev
+  only to find everything open on a filesystem.
+*/
+
+#include <Python.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "../../_psutil_common.h"
+#include "fdscan.h"
+
+
+// Called for every PID; return 0 to go on, 1 to stop or -1 on error.
+typedef int (*psutil_fs_pid_cb)(void *ctx, const char *procfs_path,
+                                long pid);
+
+typedef struct {
+    unsigned long inode;
+    long pid;
+    int fd;
+} psutil_fs_match;
+
+typedef struct {
+    unsigned long *inodes;
+    char *found;
+    size_t ninodes;
+    size_t remaining;
+    psutil_fs_match *matches;
+    size_t nmatches;
+    size_t matches_size;
+} psutil_fs_sockets;
+
+typedef struct {
+    long pid;
+    int fd;  // -1 if not a fd
+    const char *kind;
+    char *path;
+    dev_t dev;
+    ino_t ino;
+} psutil_fs_user;
+
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    int dev_only;
+    psutil_fs_user *users;
+    size_t nusers;
+    size_t users_size;
+    size_t pid_start;  // index of the first user of the current PID
+} psutil_fs_files;
+
+
+static int
+psutil_ulong_cmp(const void *a, const void *b) {
+    unsigned long x = *(const unsigned long *)a;
+    unsigned long y = *(const unsigned long *)b;
+    return (x > y) - (x < y);
+}
+
+
+/*
+ * Call cb for every PID listed in procfs_path, until it returns
+ * non-zero. Return -1 on error.
+ */
+static int
+psutil_fs_foreach_pid(const char *procfs_path, psutil_fs_pid_cb cb,
+                      void *ctx) {
+    DIR *proc;
+    struct dirent *entry;
+    long pid;
+    char *end;
+    int ret = 0;
+
+    proc = opendir(procfs_path);
+    if (proc == NULL)
+        return -1;
+    errno = 0;
+    while ((entry = readdir(proc)) != NULL) {
+        pid = strtol(entry->d_name, &end, 10);
+        if (*end != '\0' || pid <= 0)
+            continue;
+        ret = cb(ctx, procfs_path, pid);
+        if (ret != 0)
+            break;
+        errno = 0;
+    }
+    if (ret == 0 && errno != 0)
+        ret = -1;
+    closedir(proc);
+    return ret == -1 ? -1 : 0;
+}
+
+
+// --- sockets
+
+
+static int
+psutil_fs_add_socket(psutil_fs_sockets *s, unsigned long inode, long pid,
+                     int fd) {
+    psutil_fs_match *newmatches;
+
+    if (s->nmatches == s->matches_size) {
+        newmatches = realloc(
+            s->matches,
+            (s->matches_size * 2 + 16) * sizeof(psutil_fs_match));
+        if (newmatches == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        s->matches = newmatches;
+        s->matches_size = s->matches_size * 2 + 16;
+    }
+    s->matches[s->nmatches].inode = inode;
+    s->matches[s->nmatches].pid = pid;
+    s->matches[s->nmatches].fd = fd;
+    s->nmatches++;
+    return 0;
+}
+
+
+/*
+ * Look up the socket fds of a single process. Processes which are
+ * gone or can't be inspected (EACCES) are skipped.
+ */
+static int
+psutil_fs_sockets_pid(void *ctx, const char *procfs_path, long pid) {
+    psutil_fs_sockets *s = ctx;
+    char path[PATH_MAX];
+    char link[64];
+    DIR *dir;
+    struct dirent *entry;
+    unsigned long inode;
+    unsigned long *p;
+    ssize_t len;
+    long fd;
+    char *end;
+    size_t idx;
+
+    snprintf(path, sizeof(path), "%s/%ld/fd", procfs_path, pid);
+    dir = opendir(path);
+    if (dir == NULL)
+        return 0;
+    while ((entry = readdir(dir)) != NULL) {
+        fd = strtol(entry->d_name, &end, 10);
+        if (*end != '\0' || fd < 0)
+            continue;
+        len = readlinkat(dirfd(dir), entry->d_name, link, sizeof(link) - 1);
+        if (len <= 8)
+            continue;  // fd closed in the meantime, or not a socket
+        link[len] = '\0';
+        if (strncmp(link, "socket:[", 8) != 0)
+            continue;
+        inode = strtoul(link + 8, NULL, 10);
+        p = bsearch(&inode, s->inodes, s->ninodes, sizeof(unsigned long),
+                    psutil_ulong_cmp);
+        if (p == NULL)
+            continue;
+        idx = (size_t)(p - s->inodes);
+        if (! s->found[idx]) {
+            s->found[idx] = 1;
+            s->remaining--;
+        }
+        if (psutil_fs_add_socket(s, inode, pid, (int)fd) != 0) {
+            closedir(dir);
+            return -1;
+        }
+    }
+    closedir(dir);
+    return s->remaining == 0 ? 1 : 0;
+}
+
+
+/*
+ * Given a procfs path and a sequence of socket inodes, return a list
+ * of (inode, pid, fd) tuples telling which processes hold them open.
+ * Inodes which are not found (e.g. owned by processes we're not
+ * allowed to inspect) are not listed.
+ */
+PyObject *
+psutil_linux_socket_owners(PyObject *self, PyObject *args) {
+    char *procfs_path;
+    PyObject *py_inodes;
+    PyObject *py_seq = NULL;
+    PyObject *py_tuple = NULL;
+    PyObject *py_retlist = NULL;
+    psutil_fs_sockets s;
+    size_t i;
+    size_t j;
+    int ret;
+
+    if (!PyArg_ParseTuple(args, "sO", &procfs_path, &py_inodes))
+        return NULL;
+
+    memset(&s, 0, sizeof(s));
+    py_seq = PySequence_Fast(py_inodes, "inodes must be a sequence");
+    if (py_seq == NULL)
+        return NULL;
+    s.ninodes = (size_t)PySequence_Fast_GET_SIZE(py_seq);
+    py_retlist = PyList_New(0);
+    if (py_retlist == NULL)
+        goto error;
+    if (s.ninodes == 0) {
+        Py_DECREF(py_seq);
+        return py_retlist;
+    }
+
+    s.inodes = malloc(s.ninodes * sizeof(unsigned long));
+    s.found = calloc(s.ninodes, 1);
+    if (s.inodes == NULL || s.found == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    for (i = 0; i < s.ninodes; i++) {
+        s.inodes[i] = PyLong_AsUnsignedLong(
+            PySequence_Fast_GET_ITEM(py_seq, i));
+        if (s.inodes[i] == (unsigned long)-1 && PyErr_Occurred())
+            goto error;
+    }
+    Py_CLEAR(py_seq);
+    qsort(s.inodes, s.ninodes, sizeof(unsigned long), psutil_ulong_cmp);
+    // remove duplicates, else the scan would never stop early
+    for (i = 1, j = 1; i < s.ninodes; i++) {
+        if (s.inodes[i] != s.inodes[j - 1])
+            s.inodes[j++] = s.inodes[i];
+    }
+    s.ninodes = j;
+    s.remaining = j;
+
+    Py_BEGIN_ALLOW_THREADS
+    ret = psutil_fs_foreach_pid(procfs_path, psutil_fs_sockets_pid, &s);
+    Py_END_ALLOW_THREADS
+    if (ret != 0) {
+        if (errno == ENOMEM)
+            PyErr_NoMemory();
+        else
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, procfs_path);
+        goto error;
+    }
+
+    for (i = 0; i < s.nmatches; i++) {
+        py_tuple = Py_BuildValue(
+            "(kli)", s.matches[i].inode, s.matches[i].pid, s.matches[i].fd);
+        if (! py_tuple)
+            goto error;
+        if (PyList_Append(py_retlist, py_tuple))
+            goto error;
+        Py_CLEAR(py_tuple);
+    }
+
+    free(s.inodes);
+    free(s.found);
+    free(s.matches);
+    return py_retlist;
+
+error:
+    free(s.inodes);
+    free(s.found);
+    free(s.matches);
+    Py_XDECREF(py_seq);
+    Py_XDECREF(py_tuple);
+    Py_XDECREF(py_retlist);
+    return NULL;
+}
+
+
+// --- files
+
+
+static void
+psutil_fs_free_users(psutil_fs_files *f) {
+    size_t i;
+
+    for (i = 0; i < f->nusers; i++)
+        free(f->users[i].path);
+    free(f->users);
+}
+
+
+/*
+ * stat() the file a link in /proc/{pid}/fd, /proc/{pid}/map_files (or
+ * cwd, root, exe) refers to and, if it matches, add it to the users.
+ * Mappings of the same file are reported once per process. Return -1
+ * on error.
+ */
+static int
+psutil_fs_check_file(psutil_fs_files *f, int dir_fd, const char *name,
+                     long pid, int fd, const char *kind) {
+    struct stat st;
+    char link[PATH_MAX];
+    ssize_t len;
+    size_t i;
+    psutil_fs_user *user;
+    psutil_fs_user *newusers;
+
+    if (fstatat(dir_fd, name, &st, 0) != 0)
+        return 0;  // gone, not accessible or a dangling link
+    if (st.st_dev != f->dev || (! f->dev_only && st.st_ino != f->ino))
+        return 0;
+    if (fd == -1 && strcmp(kind, "mmap") == 0) {
+        for (i = f->pid_start; i < f->nusers; i++) {
+            user = &f->users[i];
+            if (user->fd == -1 && user->kind == kind &&
+                    user->dev == st.st_dev && user->ino == st.st_ino)
+                return 0;
+        }
+    }
+
+    len = readlinkat(dir_fd, name, link, sizeof(link) - 1);
+    if (len == -1)
+        len = 0;
+    link[len] = '\0';
+
+    if (f->nusers == f->users_size) {
+        newusers = realloc(
+            f->users, (f->users_size * 2 + 16) * sizeof(psutil_fs_user));
+        if (newusers == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        f->users = newusers;
+        f->users_size = f->users_size * 2 + 16;
+    }
+    user = &f->users[f->nusers];
+    user->path = strdup(link);
+    if (user->path == NULL) {
+        errno = ENOMEM;
+        return -1;
+    }
+    user->pid = pid;
+    user->fd = fd;
+    user->kind = kind;
+    user->dev = st.st_dev;
+    user->ino = st.st_ino;
+    f->nusers++;
+    return 0;
+}
+
+
+static int
+psutil_fs_check_dir(psutil_fs_files *f, const char *procfs_path, long pid,
+                    const char *subdir, const char *kind) {
+    char path[PATH_MAX];
+    DIR *dir;
+    struct dirent *entry;
+    long fd = -1;
+    char *end;
+
+    snprintf(path, sizeof(path), "%s/%ld/%s", procfs_path, pid, subdir);
+    dir = opendir(path);
+    if (dir == NULL)
+        return 0;  // gone or not accessible (map_files needs privileges)
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.')
+            continue;
+        if (strcmp(kind, "fd") == 0) {
+            fd = strtol(entry->d_name, &end, 10);
+            if (*end != '\0' || fd < 0)
+                continue;
+        }
+        if (psutil_fs_check_file(f, dirfd(dir), entry->d_name, pid,
+                                 (int)fd, kind) != 0) {
+            closedir(dir);
+            return -1;
+        }
+    }
+    closedir(dir);
+    return 0;
+}
+
+
+static int
+psutil_fs_files_pid(void *ctx, const char *procfs_path, long pid) {
+    psutil_fs_files *f = ctx;
+    char path[PATH_MAX];
+    int pid_fd;
+    int ret = 0;
+
+    f->pid_start = f->nusers;
+    snprintf(path, sizeof(path), "%s/%ld", procfs_path, pid);
+    pid_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (pid_fd == -1)
+        return 0;
+    if (psutil_fs_check_file(f, pid_fd, "cwd", pid, -1, "cwd") != 0 ||
+            psutil_fs_check_file(f, pid_fd, "root", pid, -1, "root") != 0 ||
+            psutil_fs_check_file(f, pid_fd, "exe", pid, -1, "exe") != 0 ||
+            psutil_fs_check_dir(f, procfs_path, pid, "fd", "fd") != 0 ||
+            psutil_fs_check_dir(f, procfs_path, pid, "map_files",
+                                "mmap") != 0)
+        ret = -1;
+    close(pid_fd);
+    return ret;
+}
+
+
+/*
+ * Given a procfs path and a file's (st_dev, st_ino), return a list of
+ * (pid, fd, kind, path) tuples for the processes using it, where kind
+ * is "fd", "mmap", "cwd", "root" or "exe" and fd is -1 if kind is not
+ * "fd". If dev_only is true every file on the st_dev filesystem is
+ * matched.
+ */
+PyObject *
+psutil_linux_file_users(PyObject *self, PyObject *args) {
+    char *procfs_path;
+    unsigned long long dev;
+    unsigned long long ino;
+    int dev_only;
+    int ret;
+    size_t i;
+    psutil_fs_files f;
+    psutil_fs_user *user;
+    PyObject *py_path = NULL;
+    PyObject *py_tuple = NULL;
+    PyObject *py_retlist = NULL;
+
+    if (!PyArg_ParseTuple(args, "sKKi", &procfs_path, &dev, &ino,
+                          &dev_only))
+        return NULL;
+
+    memset(&f, 0, sizeof(f));
+    f.dev = (dev_t)dev;
+    f.ino = (ino_t)ino;
+    f.dev_only = dev_only;
+
+    Py_BEGIN_ALLOW_THREADS
+    ret = psutil_fs_foreach_pid(procfs_path, psutil_fs_files_pid, &f);
+    Py_END_ALLOW_THREADS
+    if (ret != 0) {
+        if (errno == ENOMEM)
+            PyErr_NoMemory();
+        else
+            PyErr_SetFromErrnoWithFilename(PyExc_OSError, procfs_path);
+        goto error;
+    }
+
+    py_retlist = PyList_New(0);
+    if (py_retlist == NULL)
+        goto error;
+    for (i = 0; i < f.nusers; i++) {
+        user = &f.users[i];
+        py_path = PyUnicode_DecodeFSDefault(user->path);
+        if (! py_path)
+            goto error;
+        py_tuple = Py_BuildValue(
+            "(lisO)", user->pid, user->fd, user->kind, py_path);
+        if (! py_tuple)
+            goto error;
+        if (PyList_Append(py_retlist, py_tuple))
+            goto error;
+        Py_CLEAR(py_path);
+        Py_CLEAR(py_tuple);
+    }
+
+    psutil_fs_free_users(&f);
+    return py_retlist;
+
+error:
+    psutil_fs_free_users(&f);
+    Py_XDECREF(py_path);
+    Py_XDECREF(py_tuple);
+    Py_XDECREF(py_retlist);
+    return NULL;
+}
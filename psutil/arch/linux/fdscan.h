@@ -0,0 +1,10 @@
+/*
+ * Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include <Python.h>
+
+PyObject *psutil_linux_socket_owners(PyObject *self, PyObject *args);
+PyObject *psutil_linux_file_users(PyObject *self, PyObject *args);
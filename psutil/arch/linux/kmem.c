@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+Parsers for kernel memory accounting files which are too big (or too
+frequently read) to be parsed line by line in Python:
+
+- /proc/slabinfo: one line per slab cache (a few hundred)
+- /proc/vmallocinfo: one line per vmalloc area (thousands)
+
+Both are readable by root only.
+*/
+
+#include <Python.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../_psutil_common.h"
+#include "kmem.h"
+
+
+/*
+ * Parse /proc/slabinfo (version 2.x) and return a list of
+ * (name, active_objs, num_objs, objsize, objperslab, pagesperslab,
+ * num_slabs) tuples.
+ */
+PyObject *
+psutil_linux_slabinfo(PyObject *self, PyObject *args) {
+    char *path;
+    char line[512];
+    char name[128];
+    unsigned long active_objs;
+    unsigned long num_objs;
+    unsigned long objsize;
+    unsigned long objperslab;
+    unsigned long pagesperslab;
+    unsigned long active_slabs;
+    unsigned long num_slabs;
+    FILE *file = NULL;
+    PyObject *py_tuple = NULL;
+    PyObject *py_retlist = PyList_New(0);
+
+    if (py_retlist == NULL)
+        return NULL;
+    if (!PyArg_ParseTuple(args, "s", &path))
+        goto error;
+
+    file = fopen(path, "re");
+    if (file == NULL) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+        goto error;
+    }
+    if (fgets(line, sizeof(line), file) == NULL ||
+            strncmp(line, "slabinfo - version: 2.", 22) != 0) {
+        PyErr_Format(PyExc_RuntimeError, "unsupported %s format", path);
+        goto error;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] == '#')
+            continue;
+        if (sscanf(line,
+                   "%127s %lu %lu %lu %lu %lu : tunables %*u %*u %*u "
+                   ": slabdata %lu %lu",
+                   name, &active_objs, &num_objs, &objsize, &objperslab,
+                   &pagesperslab, &active_slabs, &num_slabs) != 8) {
+            continue;
+        }
+        py_tuple = Py_BuildValue(
+            "(skkkkkk)", name, active_objs, num_objs, objsize, objperslab,
+            pagesperslab, num_slabs);
+        if (! py_tuple)
+            goto error;
+        if (PyList_Append(py_retlist, py_tuple))
+            goto error;
+        Py_CLEAR(py_tuple);
+    }
+    if (ferror(file)) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+        goto error;
+    }
+
+    fclose(file);
+    return py_retlist;
+
+error:
+    if (file != NULL)
+        fclose(file);
+    Py_XDECREF(py_tuple);
+    Py_DECREF(py_retlist);
+    return NULL;
+}
+
+
+/*
+ * Parse /proc/vmallocinfo and return a list of (caller, size) tuples,
+ * one for each area allocated via vmalloc() (ioremap(), vmap() etc.
+ * areas don't allocate memory and are skipped). The caller offset
+ * (e.g. "+0x1d9/0x1f0") is stripped.
+ */
+PyObject *
+psutil_linux_vmallocinfo(PyObject *self, PyObject *args) {
+    char *path;
+    char *line = NULL;
+    char *p;
+    size_t linesize = 0;
+    char caller[256];
+    int pos;
+    unsigned long size;
+    FILE *file = NULL;
+    PyObject *py_tuple = NULL;
+    PyObject *py_retlist = PyList_New(0);
+
+    if (py_retlist == NULL)
+        return NULL;
+    if (!PyArg_ParseTuple(args, "s", &path))
+        goto error;
+
+    file = fopen(path, "re");
+    if (file == NULL) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+        goto error;
+    }
+
+    while (getline(&line, &linesize, file) != -1) {
+        // 0xffffa1b8c0000000-0xffffa1b8c0005000   20480 func+0x1/0x2 ...
+        if (sscanf(line, "%*s %lu %255s%n", &size, caller, &pos) != 2)
+            continue;
+        // the area type comes after the caller (and other fields)
+        p = line + pos;
+        while ((p = strstr(p, " vmalloc")) != NULL) {
+            if (p[8] == ' ' || p[8] == '\n' || p[8] == '\0')
+                break;
+            p += 8;
+        }
+        if (p == NULL)
+            continue;
+        p = strchr(caller, '+');
+        if (p != NULL)
+            *p = '\0';
+        py_tuple = Py_BuildValue("(sk)", caller, size);
+        if (! py_tuple)
+            goto error;
+        if (PyList_Append(py_retlist, py_tuple))
+            goto error;
+        Py_CLEAR(py_tuple);
+    }
+    if (ferror(file)) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+        goto error;
+    }
+
+    free(line);
+    fclose(file);
+    return py_retlist;
+
+error:
+    free(line);
+    if (file != NULL)
+        fclose(file);
+    Py_XDECREF(py_tuple);
+    Py_DECREF(py_retlist);
+    return NULL;
+}
@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+Working set size estimation via idle page tracking, see:
+https://www.kernel.org/doc/html/latest/admin-guide/mm/idle_page_tracking.html
+
+- /proc/{pid}/pagemap maps each virtual page of a process to the page
+  frame number (PFN) of the physical page backing it (a PFN is reported
+  only to CAP_SYS_ADMIN, else it's 0)
+- /sys/kernel/mm/page_idle/bitmap has a bit for each PFN; writing 1
+  marks the page as idle, and the bit is cleared as soon as the page is
+  accessed. It must be read and written in 8-byte words.
+
+PFNs are passed to Python (and back) as bytes of native uint64_t, sorted
+and without duplicates.
+*/
+
+#include <Python.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../_psutil_common.h"
+#include "pageidle.h"
+
+
+#define PSUTIL_PM_PRESENT (1ULL << 63)
+#define PSUTIL_PM_PFN_MASK ((1ULL << 55) - 1)
+// number of pagemap entries read per pread()
+#define PSUTIL_PM_CHUNK 4096
+// max number of bitmap words read or written per syscall
+#define PSUTIL_BITMAP_MAX_WORDS 512
+// PFNs whose bitmap words are this close are read or written with the
+// same syscall
+#define PSUTIL_BITMAP_MAX_GAP 8
+
+
+static int
+psutil_u64_cmp(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+// Sort and remove duplicates in place; return the new length.
+static size_t
+psutil_sort_uniq(uint64_t *arr, size_t n) {
+    size_t i;
+    size_t j = 0;
+
+    if (n == 0)
+        return 0;
+    qsort(arr, n, sizeof(uint64_t), psutil_u64_cmp);
+    for (i = 1; i < n; i++) {
+        if (arr[i] != arr[j])
+            arr[++j] = arr[i];
+    }
+    return j + 1;
+}
+
+
+/*
+ * Walk all the mappings listed in maps_path and return a malloc()ed
+ * array of the PFNs of the pages which are present in memory, storing
+ * its length in *count and the number of present pages in *present.
+ * Return NULL on error (errno is set).
+ */
+static uint64_t *
+psutil_scan_pagemap(const char *maps_path, const char *pagemap_path,
+                    size_t *count, size_t *present) {
+    FILE *maps = NULL;
+    int fd = -1;
+    char *line = NULL;
+    size_t linesize = 0;
+    char perms[5];
+    unsigned long start;
+    unsigned long end;
+    uint64_t page;
+    uint64_t last;
+    uint64_t entry;
+    uint64_t *entries = NULL;
+    uint64_t *pfns = NULL;
+    uint64_t *newpfns;
+    size_t size = 4096;
+    size_t n = 0;
+    size_t nentries;
+    size_t i;
+    ssize_t ret;
+    long pagesize = sysconf(_SC_PAGESIZE);
+
+    *present = 0;
+    maps = fopen(maps_path, "re");
+    if (maps == NULL)
+        goto error;
+    fd = open(pagemap_path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        goto error;
+    entries = malloc(PSUTIL_PM_CHUNK * sizeof(uint64_t));
+    pfns = malloc(size * sizeof(uint64_t));
+    if (entries == NULL || pfns == NULL) {
+        errno = ENOMEM;
+        goto error;
+    }
+
+    while (getline(&line, &linesize, maps) != -1) {
+        if (sscanf(line, "%lx-%lx %4s", &start, &end, perms) != 3)
+            continue;
+        // Skip PROT_NONE mappings (guard pages, address space
+        // reservations), which can be huge and have no pages.
+        if (strncmp(perms, "---", 3) == 0)
+            continue;
+        if (strstr(line, "[vsyscall]") != NULL)
+            continue;
+        page = start / pagesize;
+        last = end / pagesize;
+        while (page < last) {
+            nentries = (size_t)(last - page);
+            if (nentries > PSUTIL_PM_CHUNK)
+                nentries = PSUTIL_PM_CHUNK;
+            ret = pread(fd, entries, nentries * sizeof(uint64_t),
+                        (off_t)(page * sizeof(uint64_t)));
+            if (ret == -1) {
+                if (errno == EINTR)
+                    continue;
+                goto error;
+            }
+            if (ret == 0)
+                break;
+            nentries = (size_t)ret / sizeof(uint64_t);
+            for (i = 0; i < nentries; i++) {
+                entry = entries[i];
+                if (! (entry & PSUTIL_PM_PRESENT))
+                    continue;
+                (*present)++;
+                if ((entry & PSUTIL_PM_PFN_MASK) == 0)
+                    continue;  // no CAP_SYS_ADMIN
+                if (n == size) {
+                    newpfns = realloc(pfns, size * 2 * sizeof(uint64_t));
+                    if (newpfns == NULL) {
+                        errno = ENOMEM;
+                        goto error;
+                    }
+                    pfns = newpfns;
+                    size *= 2;
+                }
+                pfns[n++] = entry & PSUTIL_PM_PFN_MASK;
+            }
+            page += nentries;
+        }
+    }
+    if (ferror(maps))
+        goto error;
+
+    free(line);
+    free(entries);
+    fclose(maps);
+    close(fd);
+    *count = psutil_sort_uniq(pfns, n);
+    return pfns;
+
+error:
+    if (errno == 0)
+        errno = EIO;
+    free(line);
+    free(entries);
+    free(pfns);
+    if (maps != NULL)
+        fclose(maps);
+    if (fd != -1)
+        close(fd);
+    return NULL;
+}
+
+
+/*
+ * Mark as idle (if mark != 0) or count the PFNs which are not idle
+ * (if mark == 0, storing the result in *accessed) in the page_idle
+ * bitmap opened as fd. PFNs must be sorted. Return -1 on error.
+ */
+static int
+psutil_bitmap_io(int fd, const uint64_t *pfns, size_t n, int mark,
+                 size_t *accessed) {
+    uint64_t words[PSUTIL_BITMAP_MAX_WORDS];
+    uint64_t first;
+    uint64_t last;
+    uint64_t word;
+    size_t nbytes;
+    size_t i = 0;
+    size_t j;
+    size_t k;
+    ssize_t ret;
+
+    if (accessed != NULL)
+        *accessed = 0;
+    while (i < n) {
+        // group the PFNs which are stored in close words
+        first = pfns[i] / 64;
+        last = first;
+        for (j = i; j < n; j++) {
+            word = pfns[j] / 64;
+            if (word - last > PSUTIL_BITMAP_MAX_GAP ||
+                    word - first >= PSUTIL_BITMAP_MAX_WORDS)
+                break;
+            last = word;
+        }
+        nbytes = (size_t)(last - first + 1) * sizeof(uint64_t);
+
+        if (mark) {
+            // 0 bits are ignored by the kernel
+            memset(words, 0, nbytes);
+            for (k = i; k < j; k++)
+                words[pfns[k] / 64 - first] |= 1ULL << (pfns[k] % 64);
+            do {
+                ret = pwrite(fd, words, nbytes,
+                             (off_t)(first * sizeof(uint64_t)));
+            } while (ret == -1 && errno == EINTR);
+            if (ret == -1)
+                return -1;
+        }
+        else {
+            // words past the end of the bitmap count as idle
+            memset(words, 0xff, nbytes);
+            do {
+                ret = pread(fd, words, nbytes,
+                            (off_t)(first * sizeof(uint64_t)));
+            } while (ret == -1 && errno == EINTR);
+            if (ret == -1)
+                return -1;
+            for (k = i; k < j; k++) {
+                if (! (words[pfns[k] / 64 - first] & (1ULL << (pfns[k] % 64))))
+                    (*accessed)++;
+            }
+        }
+        i = j;
+    }
+    return 0;
+}
+
+
+/*
+ * Given a process' maps and pagemap file paths, return a
+ * (pfns, present) tuple where pfns are the PFNs (bytes of sorted
+ * uint64_t) of the pages which are present in memory and present is the
+ * number of present pages. Without CAP_SYS_ADMIN the kernel doesn't
+ * report PFNs, in which case pfns is empty while present is not 0.
+ */
+PyObject *
+psutil_linux_pagemap_pfns(PyObject *self, PyObject *args) {
+    char *maps_path;
+    char *pagemap_path;
+    uint64_t *pfns;
+    size_t count = 0;
+    size_t present = 0;
+    PyObject *py_pfns = NULL;
+    PyObject *py_ret = NULL;
+
+    if (!PyArg_ParseTuple(args, "ss", &maps_path, &pagemap_path))
+        return NULL;
+
+    errno = 0;
+    Py_BEGIN_ALLOW_THREADS
+    pfns = psutil_scan_pagemap(maps_path, pagemap_path, &count, &present);
+    Py_END_ALLOW_THREADS
+    if (pfns == NULL) {
+        if (errno == ENOMEM)
+            return PyErr_NoMemory();
+        return PyErr_SetFromErrnoWithFilename(PyExc_OSError, pagemap_path);
+    }
+
+    py_pfns = PyBytes_FromStringAndSize(
+        (const char *)pfns, (Py_ssize_t)(count * sizeof(uint64_t)));
+    free(pfns);
+    if (py_pfns == NULL)
+        return NULL;
+    py_ret = Py_BuildValue("(On)", py_pfns, (Py_ssize_t)present);
+    Py_DECREF(py_pfns);
+    return py_ret;
+}
+
+
+/*
+ * Shared implementation of page_idle_mark() and page_idle_count().
+ * Return the number of accessed pages, or -1 on error.
+ */
+static Py_ssize_t
+psutil_page_idle(PyObject *args, int mark) {
+    char *bitmap_path;
+    int fd = -1;
+    int ret = -1;
+    size_t n;
+    size_t accessed = 0;
+    uint64_t *pfns = NULL;
+    Py_buffer buf;
+
+#if PY_MAJOR_VERSION >= 3
+    if (!PyArg_ParseTuple(args, "sy*", &bitmap_path, &buf))
+#else
+    if (!PyArg_ParseTuple(args, "ss*", &bitmap_path, &buf))
+#endif
+        return -1;
+    if ((size_t)buf.len % sizeof(uint64_t)) {
+        PyErr_SetString(PyExc_ValueError, "invalid buffer size");
+        goto error;
+    }
+    n = (size_t)buf.len / sizeof(uint64_t);
+    // + 1 so that we never malloc(0)
+    pfns = malloc((n + 1) * sizeof(uint64_t));
+    if (pfns == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    memcpy(pfns, buf.buf, n * sizeof(uint64_t));
+    // PFNs of different processes may be concatenated
+    n = psutil_sort_uniq(pfns, n);
+    fd = open(bitmap_path, (mark ? O_WRONLY : O_RDONLY) | O_CLOEXEC);
+    if (fd != -1)
+        ret = psutil_bitmap_io(fd, pfns, n, mark, &accessed);
+    Py_END_ALLOW_THREADS
+    if (ret == -1) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, bitmap_path);
+        goto error;
+    }
+
+    close(fd);
+    free(pfns);
+    PyBuffer_Release(&buf);
+    return (Py_ssize_t)accessed;
+
+error:
+    if (fd != -1)
+        close(fd);
+    free(pfns);
+    PyBuffer_Release(&buf);
+    return -1;
+}
+
+
+/*
+ * Mark the given PFNs (bytes of uint64_t) as idle in the page_idle
+ * bitmap.
+ */
+PyObject *
+psutil_linux_page_idle_mark(PyObject *self, PyObject *args) {
+    if (psutil_page_idle(args, 1) == -1)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+
+/*
+ * Return how many of the given PFNs (bytes of uint64_t) are no longer
+ * idle in the page_idle bitmap, that is how many pages were accessed
+ * since they were marked as idle.
+ */
+PyObject *
+psutil_linux_page_idle_count(PyObject *self, PyObject *args) {
+    Py_ssize_t accessed = psutil_page_idle(args, 0);
+
+    if (accessed == -1)
+        return NULL;
+    return Py_BuildValue("n", accessed);
+}
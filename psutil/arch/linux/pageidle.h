@@ -0,0 +1,11 @@
+/*
+ * Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include <Python.h>
+
+PyObject *psutil_linux_pagemap_pfns(PyObject *self, PyObject *args);
+PyObject *psutil_linux_page_idle_mark(PyObject *self, PyObject *args);
+PyObject *psutil_linux_page_idle_count(PyObject *self, PyObject *args);
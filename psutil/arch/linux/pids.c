@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+PIDs enumeration. Rather than using os.listdir("/proc"), which creates
+a string for every entry (including the non-PID ones), /proc directory
+entries are parsed straight from getdents64(2) into a sorted array of
+C ints, which is returned to Python as bytes (to be wrapped into an
+array.array('i')).
+*/
+
+#include <Python.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "../../_psutil_common.h"
+#include "pids.h"
+
+
+// Same as struct dirent64, which is not always exposed by libc.
+struct psutil_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+
+static int
+psutil_int_cmp(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+
+/*
+ * Return a malloc()ed, sorted array of the PIDs listed in procfs_path,
+ * storing its length in *count. Return NULL on error (errno is set).
+ */
+static int *
+psutil_scan_pids(const char *procfs_path, size_t *count) {
+    int fd;
+    int pid;
+    int *pids = NULL;
+    int *newpids;
+    size_t size = 512;
+    size_t n = 0;
+    long nread;
+    long pos;
+    char *name;
+    char buf[32768];
+    struct psutil_dirent64 *ent;
+
+    fd = open(procfs_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1)
+        return NULL;
+    pids = malloc(size * sizeof(int));
+    if (pids == NULL)
+        goto error;
+
+    while (1) {
+        nread = syscall(SYS_getdents64, fd, buf, sizeof(buf));
+        if (nread == -1) {
+            if (errno == EINTR)
+                continue;
+            goto error;
+        }
+        if (nread == 0)
+            break;
+        for (pos = 0; pos < nread; pos += ent->d_reclen) {
+            ent = (struct psutil_dirent64 *)(buf + pos);
+            name = ent->d_name;
+            if (*name < '1' || *name > '9')
+                continue;
+            pid = 0;
+            while (*name >= '0' && *name <= '9')
+                pid = pid * 10 + (*name++ - '0');
+            if (*name != '\0')
+                continue;
+            if (n == size) {
+                newpids = realloc(pids, size * 2 * sizeof(int));
+                if (newpids == NULL)
+                    goto error;
+                pids = newpids;
+                size *= 2;
+            }
+            pids[n++] = pid;
+        }
+    }
+
+    close(fd);
+    // /proc lists PIDs in ascending order, but don't rely on it
+    qsort(pids, n, sizeof(int), psutil_int_cmp);
+    *count = n;
+    return pids;
+
+error:
+    if (errno == 0)
+        errno = ENOMEM;
+    free(pids);
+    close(fd);
+    return NULL;
+}
+
+
+/*
+ * Return all PIDs listed in the given procfs path as a sorted sequence
+ * of native C ints (bytes).
+ */
+PyObject *
+psutil_linux_pids(PyObject *self, PyObject *args) {
+    int *pids;
+    size_t count = 0;
+    char *procfs_path;
+    PyObject *py_ret;
+
+    if (!PyArg_ParseTuple(args, "s", &procfs_path))
+        return NULL;
+
+    errno = 0;
+    Py_BEGIN_ALLOW_THREADS
+    pids = psutil_scan_pids(procfs_path, &count);
+    Py_END_ALLOW_THREADS
+    if (pids == NULL) {
+        if (errno == ENOMEM)
+            return PyErr_NoMemory();
+        return PyErr_SetFromErrnoWithFilename(PyExc_OSError, procfs_path);
+    }
+    py_ret = PyBytes_FromStringAndSize(
+        (const char *)pids, (Py_ssize_t)(count * sizeof(int)));
+    free(pids);
+    return py_ret;
+}
+
+
+/*
+ * Takes 2 sequences of native C ints (any object supporting the buffer
+ * protocol, e.g. array.array('i')), the previous and the current PIDs,
+ * and return a (new, gone) tuple of bytes, in the same format. The
+ * current PIDs are expected to be sorted, as returned by
+ * psutil_linux_pids(); previous PIDs can be in any order.
+ */
+PyObject *
+psutil_linux_pids_diff(PyObject *self, PyObject *args) {
+    int *prev = NULL;
+    int *cur;
+    int *new_pids = NULL;
+    int *gone_pids = NULL;
+    size_t i = 0;
+    size_t j = 0;
+    size_t nprev;
+    size_t ncur;
+    size_t nnew = 0;
+    size_t ngone = 0;
+    Py_buffer prev_buf;
+    Py_buffer cur_buf;
+    PyObject *py_new = NULL;
+    PyObject *py_gone = NULL;
+    PyObject *py_ret = NULL;
+
+#if PY_MAJOR_VERSION >= 3
+    if (!PyArg_ParseTuple(args, "y*y*", &prev_buf, &cur_buf))
+#else
+    if (!PyArg_ParseTuple(args, "s*s*", &prev_buf, &cur_buf))
+#endif
+        return NULL;
+    if (((size_t)prev_buf.len % sizeof(int)) ||
+            ((size_t)cur_buf.len % sizeof(int))) {
+        PyErr_SetString(PyExc_ValueError, "invalid buffer size");
+        goto error;
+    }
+    nprev = (size_t)prev_buf.len / sizeof(int);
+    ncur = (size_t)cur_buf.len / sizeof(int);
+    cur = (int *)cur_buf.buf;
+
+    // + 1 so that we never malloc(0)
+    prev = malloc((nprev + 1) * sizeof(int));
+    new_pids = malloc((ncur + 1) * sizeof(int));
+    gone_pids = malloc((nprev + 1) * sizeof(int));
+    if (prev == NULL || new_pids == NULL || gone_pids == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    memcpy(prev, prev_buf.buf, nprev * sizeof(int));
+    qsort(prev, nprev, sizeof(int), psutil_int_cmp);
+    // merge the 2 sorted arrays
+    while (i < nprev || j < ncur) {
+        if (j == ncur || (i < nprev && prev[i] < cur[j])) {
+            if (i == 0 || prev[i] != prev[i - 1])  // skip dupes
+                gone_pids[ngone++] = prev[i];
+            i++;
+        }
+        else if (i == nprev || cur[j] < prev[i]) {
+            new_pids[nnew++] = cur[j++];
+        }
+        else {
+            i++;
+            j++;
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    py_new = PyBytes_FromStringAndSize(
+        (const char *)new_pids, (Py_ssize_t)(nnew * sizeof(int)));
+    if (py_new == NULL)
+        goto error;
+    py_gone = PyBytes_FromStringAndSize(
+        (const char *)gone_pids, (Py_ssize_t)(ngone * sizeof(int)));
+    if (py_gone == NULL)
+        goto error;
+    py_ret = Py_BuildValue("(OO)", py_new, py_gone);
+
+error:
+    Py_XDECREF(py_new);
+    Py_XDECREF(py_gone);
+    free(prev);
+    free(new_pids);
+    free(gone_pids);
+    PyBuffer_Release(&prev_buf);
+    PyBuffer_Release(&cur_buf);
+    return py_ret;
+}
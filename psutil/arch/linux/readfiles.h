@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include <Python.h>
+#include <sys/types.h>
+
+// A request to read a whole (small) file. If path is NULL fd is an
+// already opened file which is read from offset 0 and left open,
+// else path is opened relative to dirfd (openat(2) semantic) and
+// closed after reading it.
+typedef struct {
+    int dirfd;
+    const char *path;
+    int fd;
+    char *buf;
+    size_t bufsize;
+    size_t len;
+    int err;   // errno of the syscall which failed, or 0
+} psutil_readreq;
+
+void psutil_read_files_batch(psutil_readreq *reqs, size_t nreqs,
+                             int use_uring);
+
+PyObject *psutil_linux_read_files(PyObject *self, PyObject *args);
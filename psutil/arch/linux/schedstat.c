@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+Parser for /proc/schedstat (requires CONFIG_SCHEDSTATS), see:
+https://www.kernel.org/doc/html/latest/scheduler/sched-stats.html
+
+It has a "cpuN" line per CPU, each followed by one "domainN" line per
+scheduling domain, which are skipped. With many CPUs and domains the
+file is big enough for line by line parsing in Python to show up when
+it's polled every second.
+*/
+
+#include <Python.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../_psutil_common.h"
+#include "schedstat.h"
+
+
+/*
+ * Parse /proc/schedstat and return a list of
+ * (cpu, run_time, run_delay, timeslices) tuples, where run_time is the
+ * time spent running by tasks on the CPU and run_delay the time spent
+ * by tasks waiting to run on it, both in nanoseconds.
+ */
+PyObject *
+psutil_linux_schedstat(PyObject *self, PyObject *args) {
+    char *path;
+    char *line = NULL;
+    size_t linesize = 0;
+    int version = 0;
+    long cpu;
+    unsigned long long run_time;
+    unsigned long long run_delay;
+    unsigned long long timeslices;
+    FILE *file = NULL;
+    PyObject *py_tuple = NULL;
+    PyObject *py_retlist = PyList_New(0);
+
+    if (py_retlist == NULL)
+        return NULL;
+    if (!PyArg_ParseTuple(args, "s", &path))
+        goto error;
+
+    file = fopen(path, "re");
+    if (file == NULL) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+        goto error;
+    }
+    // The cpu line format is the same since version 10 (Linux 2.6.23).
+    if (getline(&line, &linesize, file) == -1 ||
+            sscanf(line, "version %d", &version) != 1 || version < 10) {
+        PyErr_Format(PyExc_RuntimeError, "unsupported %s format", path);
+        goto error;
+    }
+
+    while (getline(&line, &linesize, file) != -1) {
+        if (strncmp(line, "cpu", 3) != 0)
+            continue;
+        // cpuN yld_count legacy sched_count sched_goidle ttwu_count
+        //      ttwu_local run_time run_delay timeslices
+        if (sscanf(line, "cpu%ld %*u %*u %*u %*u %*u %*u %llu %llu %llu",
+                   &cpu, &run_time, &run_delay, &timeslices) != 4) {
+            continue;
+        }
+        py_tuple = Py_BuildValue(
+            "(lKKK)", cpu, run_time, run_delay, timeslices);
+        if (! py_tuple)
+            goto error;
+        if (PyList_Append(py_retlist, py_tuple))
+            goto error;
+        Py_CLEAR(py_tuple);
+    }
+    if (ferror(file)) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+        goto error;
+    }
+
+    free(line);
+    fclose(file);
+    return py_retlist;
+
+error:
+    free(line);
+    if (file != NULL)
+        fclose(file);
+    Py_XDECREF(py_tuple);
+    Py_DECREF(py_retlist);
+    return NULL;
+}
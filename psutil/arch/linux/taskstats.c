@@ -0,0 +1,454 @@
+/*
+ * Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+Per-task exit accounting via the TASKSTATS generic netlink family, see:
+https://www.kernel.org/doc/html/latest/accounting/taskstats.html
+
+A listener registers for a set of CPUs (TASKSTATS_CMD_ATTR_REGISTER_CPUMASK)
+and from then on the kernel sends it a struct taskstats for every task
+(thread) exiting on those CPUs, including the ones which lived for a few
+milliseconds only. Registering requires CAP_NET_ADMIN.
+
+Messages are queued in the socket receive buffer; if the listener doesn't
+keep up the kernel drops them and recv() fails with ENOBUFS.
+
+struct taskstats only grows at its end (see TASKSTATS_VERSION), so a
+struct sent by an older or newer kernel than the one we're compiled
+against is copied up to the size both know about.
+*/
+
+#include <Python.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/genetlink.h>
+#include <linux/netlink.h>
+#include <linux/taskstats.h>
+
+#include "../../_psutil_common.h"
+#include "taskstats.h"
+
+
+#define PSUTIL_TS_RCVBUF (4 * 1024 * 1024)
+// Max number of datagrams read per taskstats_read() call, so that it
+// returns (and the caller can check whether it has to stop) also if
+// tasks exit faster than we can read their notifications.
+#define PSUTIL_TS_MAX_RECV 256
+#define PSUTIL_NLA_DATA(na) ((void *)((char *)(na) + NLA_HDRLEN))
+#define PSUTIL_NLA_NEXT(na) \
+    ((struct nlattr *)((char *)(na) + NLA_ALIGN((na)->nla_len)))
+#define PSUTIL_NLA_OK(na, len) \
+    ((len) >= (int)sizeof(struct nlattr) && \
+     (na)->nla_len >= sizeof(struct nlattr) && (na)->nla_len <= (len))
+#define PSUTIL_GENLMSG_ATTRS(nlh) \
+    ((struct nlattr *)((char *)NLMSG_DATA(nlh) + GENL_HDRLEN))
+#define PSUTIL_GENLMSG_ATTRLEN(nlh) \
+    ((int)(nlh)->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN))
+
+// Max length of a netlink attribute payload (nla_len is 16 bits).
+#define PSUTIL_NLA_MAXLEN (0xffff - NLA_HDRLEN)
+
+
+/*
+ * Send a generic netlink request with a single attribute to the kernel
+ * and, if ack is true, wait for its acknowledgement. Buffers are sized
+ * after the attribute, as the cpumask string of a REGISTER_CPUMASK
+ * request can be long (up to TASKSTATS_CPUMASK_MAXLEN, that is 100 +
+ * 6 * NR_CPUS bytes).
+ * Return 0 or -1 (errno is set).
+ */
+static int
+psutil_genl_send(int fd, __u16 type, __u8 cmd, __u16 attr_type,
+                 const void *data, int len, int ack) {
+    struct nlmsghdr *req = NULL;
+    struct nlmsghdr *resp = NULL;
+    struct genlmsghdr *genl;
+    struct nlattr *na;
+    struct nlmsgerr *err;
+    struct sockaddr_nl addr;
+    size_t reqsize;
+    size_t respsize;
+    ssize_t ret;
+    int saved_errno;
+
+    if (len < 0 || len > PSUTIL_NLA_MAXLEN) {
+        errno = EINVAL;
+        return -1;
+    }
+    reqsize = NLMSG_SPACE(GENL_HDRLEN + NLA_HDRLEN + NLA_ALIGN(len));
+    req = calloc(1, reqsize);
+    if (req == NULL) {
+        errno = ENOMEM;
+        goto error;
+    }
+    req->nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+    req->nlmsg_type = type;
+    req->nlmsg_flags = NLM_F_REQUEST | (ack ? NLM_F_ACK : 0);
+    genl = (struct genlmsghdr *)NLMSG_DATA(req);
+    genl->cmd = cmd;
+    genl->version = 1;
+    na = (struct nlattr *)((char *)req + NLMSG_ALIGN(req->nlmsg_len));
+    na->nla_type = attr_type;
+    na->nla_len = NLA_HDRLEN + len;
+    memcpy(PSUTIL_NLA_DATA(na), data, len);
+    req->nlmsg_len += NLA_ALIGN(na->nla_len);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    do {
+        ret = sendto(fd, req, req->nlmsg_len, 0,
+                     (struct sockaddr *)&addr, sizeof(addr));
+    } while (ret == -1 && errno == EINTR);
+    if (ret == -1)
+        goto error;
+    if (! ack) {
+        free(req);
+        return 0;
+    }
+
+    // An error ack echoes the whole request back.
+    respsize = NLMSG_SPACE(sizeof(struct nlmsgerr)) + reqsize;
+    resp = malloc(respsize);
+    if (resp == NULL) {
+        errno = ENOMEM;
+        goto error;
+    }
+    do {
+        ret = recv(fd, resp, respsize, 0);
+    } while (ret == -1 && errno == EINTR);
+    if (ret == -1)
+        goto error;
+    if (! NLMSG_OK(resp, (size_t)ret) || resp->nlmsg_type != NLMSG_ERROR) {
+        errno = EBADMSG;
+        goto error;
+    }
+    err = (struct nlmsgerr *)NLMSG_DATA(resp);
+    if (err->error != 0) {
+        errno = -err->error;
+        goto error;
+    }
+    free(req);
+    free(resp);
+    return 0;
+
+error:
+    saved_errno = errno;
+    free(req);
+    free(resp);
+    errno = saved_errno;
+    return -1;
+}
+
+
+/*
+ * Resolve the id of the TASKSTATS generic netlink family.
+ * Return it or -1 (errno is set, ENOENT if CONFIG_TASKSTATS is not set).
+ */
+static int
+psutil_taskstats_family(int fd) {
+    char resp[4096];
+    struct nlmsghdr *nlh = (struct nlmsghdr *)resp;
+    struct nlattr *na;
+    ssize_t ret;
+    int len;
+
+    if (psutil_genl_send(fd, GENL_ID_CTRL, CTRL_CMD_GETFAMILY,
+                         CTRL_ATTR_FAMILY_NAME, TASKSTATS_GENL_NAME,
+                         sizeof(TASKSTATS_GENL_NAME), 0) == -1)
+        return -1;
+    do {
+        ret = recv(fd, resp, sizeof(resp), 0);
+    } while (ret == -1 && errno == EINTR);
+    if (ret == -1)
+        return -1;
+    if (! NLMSG_OK(nlh, (size_t)ret)) {
+        errno = EBADMSG;
+        return -1;
+    }
+    if (nlh->nlmsg_type == NLMSG_ERROR) {
+        errno = -((struct nlmsgerr *)NLMSG_DATA(nlh))->error;
+        return -1;
+    }
+    na = PSUTIL_GENLMSG_ATTRS(nlh);
+    len = PSUTIL_GENLMSG_ATTRLEN(nlh);
+    while (PSUTIL_NLA_OK(na, len)) {
+        if (na->nla_type == CTRL_ATTR_FAMILY_ID)
+            return *(__u16 *)PSUTIL_NLA_DATA(na);
+        len -= NLA_ALIGN(na->nla_len);
+        na = PSUTIL_NLA_NEXT(na);
+    }
+    errno = ENOENT;
+    return -1;
+}
+
+
+/*
+ * Open a netlink socket, register it as a TASKSTATS listener for the
+ * CPUs in cpumask (e.g. "0-3,6") and return a (fd, family_id) tuple.
+ */
+PyObject *
+psutil_linux_taskstats_open(PyObject *self, PyObject *args) {
+    char *cpumask;
+    int fd;
+    int family;
+    int rcvbuf = PSUTIL_TS_RCVBUF;
+    struct sockaddr_nl addr;
+
+    if (!PyArg_ParseTuple(args, "s", &cpumask))
+        return NULL;
+
+    fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    if (fd == -1)
+        return PyErr_SetFromErrno(PyExc_OSError);
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+        goto error;
+    // Exit notifications come in bursts (e.g. "make -j"): the bigger
+    // the buffer the less likely they're lost. SO_RCVBUFFORCE ignores
+    // net.core.rmem_max but requires CAP_NET_ADMIN, which we need
+    // anyway.
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf,
+                   sizeof(rcvbuf)) == -1) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+
+    family = psutil_taskstats_family(fd);
+    if (family == -1)
+        goto error;
+    if (psutil_genl_send(fd, (__u16)family, TASKSTATS_CMD_GET,
+                         TASKSTATS_CMD_ATTR_REGISTER_CPUMASK, cpumask,
+                         (int)strlen(cpumask) + 1, 1) == -1)
+        goto error;
+    return Py_BuildValue("(ii)", fd, family);
+
+error:
+    PyErr_SetFromErrno(PyExc_OSError);
+    close(fd);
+    return NULL;
+}
+
+
+/*
+ * Deregister a TASKSTATS listener opened by taskstats_open() and close
+ * its socket.
+ */
+PyObject *
+psutil_linux_taskstats_close(PyObject *self, PyObject *args) {
+    char *cpumask;
+    int fd;
+    int family;
+    int ret;
+
+    if (!PyArg_ParseTuple(args, "iis", &fd, &family, &cpumask))
+        return NULL;
+    // Not strictly necessary as listeners whose socket is closed are
+    // eventually removed by the kernel, but do it anyway.
+    ret = psutil_genl_send(fd, (__u16)family, TASKSTATS_CMD_GET,
+                           TASKSTATS_CMD_ATTR_DEREGISTER_CPUMASK, cpumask,
+                           (int)strlen(cpumask) + 1, 0);
+    close(fd);
+    if (ret == -1)
+        return PyErr_SetFromErrno(PyExc_OSError);
+    Py_RETURN_NONE;
+}
+
+
+/*
+ * Append the struct taskstats found in a TASKSTATS_TYPE_AGGR_PID
+ * attribute to *stats. Return -1 on ENOMEM.
+ */
+static int
+psutil_taskstats_append(struct nlattr *aggr, struct taskstats **stats,
+                        size_t *count, size_t *size) {
+    struct nlattr *na = PSUTIL_NLA_DATA(aggr);
+    int len = aggr->nla_len - NLA_HDRLEN;
+    size_t copylen;
+    struct taskstats *newstats;
+
+    while (PSUTIL_NLA_OK(na, len)) {
+        if (na->nla_type == TASKSTATS_TYPE_STATS) {
+            if (*count == *size) {
+                newstats = realloc(
+                    *stats, (*size * 2 + 64) * sizeof(struct taskstats));
+                if (newstats == NULL)
+                    return -1;
+                *stats = newstats;
+                *size = *size * 2 + 64;
+            }
+            copylen = na->nla_len - NLA_HDRLEN;
+            if (copylen > sizeof(struct taskstats))
+                copylen = sizeof(struct taskstats);
+            memset(&(*stats)[*count], 0, sizeof(struct taskstats));
+            memcpy(&(*stats)[*count], PSUTIL_NLA_DATA(na), copylen);
+            (*count)++;
+            return 0;
+        }
+        len -= NLA_ALIGN(na->nla_len);
+        na = PSUTIL_NLA_NEXT(na);
+    }
+    return 0;
+}
+
+
+/*
+ * Wait up to timeout seconds for exit notifications on a socket opened
+ * by taskstats_open(), then read the queued ones without blocking (up
+ * to PSUTIL_TS_MAX_RECV datagrams; the rest is left for the next
+ * call).
+ * Return a (tasks, overruns) tuple where tasks is a list of tuples
+ * (one per exited task) and overruns is the number of times the socket
+ * buffer overflowed, meaning some notifications were lost.
+ * The GIL is released while waiting and reading.
+ */
+PyObject *
+psutil_linux_taskstats_read(PyObject *self, PyObject *args) {
+    int fd;
+    int family;
+    double timeout;
+    int ret;
+    int len;
+    int overruns = 0;
+    int err = 0;
+    int nrecv;
+    ssize_t nread;
+    char *buf = NULL;
+    size_t count = 0;
+    size_t size = 0;
+    size_t i;
+    unsigned int tgid;
+    struct pollfd pfd;
+    struct nlmsghdr *nlh;
+    struct nlattr *na;
+    struct taskstats *ts;
+    struct taskstats *stats = NULL;
+    PyObject *py_comm = NULL;
+    PyObject *py_tuple = NULL;
+    PyObject *py_retlist = NULL;
+
+    if (!PyArg_ParseTuple(args, "iid", &fd, &family, &timeout))
+        return NULL;
+    // big enough for a full netlink skb
+    buf = malloc(65536);
+    if (buf == NULL)
+        return PyErr_NoMemory();
+
+    Py_BEGIN_ALLOW_THREADS
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    do {
+        ret = poll(&pfd, 1, timeout < 0 ? -1 : (int)(timeout * 1000));
+    } while (ret == -1 && errno == EINTR);
+    if (ret == -1)
+        err = errno;
+
+    for (nrecv = 0; ret > 0 && err == 0 && nrecv < PSUTIL_TS_MAX_RECV;
+            nrecv++) {
+        nread = recv(fd, buf, 65536, MSG_DONTWAIT);
+        if (nread == -1) {
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOBUFS) {
+                overruns++;
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                err = errno;
+            break;
+        }
+        for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, (size_t)nread);
+                nlh = NLMSG_NEXT(nlh, nread)) {
+            if (nlh->nlmsg_type != family)
+                continue;
+            na = PSUTIL_GENLMSG_ATTRS(nlh);
+            len = PSUTIL_GENLMSG_ATTRLEN(nlh);
+            // Skip TASKSTATS_TYPE_AGGR_TGID: it's sent in addition to
+            // AGGR_PID when the last thread of a multi-threaded
+            // process exits, and only carries delay accounting.
+            while (PSUTIL_NLA_OK(na, len)) {
+                if (na->nla_type == TASKSTATS_TYPE_AGGR_PID) {
+                    if (psutil_taskstats_append(na, &stats, &count,
+                                                &size) == -1) {
+                        err = ENOMEM;
+                        break;
+                    }
+                }
+                len -= NLA_ALIGN(na->nla_len);
+                na = PSUTIL_NLA_NEXT(na);
+            }
+        }
+    }
+    Py_END_ALLOW_THREADS
+
+    free(buf);
+    if (err != 0) {
+        errno = err;
+        if (err == ENOMEM)
+            PyErr_NoMemory();
+        else
+            PyErr_SetFromErrno(PyExc_OSError);
+        goto error;
+    }
+
+    py_retlist = PyList_New(0);
+    if (py_retlist == NULL)
+        goto error;
+    for (i = 0; i < count; i++) {
+        ts = &stats[i];
+#if TASKSTATS_VERSION >= 12
+        tgid = ts->ac_tgid;  // 0 if sent by a kernel < 5.17
+#else
+        tgid = 0;
+#endif
+        ts->ac_comm[TS_COMM_LEN - 1] = '\0';
+        py_comm = PyUnicode_DecodeFSDefault(ts->ac_comm);
+        if (! py_comm)
+            goto error;
+        py_tuple = Py_BuildValue(
+            "(IIIIOIKKKKKKKKKKKKKKKK)",
+            ts->ac_pid,
+            tgid,
+            ts->ac_ppid,
+            ts->ac_uid,
+            py_comm,
+            ts->ac_exitcode,
+            (unsigned long long)ts->ac_btime,
+            (unsigned long long)ts->ac_etime,
+            (unsigned long long)ts->ac_utime,
+            (unsigned long long)ts->ac_stime,
+            (unsigned long long)ts->ac_minflt,
+            (unsigned long long)ts->ac_majflt,
+            (unsigned long long)ts->hiwater_rss,
+            (unsigned long long)ts->read_char,
+            (unsigned long long)ts->write_char,
+            (unsigned long long)ts->read_bytes,
+            (unsigned long long)ts->write_bytes,
+            (unsigned long long)ts->nvcsw,
+            (unsigned long long)ts->nivcsw,
+            (unsigned long long)ts->cpu_delay_total,
+            (unsigned long long)ts->blkio_delay_total,
+            (unsigned long long)ts->swapin_delay_total);
+        Py_CLEAR(py_comm);
+        if (! py_tuple)
+            goto error;
+        if (PyList_Append(py_retlist, py_tuple))
+            goto error;
+        Py_CLEAR(py_tuple);
+    }
+    free(stats);
+    return Py_BuildValue("(Ni)", py_retlist, overruns);
+
+error:
+    free(stats);
+    Py_XDECREF(py_comm);
+    Py_XDECREF(py_tuple);
+    Py_XDECREF(py_retlist);
+    return NULL;
+}
@@ -0,0 +1,11 @@
+/*
+ * Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#include <Python.h>
+
+PyObject *psutil_linux_taskstats_close(PyObject *self, PyObject *args);
+PyObject *psutil_linux_taskstats_open(PyObject *self, PyObject *args);
+PyObject *psutil_linux_taskstats_read(PyObject *self, PyObject *args);
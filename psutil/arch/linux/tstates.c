@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+Thread states sampler. Every 1/hz seconds the threads of a process are
+listed from /proc/{pid}/task and, for each thread, these files are read:
+
+- stat: the thread state (R, S, D, ...)
+- wchan: the kernel function the thread is blocked in
+- syscall: the number of the syscall the thread is blocked in, "-1 ..."
+  if it's blocked outside of a syscall or "running"
+
+Files are opened once per thread and read with pread() on every sample
+(wchan and syscall only for threads which are not running). Samples are
+aggregated into a (state, wchan, syscall) -> count histogram, so that
+sampling at 100 Hz costs just a few syscalls per thread and no Python
+objects are created until the end.
+*/
+
+#include <Python.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../../_psutil_common.h"
+#include "tstates.h"
+
+
+// file descriptor of a file which can't be read (e.g. EACCES)
+#define PSUTIL_TS_UNREADABLE -2
+// syscall numbers for threads which are not blocked in a syscall
+#define PSUTIL_TS_RUNNING -2
+#define PSUTIL_TS_UNKNOWN -3
+
+typedef struct {
+    long tid;
+    int stat_fd;
+    int wchan_fd;
+    int syscall_fd;
+    int seen;
+} psutil_ts_thread;
+
+typedef struct {
+    char state;
+    long syscall;
+    char wchan[64];
+    unsigned long count;
+} psutil_ts_bucket;
+
+typedef struct {
+    char *task_path;
+    DIR *dir;
+    psutil_ts_thread *threads;
+    size_t nthreads;
+    size_t threads_size;
+    psutil_ts_bucket *buckets;
+    size_t nbuckets;
+    size_t buckets_size;
+} psutil_ts_sampler;
+
+
+static int
+psutil_ts_thread_cmp(const void *a, const void *b) {
+    long x = ((const psutil_ts_thread *)a)->tid;
+    long y = ((const psutil_ts_thread *)b)->tid;
+    return (x > y) - (x < y);
+}
+
+
+static void
+psutil_ts_close(int *fd) {
+    if (*fd >= 0)
+        close(*fd);
+    *fd = -1;
+}
+
+
+static void
+psutil_ts_thread_close(psutil_ts_thread *thread) {
+    psutil_ts_close(&thread->stat_fd);
+    psutil_ts_close(&thread->wchan_fd);
+    psutil_ts_close(&thread->syscall_fd);
+}
+
+
+/*
+ * Read /proc/{pid}/task/{tid}/{name} into buf (NUL terminated), opening
+ * it first if needed. Return the number of bytes read or -1 on error.
+ */
+static ssize_t
+psutil_ts_read(psutil_ts_sampler *s, long tid, const char *name, int *fd,
+               char *buf, size_t bufsize) {
+    char path[PATH_MAX];
+    ssize_t ret;
+
+    if (*fd == PSUTIL_TS_UNREADABLE)
+        return -1;
+    if (*fd == -1) {
+        snprintf(path, sizeof(path), "%s/%ld/%s", s->task_path, tid, name);
+        *fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (*fd == -1) {
+            if (errno == EACCES || errno == EPERM)
+                *fd = PSUTIL_TS_UNREADABLE;
+            return -1;
+        }
+    }
+    do {
+        ret = pread(*fd, buf, bufsize - 1, 0);
+    } while (ret == -1 && errno == EINTR);
+    if (ret == -1) {
+        if (errno == EACCES || errno == EPERM) {
+            psutil_ts_close(fd);
+            *fd = PSUTIL_TS_UNREADABLE;
+        }
+        return -1;
+    }
+    buf[ret] = '\0';
+    return ret;
+}
+
+
+/*
+ * Update the threads table from the task directory: add the new threads
+ * and drop the ones which are gone. Return -1 on error.
+ */
+static int
+psutil_ts_scan(psutil_ts_sampler *s) {
+    struct dirent *entry;
+    psutil_ts_thread key;
+    psutil_ts_thread *thread;
+    psutil_ts_thread *newthreads;
+    size_t nold = s->nthreads;
+    size_t i;
+    size_t j;
+    char *end;
+    int sort = 0;
+
+    for (i = 0; i < s->nthreads; i++)
+        s->threads[i].seen = 0;
+
+    rewinddir(s->dir);
+    errno = 0;
+    while ((entry = readdir(s->dir)) != NULL) {
+        key.tid = strtol(entry->d_name, &end, 10);
+        if (*end != '\0' || key.tid <= 0)
+            continue;
+        thread = bsearch(&key, s->threads, nold, sizeof(psutil_ts_thread),
+                         psutil_ts_thread_cmp);
+        if (thread != NULL) {
+            thread->seen = 1;
+            continue;
+        }
+        if (s->nthreads == s->threads_size) {
+            newthreads = realloc(
+                s->threads,
+                (s->threads_size * 2 + 16) * sizeof(psutil_ts_thread));
+            if (newthreads == NULL) {
+                errno = ENOMEM;
+                return -1;
+            }
+            s->threads = newthreads;
+            s->threads_size = s->threads_size * 2 + 16;
+        }
+        thread = &s->threads[s->nthreads++];
+        thread->tid = key.tid;
+        thread->stat_fd = -1;
+        thread->wchan_fd = -1;
+        thread->syscall_fd = -1;
+        thread->seen = 1;
+        sort = 1;
+    }
+    if (errno != 0)
+        return -1;
+
+    // drop the threads which are gone
+    for (i = 0, j = 0; i < s->nthreads; i++) {
+        if (s->threads[i].seen)
+            s->threads[j++] = s->threads[i];
+        else
+            psutil_ts_thread_close(&s->threads[i]);
+    }
+    s->nthreads = j;
+    if (sort) {
+        qsort(s->threads, s->nthreads, sizeof(psutil_ts_thread),
+              psutil_ts_thread_cmp);
+    }
+    return 0;
+}
+
+
+static int
+psutil_ts_count(psutil_ts_sampler *s, char state, const char *wchan,
+                long syscall) {
+    size_t i;
+    psutil_ts_bucket *bucket;
+    psutil_ts_bucket *newbuckets;
+
+    // there are usually only a few distinct buckets
+    for (i = 0; i < s->nbuckets; i++) {
+        bucket = &s->buckets[i];
+        if (bucket->state == state && bucket->syscall == syscall &&
+                strcmp(bucket->wchan, wchan) == 0) {
+            bucket->count++;
+            return 0;
+        }
+    }
+    if (s->nbuckets == s->buckets_size) {
+        newbuckets = realloc(
+            s->buckets, (s->buckets_size * 2 + 16) * sizeof(psutil_ts_bucket));
+        if (newbuckets == NULL) {
+            errno = ENOMEM;
+            return -1;
+        }
+        s->buckets = newbuckets;
+        s->buckets_size = s->buckets_size * 2 + 16;
+    }
+    bucket = &s->buckets[s->nbuckets++];
+    bucket->state = state;
+    bucket->syscall = syscall;
+    snprintf(bucket->wchan, sizeof(bucket->wchan), "%s", wchan);
+    bucket->count = 1;
+    return 0;
+}
+
+
+/*
+ * Take one sample of all the threads. Return the number of threads
+ * sampled or -1 on error.
+ */
+static long
+psutil_ts_sample(psutil_ts_sampler *s) {
+    psutil_ts_thread *thread;
+    char buf[1024];
+    char wchan[64];
+    char state;
+    char *p;
+    long syscall;
+    long sampled = 0;
+    size_t i;
+
+    if (psutil_ts_scan(s) != 0)
+        return -1;
+
+    for (i = 0; i < s->nthreads; i++) {
+        thread = &s->threads[i];
+        if (psutil_ts_read(s, thread->tid, "stat", &thread->stat_fd, buf,
+                           sizeof(buf)) == -1)
+            continue;  // thread gone
+        // the state comes after the name, which may contain ")"
+        p = strrchr(buf, ')');
+        if (p == NULL || p[1] == '\0' || p[2] == '\0')
+            continue;
+        state = p[2];
+
+        wchan[0] = '\0';
+        syscall = PSUTIL_TS_RUNNING;
+        if (state != 'R') {
+            // "0" means the thread is not blocked
+            if (psutil_ts_read(s, thread->tid, "wchan", &thread->wchan_fd,
+                               wchan, sizeof(wchan)) == -1 ||
+                    strcmp(wchan, "0") == 0)
+                wchan[0] = '\0';
+            if (psutil_ts_read(s, thread->tid, "syscall",
+                               &thread->syscall_fd, buf, sizeof(buf)) == -1)
+                syscall = PSUTIL_TS_UNKNOWN;
+            else if (strncmp(buf, "running", 7) == 0)
+                syscall = PSUTIL_TS_RUNNING;
+            else if (sscanf(buf, "%ld", &syscall) != 1)
+                syscall = PSUTIL_TS_UNKNOWN;
+        }
+        if (psutil_ts_count(s, state, wchan, syscall) != 0)
+            return -1;
+        sampled++;
+    }
+    return sampled;
+}
+
+
+static void
+psutil_ts_timespec_add(struct timespec *ts, double secs) {
+    long nsecs = (long)((secs - (long)secs) * 1e9);
+
+    ts->tv_sec += (time_t)secs;
+    ts->tv_nsec += nsecs;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+
+/*
+ * Sample the state of the threads listed in task_path (e.g.
+ * /proc/{pid}/task) nsamples times every interval seconds, and return
+ * a (samples, [(state, wchan, syscall, count), ...]) tuple where samples
+ * is the number of samples actually taken (less than nsamples if the
+ * process went away). syscall is -1 if the thread is blocked outside
+ * of a syscall, -2 if it's running and -3 if it can't be determined.
+ * The GIL is released while sampling.
+ */
+PyObject *
+psutil_linux_sample_thread_states(PyObject *self, PyObject *args) {
+    char *task_path;
+    long nsamples;
+    double interval;
+    long i;
+    long taken = 0;
+    long sampled = 0;
+    int ret;
+    size_t j;
+    struct timespec deadline;
+    psutil_ts_sampler s;
+    psutil_ts_bucket *bucket;
+    PyObject *py_tuple = NULL;
+    PyObject *py_retlist = NULL;
+
+    if (!PyArg_ParseTuple(args, "sld", &task_path, &nsamples, &interval))
+        return NULL;
+
+    memset(&s, 0, sizeof(s));
+    s.task_path = task_path;
+    s.dir = opendir(task_path);
+    if (s.dir == NULL) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, task_path);
+        return NULL;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    for (i = 0; i < nsamples; i++) {
+        Py_BEGIN_ALLOW_THREADS
+        if (i > 0) {
+            // sleep until an absolute deadline so that the time spent
+            // sampling doesn't skew the rate
+            psutil_ts_timespec_add(&deadline, interval);
+            do {
+                ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                                      &deadline, NULL);
+            } while (ret == EINTR);
+        }
+        sampled = psutil_ts_sample(&s);
+        Py_END_ALLOW_THREADS
+        if (sampled == -1) {
+            if (errno == ENOMEM)
+                PyErr_NoMemory();
+            else
+                PyErr_SetFromErrnoWithFilename(PyExc_OSError, task_path);
+            goto error;
+        }
+        if (sampled == 0)
+            break;  // process is gone
+        taken++;
+        // allow KeyboardInterrupt while sampling for a long time
+        if (PyErr_CheckSignals() != 0)
+            goto error;
+    }
+
+    py_retlist = PyList_New(0);
+    if (py_retlist == NULL)
+        goto error;
+    for (j = 0; j < s.nbuckets; j++) {
+        bucket = &s.buckets[j];
+        py_tuple = Py_BuildValue(
+            "(islk)", (int)bucket->state, bucket->wchan, bucket->syscall,
+            bucket->count);
+        if (! py_tuple)
+            goto error;
+        if (PyList_Append(py_retlist, py_tuple))
+            goto error;
+        Py_CLEAR(py_tuple);
+    }
+
+    for (j = 0; j < s.nthreads; j++)
+        psutil_ts_thread_close(&s.threads[j]);
+    closedir(s.dir);
+    free(s.threads);
+    free(s.buckets);
+    return Py_BuildValue("(lN)", taken, py_retlist);
+
+error:
+    for (j = 0; j < s.nthreads; j++)
+        psutil_ts_thread_close(&s.threads[j]);
+    closedir(s.dir);
+    free(s.threads);
+    free(s.buckets);
+    Py_XDECREF(py_tuple);
+    Py_XDECREF(py_retlist);
+    return NULL;
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+/*
+Parsers for /proc/vmstat, which has ~200 "name value" lines (more with
+every kernel release).
+
+The line order only changes across kernel versions, so callers
+interested in a few counters look up their line numbers ("slots")
+once, then on each sample only those lines are converted, after
+checking their names still match.
+*/
+
+#include <Python.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../_psutil_common.h"
+#include "vmstat.h"
+
+
+/*
+ * Read a whole file into a NUL terminated malloc()ed buffer. Return
+ * NULL and set errno on error.
+ */
+static char *
+psutil_vmstat_read(const char *path) {
+    int fd;
+    size_t len = 0;
+    size_t size = 8192;
+    ssize_t nread;
+    char *buf;
+    char *newbuf;
+    int err;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return NULL;
+    buf = malloc(size);
+    if (buf == NULL) {
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    while (1) {
+        if (len == size - 1) {
+            newbuf = realloc(buf, size * 2);
+            if (newbuf == NULL) {
+                err = ENOMEM;
+                goto error;
+            }
+            buf = newbuf;
+            size *= 2;
+        }
+        nread = read(fd, buf + len, size - 1 - len);
+        if (nread == -1) {
+            if (errno == EINTR)
+                continue;
+            err = errno;
+            goto error;
+        }
+        if (nread == 0)
+            break;
+        len += (size_t)nread;
+    }
+    close(fd);
+    buf[len] = '\0';
+    return buf;
+
+error:
+    free(buf);
+    close(fd);
+    errno = err;
+    return NULL;
+}
+
+
+static PyObject *
+psutil_vmstat_error(const char *path) {
+    if (errno == ENOMEM)
+        return PyErr_NoMemory();
+    return PyErr_SetFromErrnoWithFilename(PyExc_OSError, path);
+}
+
+
+/*
+ * Parse /proc/vmstat and return a list of (name, value) tuples in
+ * file order.
+ */
+PyObject *
+psutil_linux_vmstat(PyObject *self, PyObject *args) {
+    char *path;
+    char *buf;
+    char *line;
+    char *next;
+    char *sep;
+    unsigned long long value;
+    PyObject *py_tuple = NULL;
+    PyObject *py_retlist = NULL;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+        return NULL;
+    buf = psutil_vmstat_read(path);
+    if (buf == NULL)
+        return psutil_vmstat_error(path);
+    py_retlist = PyList_New(0);
+    if (py_retlist == NULL)
+        goto error;
+
+    for (line = buf; *line != '\0'; line = next) {
+        next = strchr(line, '\n');
+        if (next == NULL)
+            next = line + strlen(line);
+        else
+            *next++ = '\0';
+        sep = strchr(line, ' ');
+        if (sep == NULL)
+            continue;
+        *sep = '\0';
+        value = strtoull(sep + 1, NULL, 10);
+        py_tuple = Py_BuildValue("(sK)", line, value);
+        if (! py_tuple)
+            goto error;
+        if (PyList_Append(py_retlist, py_tuple))
+            goto error;
+        Py_CLEAR(py_tuple);
+    }
+
+    free(buf);
+    return py_retlist;
+
+error:
+    free(buf);
+    Py_XDECREF(py_tuple);
+    Py_XDECREF(py_retlist);
+    return NULL;
+}
+
+
+/*
+ * Takes a sequence of (line_number, name) slots and return a list with
+ * the value of each slot, or None if the line doesn't exist or its name
+ * doesn't match (the caller is supposed to look up the slots again).
+ */
+PyObject *
+psutil_linux_vmstat_slots(PyObject *self, PyObject *args) {
+    char *path;
+    char *buf = NULL;
+    char *p;
+    char **lines = NULL;
+    char **newlines;
+    char *name;
+    size_t nlines = 0;
+    size_t size = 0;
+    size_t namelen;
+    long lineno;
+    Py_ssize_t i;
+    Py_ssize_t nslots;
+    PyObject *py_slots;
+    PyObject *py_seq = NULL;
+    PyObject *py_value;
+    PyObject *py_retlist = NULL;
+
+    if (!PyArg_ParseTuple(args, "sO", &path, &py_slots))
+        return NULL;
+    py_seq = PySequence_Fast(py_slots, "slots must be a sequence");
+    if (py_seq == NULL)
+        return NULL;
+    buf = psutil_vmstat_read(path);
+    if (buf == NULL) {
+        psutil_vmstat_error(path);
+        goto error;
+    }
+
+    // index the start of each line
+    for (p = buf; *p != '\0'; ) {
+        if (nlines == size) {
+            newlines = realloc(lines, (size * 2 + 256) * sizeof(char *));
+            if (newlines == NULL) {
+                PyErr_NoMemory();
+                goto error;
+            }
+            lines = newlines;
+            size = size * 2 + 256;
+        }
+        lines[nlines++] = p;
+        p = strchr(p, '\n');
+        if (p == NULL)
+            break;
+        p++;
+    }
+
+    nslots = PySequence_Fast_GET_SIZE(py_seq);
+    py_retlist = PyList_New(nslots);
+    if (py_retlist == NULL)
+        goto error;
+    for (i = 0; i < nslots; i++) {
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(py_seq, i), "ls",
+                              &lineno, &name))
+            goto error;
+        namelen = strlen(name);
+        if (lineno >= 0 && (size_t)lineno < nlines &&
+                strncmp(lines[lineno], name, namelen) == 0 &&
+                lines[lineno][namelen] == ' ') {
+            py_value = PyLong_FromUnsignedLongLong(
+                strtoull(lines[lineno] + namelen + 1, NULL, 10));
+            if (py_value == NULL)
+                goto error;
+        }
+        else {
+            Py_INCREF(Py_None);
+            py_value = Py_None;
+        }
+        PyList_SET_ITEM(py_retlist, i, py_value);
+    }
+
+    free(lines);
+    free(buf);
+    Py_DECREF(py_seq);
+    return py_retlist;
+
+error:
+    free(lines);
+    free(buf);
+    Py_XDECREF(py_seq);
+    Py_XDECREF(py_retlist);
+    return NULL;
+}
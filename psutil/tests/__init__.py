@@ -35,10 +35,17 @@ import threading
 import time
 import unittest
 import warnings
+from collections import namedtuple
 from socket import AF_INET
 from socket import AF_INET6
 from socket import SOCK_STREAM
 
+
+try:
+    import tracemalloc
+except ImportError:
+    tracemalloc = None  # Python 2
+
 import psutil
 from psutil import AIX
 from psutil import LINUX
@@ -82,8 +89,13 @@ __all__ = [
     'PYPY', 'PYTHON_EXE', 'PYTHON_EXE_ENV', 'ROOT_DIR', 'SCRIPTS_DIR',
     'TESTFN_PREFIX', 'UNICODE_SUFFIX', 'INVALID_UNICODE_SUFFIX',
     'CI_TESTING', 'VALID_PROC_STATUSES', 'TOLERANCE_DISK_USAGE', 'IS_64BIT',
-    "HAS_CPU_AFFINITY", "HAS_CPU_FREQ", "HAS_ENVIRON", "HAS_PROC_IO_COUNTERS",
-    "HAS_IONICE", "HAS_MEMORY_MAPS", "HAS_PROC_CPU_NUM", "HAS_RLIMIT",
+    "HAS_CPU_AFFINITY", "HAS_CPU_AFFINITY_MASK", "HAS_CPU_AFFINITY_HISTOGRAM",
+    "HAS_CPU_FREQ", "HAS_DISK_MOUNT_DISKS", "HAS_ENVIRON",
+    "HAS_PROC_IO_COUNTERS", "HAS_PROC_SAMPLE_THREAD_STATES",
+    "HAS_PROC_WORKING_SET",
+    "HAS_IONICE", "HAS_KERNEL_MEMORY", "HAS_MEMORY_INFO_STATUS",
+    "HAS_MEMORY_MAPS", "HAS_PID_NAMESPACE_MAP", "HAS_PROC_NS_PIDS",
+    "HAS_PROC_CPU_NUM", "HAS_RLIMIT",
     "HAS_SENSORS_BATTERY", "HAS_BATTERY", "HAS_SENSORS_FANS",
     "HAS_SENSORS_TEMPERATURES", "MACOS_11PLUS",
     "MACOS_12PLUS", "COVERAGE",
@@ -204,14 +216,24 @@ HERE = os.path.realpath(os.path.dirname(__file__))
 
 HAS_CONNECTIONS_UNIX = POSIX and not SUNOS
 HAS_CPU_AFFINITY = hasattr(psutil.Process, "cpu_affinity")
+HAS_CPU_AFFINITY_HISTOGRAM = hasattr(psutil, "cpu_affinity_histogram")
+HAS_DISK_MOUNT_DISKS = hasattr(psutil, "disk_mount_disks")
+HAS_CPU_AFFINITY_MASK = hasattr(psutil.Process, "cpu_affinity_mask")
 HAS_CPU_FREQ = hasattr(psutil, "cpu_freq")
 HAS_GETLOADAVG = hasattr(psutil, "getloadavg")
 HAS_ENVIRON = hasattr(psutil.Process, "environ")
 HAS_IONICE = hasattr(psutil.Process, "ionice")
+HAS_KERNEL_MEMORY = hasattr(psutil, "kernel_memory")
+HAS_MEMORY_INFO_STATUS = hasattr(psutil.Process, "memory_info_status")
 HAS_MEMORY_MAPS = hasattr(psutil.Process, "memory_maps")
 HAS_NET_IO_COUNTERS = hasattr(psutil, "net_io_counters")
 HAS_PROC_CPU_NUM = hasattr(psutil.Process, "cpu_num")
+HAS_PID_NAMESPACE_MAP = hasattr(psutil, "pid_namespace_map")
 HAS_PROC_IO_COUNTERS = hasattr(psutil.Process, "io_counters")
+HAS_PROC_NS_PIDS = hasattr(psutil.Process, "ns_pids")
+HAS_PROC_SAMPLE_THREAD_STATES = hasattr(psutil.Process,
+                                        "sample_thread_states")
+HAS_PROC_WORKING_SET = hasattr(psutil.Process, "working_set")
 HAS_RLIMIT = hasattr(psutil.Process, "rlimit")
 HAS_SENSORS_BATTERY = hasattr(psutil, "sensors_battery")
 try:
@@ -958,6 +980,12 @@ class PsutilTestCase(TestCase):
         self.assertNotIn(proc.pid, psutil.pids())
 
 
+# TestMemoryLeak._get_alloc_stats(); blocks and objects are per-call
+# averages of allocations (including transient ones), peak is in bytes
+_alloc_stats = namedtuple('alloc_stats', ['calls', 'blocks', 'objects',
+                                          'peak', 'fds'])
+
+
 @unittest.skipIf(PYPY, "unreliable on PYPY")
 class TestMemoryLeak(PsutilTestCase):
     """Test framework class for detecting function memory leaks,
@@ -982,6 +1010,15 @@ class TestMemoryLeak(PsutilTestCase):
     PyPy appears to be completely unstable for this framework, probably
     because of its JIT, so tests on PYPY are skipped.
 
+    Memory which is allocated and freed on every call does not show up
+    as a leak, but it's what makes hot loops slow. If `alloc_stats` is
+    set to a list, execute() also traces the function and appends a
+    `(test_id, alloc_stats)` tuple to it, reporting per-call averages of
+    memory blocks and GC-tracked objects allocated (freed or not), the
+    peak transient memory allocated by a single call (via tracemalloc)
+    and the number of unclosed fds / handles (see
+    scripts/internal/print_alloc_budget.py).
+
     Usage:
 
         class TestLeaks(psutil.tests.TestMemoryLeak):
@@ -995,6 +1032,7 @@ class TestMemoryLeak(PsutilTestCase):
     tolerance = 0  # memory
     retries = 10 if CI_TESTING else 5
     verbose = True
+    alloc_stats = None
     _thisproc = psutil.Process()
     _psutil_debug_orig = bool(os.getenv('PSUTIL_DEBUG'))
 
@@ -1078,6 +1116,97 @@ class TestMemoryLeak(PsutilTestCase):
                 prev_mem = mem
         raise self.fail(". ".join(messages))
 
+    def _count_allocs(self, fun, times):
+        """Call fun repeatedly and return the number of memory blocks
+        and GC-tracked objects it allocated, including the ones freed
+        before returning. Both counters are net (they also decrease on
+        free), so they are sampled on every bytecode executed (every
+        line on Python < 3.7) and every C function call / return,
+        summing the increases. Allocations and frees happening within
+        a single C call are not seen, and neither are objects reused
+        from free lists (e.g. lists, floats) for the objects count.
+        """
+        counts = [0, 0]
+        last = [0, 0]
+
+        def sample(frame=None, event=None, arg=None):
+            blocks = sys.getallocatedblocks()
+            objects = gc.get_count()[0]
+            if blocks > last[0]:
+                counts[0] += blocks - last[0]
+            if objects > last[1]:
+                counts[1] += objects - last[1]
+            last[0] = blocks
+            last[1] = objects
+            if event == "call" and hasattr(frame, "f_trace_opcodes"):
+                frame.f_trace_opcodes = True
+            return sample  # also trace nested frames
+
+        gc_enabled = gc.isenabled()
+        old_trace = sys.gettrace()
+        old_profile = sys.getprofile()
+        gc.collect()
+        gc.disable()  # a collection would reset gc.get_count()
+        sample()
+        counts[:] = [0, 0]
+        try:
+            for x in range(times):
+                sample()
+                sys.settrace(sample)
+                sys.setprofile(sample)
+                try:
+                    self.call(fun)
+                finally:
+                    sys.setprofile(old_profile)
+                    sys.settrace(old_trace)
+                sample()
+                del x
+        finally:
+            if gc_enabled:
+                gc.enable()
+        return counts
+
+    def _get_alloc_stats(self, fun, times):
+        """Call fun repeatedly and return an `alloc_stats` namedtuple,
+        or None if tracemalloc is not available (Python 2).
+        """
+        if tracemalloc is None:
+            return None
+        blocks, objects = self._count_allocs(fun, times)
+        # subtract what the sampling itself allocates
+        noise = self._count_allocs(lambda: None, times)
+        blocks = max(blocks - noise[0], 0)
+        objects = max(objects - noise[1], 0)
+        # reset_peak() is Python >= 3.9; before that the peak is
+        # measured across all calls.
+        reset_peak = getattr(tracemalloc, "reset_peak", lambda: None)
+        was_tracing = tracemalloc.is_tracing()
+        if not was_tracing:
+            tracemalloc.start()
+        try:
+            gc.collect()
+            fds1 = self._get_num_fds()
+            base = tracemalloc.get_traced_memory()[0]
+            peak = 0
+            for x in range(times):
+                reset_peak()
+                curr = tracemalloc.get_traced_memory()[0]
+                ret = self.call(fun)
+                peak = max(peak, tracemalloc.get_traced_memory()[1] -
+                           max(curr, base))
+                del x, ret
+            gc.collect()
+            fds2 = self._get_num_fds()
+        finally:
+            if not was_tracing:
+                tracemalloc.stop()
+        return _alloc_stats(
+            calls=times,
+            blocks=blocks / times,
+            objects=objects / times,
+            peak=peak,
+            fds=fds2 - fds1)
+
     # ---
 
     def call(self, fun):
@@ -1102,6 +1231,10 @@ class TestMemoryLeak(PsutilTestCase):
         self._call_ntimes(fun, warmup_times)  # warm up
         self._check_fds(fun)
         self._check_mem(fun, times=times, retries=retries, tolerance=tolerance)
+        if self.alloc_stats is not None:
+            stats = self._get_alloc_stats(fun, times)
+            if stats is not None:
+                self.alloc_stats.append((self.id(), stats))
 
     def execute_w_exc(self, exc, fun, **kwargs):
         """Convenience method to test a callable while making sure it
@@ -1237,6 +1370,13 @@ class process_namespace:
         ('pid', (), {}),
         ('wait', (0, ), {}),
     ]
+    if HAS_PROC_WORKING_SET:
+        # blocks, and resets the referenced / idle state of all the
+        # process pages
+        ignored += [('working_set', (0, ), {})]
+    if HAS_PROC_SAMPLE_THREAD_STATES:
+        # blocks
+        ignored += [('sample_thread_states', (), {'duration': 0})]
 
     getters = [
         ('cmdline', (), {}),
@@ -1270,6 +1410,8 @@ class process_namespace:
         getters += [('rlimit', (psutil.RLIMIT_NOFILE, ), {})]
     if HAS_CPU_AFFINITY:
         getters += [('cpu_affinity', (), {})]
+    if HAS_CPU_AFFINITY_MASK:
+        getters += [('cpu_affinity_mask', (), {})]
     if HAS_PROC_CPU_NUM:
         getters += [('cpu_num', (), {})]
     if HAS_ENVIRON:
@@ -1278,6 +1420,10 @@ class process_namespace:
         getters += [('num_handles', (), {})]
     if HAS_MEMORY_MAPS:
         getters += [('memory_maps', (), {'grouped': False})]
+    if HAS_MEMORY_INFO_STATUS:
+        getters += [('memory_info_status', (), {})]
+    if HAS_PROC_NS_PIDS:
+        getters += [('ns_pids', (), {})]
 
     setters = []
     if POSIX:
@@ -1379,8 +1525,16 @@ class system_namespace:
     ]
     if HAS_CPU_FREQ:
         getters += [('cpu_freq', (), {'percpu': True})]
+    if HAS_CPU_AFFINITY_HISTOGRAM:
+        getters += [('cpu_affinity_histogram', (), {})]
+    if HAS_DISK_MOUNT_DISKS:
+        getters += [('disk_mount_disks', (), {'all': True})]
     if HAS_GETLOADAVG:
         getters += [('getloadavg', (), {})]
+    if HAS_KERNEL_MEMORY:
+        getters += [('kernel_memory', (), {})]
+    if HAS_PID_NAMESPACE_MAP:
+        getters += [('pid_namespace_map', (), {})]
     if HAS_SENSORS_TEMPERATURES:
         getters += [('sensors_temperatures', (), {})]
     if HAS_SENSORS_FANS:
@@ -40,7 +40,10 @@ from psutil.tests import APPVEYOR
 from psutil.tests import CI_TESTING
 from psutil.tests import GITHUB_ACTIONS
 from psutil.tests import HAS_CPU_FREQ
+from psutil.tests import HAS_DISK_MOUNT_DISKS
+from psutil.tests import HAS_KERNEL_MEMORY
 from psutil.tests import HAS_NET_IO_COUNTERS
+from psutil.tests import HAS_PID_NAMESPACE_MAP
 from psutil.tests import HAS_SENSORS_FANS
 from psutil.tests import HAS_SENSORS_TEMPERATURES
 from psutil.tests import PYPY
@@ -138,6 +141,42 @@ class TestAvailSystemAPIs(PsutilTestCase):
         self.assertEqual(hasattr(psutil, "cpu_freq"),
                          LINUX or MACOS or WINDOWS or FREEBSD or OPENBSD)
 
+    def test_cpu_affinity_histogram(self):
+        self.assertEqual(hasattr(psutil, "cpu_affinity_histogram"), LINUX)
+
+    def test_disk_mount_disks(self):
+        self.assertEqual(hasattr(psutil, "disk_mount_disks"), LINUX)
+
+    def test_kernel_memory(self):
+        self.assertEqual(hasattr(psutil, "kernel_memory"), LINUX)
+
+    def test_vm_events(self):
+        self.assertEqual(hasattr(psutil, "vm_events"), LINUX)
+        self.assertEqual(hasattr(psutil, "VmEventsSampler"), LINUX)
+
+    def test_working_set_many(self):
+        self.assertEqual(hasattr(psutil, "working_set_many"), LINUX)
+
+    def test_pid_namespace_map(self):
+        self.assertEqual(hasattr(psutil, "pid_namespace_map"), LINUX)
+
+    def test_port_owners(self):
+        self.assertEqual(hasattr(psutil, "port_owners"), LINUX)
+
+    def test_file_users(self):
+        self.assertEqual(hasattr(psutil, "file_users"), LINUX)
+
+    def test_cpu_sched_stats(self):
+        self.assertEqual(hasattr(psutil, "cpu_sched_stats"), LINUX)
+        self.assertEqual(hasattr(psutil, "cpu_sched_stats_rate"), LINUX)
+
+    def test_cpu_power_states(self):
+        self.assertEqual(hasattr(psutil, "cpu_power_states"), LINUX)
+        self.assertEqual(hasattr(psutil, "cpu_power_states_percent"), LINUX)
+
+    def test_exit_accountant(self):
+        self.assertEqual(hasattr(psutil, "ExitAccountant"), LINUX)
+
     def test_sensors_temperatures(self):
         self.assertEqual(
             hasattr(psutil, "sensors_temperatures"), LINUX or FREEBSD)
@@ -188,6 +227,9 @@ class TestAvailProcessAPIs(PsutilTestCase):
         self.assertEqual(hasattr(psutil.Process, "cpu_affinity"),
                          LINUX or WINDOWS or FREEBSD)
 
+    def test_cpu_affinity_mask(self):
+        self.assertEqual(hasattr(psutil.Process, "cpu_affinity_mask"), LINUX)
+
     def test_cpu_num(self):
         self.assertEqual(hasattr(psutil.Process, "cpu_num"),
                          LINUX or FREEBSD or SUNOS)
@@ -197,6 +239,19 @@ class TestAvailProcessAPIs(PsutilTestCase):
         self.assertEqual(
             hasit, False if OPENBSD or NETBSD or AIX or MACOS else True)
 
+    def test_working_set(self):
+        self.assertEqual(hasattr(psutil.Process, "working_set"), LINUX)
+
+    def test_memory_info_status(self):
+        self.assertEqual(hasattr(psutil.Process, "memory_info_status"), LINUX)
+
+    def test_sample_thread_states(self):
+        self.assertEqual(hasattr(psutil.Process, "sample_thread_states"),
+                         LINUX)
+
+    def test_ns_pids(self):
+        self.assertEqual(hasattr(psutil.Process, "ns_pids"), LINUX)
+
 
 # ===================================================================
 # --- API types
@@ -251,6 +306,58 @@ class TestSystemAPITypes(PsutilTestCase):
             self.assertIsInstance(k, str)
             self.assert_ntuple_of_nums(v, type_=(int, long))
 
+    @unittest.skipIf(not HAS_DISK_MOUNT_DISKS, "not supported")
+    def test_disk_mount_disks(self):
+        for mountpoint, disks in psutil.disk_mount_disks(all=True).items():
+            self.assertIsInstance(mountpoint, str)
+            self.assertIsInstance(disks, list)
+            for disk in disks:
+                self.assertIsInstance(disk, str)
+
+    @unittest.skipIf(not HAS_KERNEL_MEMORY, "not supported")
+    def test_kernel_memory(self):
+        ret = psutil.kernel_memory()
+        assert is_namedtuple(ret)
+        for field in ('slab', 'vmalloc'):
+            value = getattr(ret, field)
+            self.assertIsInstance(value, (list, type(None)))
+            for entry in value or []:
+                assert is_namedtuple(entry)
+                self.assertIsInstance(entry[0], str)
+                for n in entry[1:]:
+                    self.assertIsInstance(n, (int, long))
+                    self.assertGreaterEqual(n, 0)
+        for size, pool in ret.hugepages.items():
+            self.assertIsInstance(size, (int, long))
+            self.assert_ntuple_of_nums(pool, type_=(int, long))
+        for name, value in ret.thp.items():
+            self.assertIsInstance(name, str)
+            self.assertIsInstance(value, (int, long))
+        for name, dev in ret.zram.items():
+            self.assertIsInstance(name, str)
+            self.assert_ntuple_of_nums(dev, type_=(int, long))
+        if ret.zswap is not None:
+            self.assert_ntuple_of_nums(ret.zswap, type_=(int, long))
+
+    @unittest.skipIf(not LINUX, "LINUX only")
+    def test_vm_events(self):
+        for name, value in psutil.vm_events().items():
+            self.assertIsInstance(name, str)
+            self.assertIsInstance(value, (int, long))
+            self.assertGreaterEqual(value, 0)
+        for name, value in psutil.VmEventsSampler().rates().items():
+            self.assertIsInstance(name, str)
+            self.assertIsInstance(value, float)
+
+    @unittest.skipIf(not HAS_PID_NAMESPACE_MAP, "not supported")
+    def test_pid_namespace_map(self):
+        for (pidns, ns_pid), pid in psutil.pid_namespace_map().items():
+            self.assertIsInstance(pidns, (int, long))
+            self.assertIsInstance(ns_pid, int)
+            self.assertIsInstance(pid, int)
+            self.assertGreater(ns_pid, 0)
+            self.assertGreater(pid, 0)
+
     def test_disk_partitions(self):
         # Duplicate of test_system.py. Keep it anyway.
         for disk in psutil.disk_partitions():
@@ -614,6 +721,23 @@ class TestFetchAllProcesses(PsutilTestCase):
         if LINUX:
             self.assertGreaterEqual(ret.pss, ret.uss)
 
+    def memory_info_status(self, ret, info):
+        assert is_namedtuple(ret)
+        total = psutil.virtual_memory().total
+        for name in ret._fields:
+            value = getattr(ret, name)
+            self.assertIsInstance(value, (int, long))
+            self.assertGreaterEqual(value, 0, msg=(name, value))
+            self.assertLessEqual(value, total, msg=(name, value, total))
+
+    def ns_pids(self, ret, info):
+        self.assertIsInstance(ret, list)
+        self.assertGreaterEqual(len(ret), 1)
+        self.assertEqual(ret[0], info['pid'])
+        for pid in ret:
+            self.assertIsInstance(pid, int)
+            self.assertGreaterEqual(pid, 0)
+
     def open_files(self, ret, info):
         self.assertIsInstance(ret, list)
         for f in ret:
@@ -683,6 +807,14 @@ class TestFetchAllProcesses(PsutilTestCase):
             self.assertIsInstance(n, int)
             self.assertIn(n, cpus)
 
+    def cpu_affinity_mask(self, ret, info):
+        self.assertIsInstance(ret, (int, long))
+        assert ret > 0, ret
+        # CPU ids may not be contiguous, so cpu_count() is not a bound
+        with open("/sys/devices/system/cpu/possible") as f:
+            cpus = psutil._psplatform._parse_cpu_list(f.read().strip())
+        assert ret < 2 ** (max(cpus) + 1), ret
+
     def terminal(self, ret, info):
         self.assertIsInstance(ret, (str, type(None)))
         if ret is not None:
@@ -8,17 +8,22 @@
 
 from __future__ import division
 
+import array
 import collections
 import contextlib
 import errno
 import glob
 import io
+import mmap
 import os
 import re
 import shutil
+import signal
 import socket
+import stat
 import struct
 import textwrap
+import threading
 import time
 import unittest
 import warnings
@@ -27,6 +32,7 @@ import psutil
 from psutil import LINUX
 from psutil._compat import PY3
 from psutil._compat import FileNotFoundError
+from psutil._compat import PermissionError
 from psutil._compat import basestring
 from psutil._compat import u
 from psutil.tests import GITHUB_ACTIONS
@@ -36,8 +42,11 @@ from psutil.tests import HAS_CPU_FREQ
 from psutil.tests import HAS_GETLOADAVG
 from psutil.tests import HAS_RLIMIT
 from psutil.tests import PYPY
+from psutil.tests import PYTHON_EXE
+from psutil.tests import PYTHON_EXE_ENV
 from psutil.tests import TOLERANCE_DISK_USAGE
 from psutil.tests import TOLERANCE_SYS_MEM
+from psutil.tests import VALID_PROC_STATUSES
 from psutil.tests import PsutilTestCase
 from psutil.tests import ThreadTask
 from psutil.tests import call_until
@@ -47,10 +56,13 @@ from psutil.tests import retry_on_failure
 from psutil.tests import safe_rmpath
 from psutil.tests import sh
 from psutil.tests import skip_on_not_implemented
+from psutil.tests import spawn_testproc
+from psutil.tests import terminate
 from psutil.tests import which
 
 
 if LINUX:
+    from psutil._pslinux import BlockTopology
     from psutil._pslinux import CLOCK_TICKS
     from psutil._pslinux import RootFsDeviceFinder
     from psutil._pslinux import calculate_avail_vmem
@@ -662,6 +674,273 @@ class TestSystemSwapMemory(PsutilTestCase):
             assert m.called
 
 
+@unittest.skipIf(not LINUX, "LINUX only")
+class TestSystemKernelMemory(PsutilTestCase):
+
+    SLABINFO = textwrap.dedent("""\
+        slabinfo - version: 2.1
+        # name            <active_objs> <num_objs> <objsize> <objperslab> <pagesperslab> : tunables <limit> <batchcount> <sharedfactor> : slabdata <active_slabs> <num_slabs> <sharedavail>
+        dentry            105042 105042    192   21    1 : tunables    0    0    0 : slabdata   5002   5002      0
+        kmalloc-8k           120    124   8192    4    8 : tunables    0    0    0 : slabdata     31     31      0
+        """)  # NOQA
+
+    VMALLOCINFO = textwrap.dedent("""\
+        0xffffa00000000000-0xffffa00000005000   20480 bpf_prog_alloc+0x1d/0x60 pages=4 vmalloc N0=4
+        0xffffa00000005000-0xffffa0000000a000   20480 bpf_prog_alloc+0x1d/0x60 pages=4 vmalloc vpages N0=4
+        0xffffa0000000a000-0xffffa0000000c000    8192 acpi_os_map_iomem+0x1bc/0x1e0 phys=0x00000000fed00000 ioremap
+        0xffffa0000000c000-0xffffa0000000f000   12288 pcpu_get_vm_areas+0x0/0x1100 vmalloc
+        """)  # NOQA
+
+    def write_testfn(self, content):
+        testfn = self.get_testfn()
+        with open(testfn, "w") as f:
+            f.write(content)
+        return testfn
+
+    def setUp(self):
+        super(TestSystemKernelMemory, self).setUp()
+        psutil._pslinux._last_slab_caches = None
+
+    def tearDown(self):
+        psutil._pslinux._last_slab_caches = None
+        super(TestSystemKernelMemory, self).tearDown()
+
+    def test_cext_slabinfo(self):
+        cext = psutil._psplatform.cext
+        ret = cext.linux_slabinfo(self.write_testfn(self.SLABINFO))
+        self.assertEqual(ret, [
+            ("dentry", 105042, 105042, 192, 21, 1, 5002),
+            ("kmalloc-8k", 120, 124, 8192, 4, 8, 31)])
+
+    def test_cext_slabinfo_unsupported_version(self):
+        cext = psutil._psplatform.cext
+        testfn = self.write_testfn("slabinfo - version: 1.1\n")
+        self.assertRaises(RuntimeError, cext.linux_slabinfo, testfn)
+
+    def test_cext_vmallocinfo(self):
+        cext = psutil._psplatform.cext
+        ret = cext.linux_vmallocinfo(self.write_testfn(self.VMALLOCINFO))
+        self.assertEqual(ret, [
+            ("bpf_prog_alloc", 20480),
+            ("bpf_prog_alloc", 20480),
+            ("pcpu_get_vm_areas", 12288)])
+
+    def test_cext_missing_file(self):
+        cext = psutil._psplatform.cext
+        self.assertRaises(FileNotFoundError, cext.linux_slabinfo,
+                          self.get_testfn())
+        self.assertRaises(FileNotFoundError, cext.linux_vmallocinfo,
+                          self.get_testfn())
+
+    def test_slab_vmalloc_mocked(self):
+        cext = psutil._psplatform.cext
+        slabinfo = cext.linux_slabinfo(self.write_testfn(self.SLABINFO))
+        vmallocinfo = cext.linux_vmallocinfo(
+            self.write_testfn(self.VMALLOCINFO))
+        with mock.patch("psutil._pslinux.cext.linux_slabinfo",
+                        return_value=slabinfo):
+            with mock.patch("psutil._pslinux.cext.linux_vmallocinfo",
+                            return_value=vmallocinfo):
+                ret = psutil.kernel_memory()
+        pagesize = psutil._pslinux.PAGESIZE
+        self.assertEqual(ret.slab[0].name, "dentry")
+        self.assertEqual(ret.slab[0].size, 5002 * 1 * pagesize)
+        self.assertEqual(ret.slab[1].name, "kmalloc-8k")
+        self.assertEqual(ret.slab[1].size, 31 * 8 * pagesize)
+        self.assertEqual(ret.vmalloc, [
+            ("bpf_prog_alloc", 40960, 2), ("pcpu_get_vm_areas", 12288, 1)])
+
+    def test_top(self):
+        slabinfo = [("cache%s" % i, i, i, 8, 1, 1, i) for i in range(1, 20)]
+        with mock.patch("psutil._pslinux.cext.linux_slabinfo",
+                        return_value=slabinfo):
+            self.assertEqual(len(psutil.kernel_memory().slab), 10)
+            ret = psutil.kernel_memory(top=3).slab
+            self.assertEqual([x.name for x in ret],
+                             ["cache19", "cache18", "cache17"])
+            self.assertEqual(len(psutil.kernel_memory(top=None).slab), 19)
+        self.assertRaises(ValueError, psutil.kernel_memory, top=0)
+
+    def test_delta(self):
+        first = [("dentry", 100, 100, 192, 21, 1, 5),
+                 ("kmalloc-8k", 4, 4, 8192, 4, 8, 1)]
+        second = [("dentry", 200, 210, 192, 21, 1, 10),
+                  ("kmalloc-8k", 4, 4, 8192, 4, 8, 1),
+                  ("new-cache", 1, 1, 64, 64, 1, 1)]
+        pagesize = psutil._pslinux.PAGESIZE
+        with mock.patch("psutil._pslinux.cext.linux_slabinfo",
+                        return_value=first):
+            # first call: no previous sample
+            self.assertEqual(psutil.kernel_memory(delta=True).slab, [])
+        with mock.patch("psutil._pslinux.cext.linux_slabinfo",
+                        return_value=second):
+            ret = psutil.kernel_memory(delta=True).slab
+        # unchanged caches are not listed
+        self.assertEqual(ret, [
+            ("dentry", 100, 110, 192, 5 * pagesize),
+            ("new-cache", 1, 1, 64, pagesize)])
+
+    def test_not_readable(self):
+        exc = PermissionError(errno.EACCES, "permission denied")
+        with mock.patch("psutil._pslinux.cext.linux_slabinfo",
+                        side_effect=exc) as m1:
+            with mock.patch("psutil._pslinux.cext.linux_vmallocinfo",
+                            side_effect=exc) as m2:
+                ret = psutil.kernel_memory()
+        assert m1.called
+        assert m2.called
+        self.assertIsNone(ret.slab)
+        self.assertIsNone(ret.vmalloc)
+
+    @unittest.skipIf(not os.access("/proc/slabinfo", os.R_OK),
+                     "/proc/slabinfo not readable")
+    def test_slab_against_slabinfo(self):
+        names = set()
+        with open("/proc/slabinfo") as f:
+            for line in f.readlines()[2:]:
+                names.add(line.split()[0])
+        for cache in psutil.kernel_memory(top=None).slab:
+            self.assertIn(cache.name, names)
+            self.assertGreaterEqual(cache.num_objs, cache.active_objs)
+
+    @unittest.skipIf(not os.path.exists("/sys/kernel/mm/hugepages"),
+                     "no hugetlb support")
+    def test_hugepages_against_meminfo(self):
+        meminfo = {}
+        with open("/proc/meminfo") as f:
+            for line in f:
+                fields = line.split()
+                meminfo[fields[0]] = int(fields[1])
+        pools = psutil.kernel_memory().hugepages
+        pool = pools[meminfo["Hugepagesize:"] * 1024]
+        self.assertEqual(pool.total, meminfo["HugePages_Total:"])
+        self.assertEqual(pool.free, meminfo["HugePages_Free:"])
+        self.assertEqual(pool.reserved, meminfo["HugePages_Rsvd:"])
+        self.assertEqual(pool.surplus, meminfo["HugePages_Surp:"])
+
+    def test_thp_against_vmstat(self):
+        thp = psutil.kernel_memory().thp
+        with open("/proc/vmstat") as f:
+            names = [x.split()[0] for x in f if x.startswith("thp_")]
+        self.assertEqual(sorted(thp), sorted(names))
+
+    def test_zram_mocked(self):
+        def glob_mock(pattern):
+            return ["/sys/block/zram0/mm_stat"]
+
+        # pre 4.x kernels have 7 fields only
+        content = b"4096 100 8192 0 8192 1 0\n"
+        with mock.patch("psutil._pslinux.glob.glob", side_effect=glob_mock):
+            with mock_open_content("/sys/block/zram0/mm_stat", content):
+                ret = psutil.kernel_memory().zram
+        self.assertEqual(ret, {"zram0": (4096, 100, 8192, 0, 8192, 1, 0, 0)})
+
+    def test_zswap_mocked(self):
+        with open("/proc/meminfo", "rb") as f:
+            content = f.read()
+        content = b"".join(x for x in content.splitlines(True)
+                           if not x.startswith(b"Zswap"))
+        with mock_open_content("/proc/meminfo", content):
+            self.assertIsNone(psutil.kernel_memory().zswap)
+        content += b"Zswap:  1024 kB\nZswapped:  4096 kB\n"
+        with mock_open_content("/proc/meminfo", content):
+            self.assertEqual(psutil.kernel_memory().zswap,
+                             (1024 * 1024, 4096 * 1024))
+
+
+@unittest.skipIf(not LINUX, "LINUX only")
+class TestSystemVmEvents(PsutilTestCase):
+
+    VMSTAT = textwrap.dedent("""\
+        nr_free_pages 857689
+        pgfault 1000
+        pgmajfault 10
+        compact_stall 3
+        """)
+
+    def write_testfn(self, content):
+        testfn = self.get_testfn()
+        with open(testfn, "w") as f:
+            f.write(content)
+        return testfn
+
+    def test_against_file(self):
+        with open("/proc/vmstat") as f:
+            names = [line.split()[0] for line in f]
+        ret = psutil.vm_events()
+        self.assertEqual(sorted(ret), sorted(names))
+        with open("/proc/vmstat") as f:
+            for line in f:
+                name, value = line.split()
+                if name == "pgfault":
+                    self.assertGreaterEqual(int(value), ret[name])
+
+    def test_cext(self):
+        cext = psutil._psplatform.cext
+        path = self.write_testfn(self.VMSTAT)
+        self.assertEqual(cext.linux_vmstat(path), [
+            ("nr_free_pages", 857689), ("pgfault", 1000),
+            ("pgmajfault", 10), ("compact_stall", 3)])
+        self.assertEqual(
+            cext.linux_vmstat_slots(path, [
+                (3, "compact_stall"), (1, "pgfault"), (2, "pgfault"),
+                (1, "pgfaul"), (4, "pgfault"), (-1, "pgfault")]),
+            [3, 1000, None, None, None, None])
+        self.assertRaises(FileNotFoundError, cext.linux_vmstat,
+                          self.get_testfn())
+
+    def test_sampler(self):
+        sampler = psutil.VmEventsSampler()
+        assert sampler.keys
+        for key in sampler.keys:
+            self.assertIn(key, sampler.DEFAULT_KEYS)
+        sample = sampler.sample()
+        self.assertEqual(sorted(sample), sorted(sampler.keys))
+        self.assertGreater(sample["pgfault"], 0)
+        sampler = psutil.VmEventsSampler(["pgfault"])
+        self.assertEqual(list(sampler.sample()), ["pgfault"])
+        self.assertRaises(ValueError, psutil.VmEventsSampler, ["foo"])
+        self.assertRaises(ValueError, psutil.VmEventsSampler, [])
+
+    def test_sampler_relookup(self):
+        procfs_path = self.get_testfn()
+        os.mkdir(procfs_path)
+        path = os.path.join(procfs_path, "vmstat")
+        with open(path, "w") as f:
+            f.write(self.VMSTAT)
+        with mock.patch("psutil._pslinux.get_procfs_path",
+                        return_value=procfs_path):
+            sampler = psutil.VmEventsSampler(["pgfault", "compact_stall"])
+        self.assertEqual(sampler.sample(),
+                         {"pgfault": 1000, "compact_stall": 3})
+        with open(path, "w") as f:
+            f.write("pgfault 2000\nfoo 1\ncompact_stall 4\n")
+        self.assertEqual(sampler.sample(),
+                         {"pgfault": 2000, "compact_stall": 4})
+        self.assertEqual(sampler._slots,
+                         [(0, "pgfault"), (2, "compact_stall")])
+
+    def test_rates(self):
+        sampler = psutil.VmEventsSampler(["pgfault", "pgmajfault"])
+        samples = [{"pgfault": 1000, "pgmajfault": 10},
+                   {"pgfault": 3000, "pgmajfault": 10},
+                   {"pgfault": 4000, "pgmajfault": 16}]
+        with mock.patch.object(sampler, "sample", side_effect=samples):
+            with mock.patch.object(sampler, "_timer",
+                                   side_effect=[100, 102, 104]):
+                self.assertEqual(sampler.rates(),
+                                 {"pgfault": 0.0, "pgmajfault": 0.0})
+                self.assertEqual(sampler.rates(),
+                                 {"pgfault": 1000.0, "pgmajfault": 0.0})
+                self.assertEqual(sampler.rates(),
+                                 {"pgfault": 500.0, "pgmajfault": 3.0})
+        with mock.patch("psutil._pslinux.time.sleep") as m:
+            ret = sampler.rates(interval=0.5)
+            m.assert_called_once_with(0.5)
+        self.assertGreaterEqual(ret["pgfault"], 0)
+        self.assertRaises(ValueError, sampler.rates, -1)
+
+
 # =====================================================================
 # --- system CPU
 # =====================================================================
@@ -937,6 +1216,367 @@ class TestSystemCPUStats(PsutilTestCase):
         self.assertAlmostEqual(vmstat_value, psutil_value, delta=500)
 
 
+@unittest.skipIf(not LINUX, "LINUX only")
+class TestSystemCPUSchedStats(PsutilTestCase):
+
+    SCHEDSTAT = textwrap.dedent("""\
+        version 15
+        timestamp 4302019455
+        cpu0 0 0 1000 400 500 300 2000000000 500000000 900
+        domain0 00000003 10 9 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0
+        cpu1 0 0 1000 400 500 300 3000000000 1500000000 100
+        domain0 00000003 10 9 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0
+        """)
+
+    def write_schedstat(self, content):
+        path = self.get_testfn()
+        with open(path, "w") as f:
+            f.write(content)
+        return path
+
+    def test_cext(self):
+        cext = psutil._psplatform.cext
+        path = self.write_schedstat(self.SCHEDSTAT)
+        self.assertEqual(cext.linux_schedstat(path), [
+            (0, 2000000000, 500000000, 900),
+            (1, 3000000000, 1500000000, 100)])
+        path = self.write_schedstat("version 9\n")
+        self.assertRaises(RuntimeError, cext.linux_schedstat, path)
+        self.assertRaises(FileNotFoundError, cext.linux_schedstat,
+                          self.get_testfn())
+
+    def test_running_blocked(self):
+        ret = psutil.cpu_sched_stats()
+        self.assertGreaterEqual(ret.running, 1)  # us
+        self.assertGreaterEqual(ret.blocked, 0)
+        with open("/proc/stat") as f:
+            data = f.read()
+        self.assertIn("procs_blocked %s" % ret.blocked, data)
+
+    def test_schedstat(self):
+        path = self.write_schedstat(self.SCHEDSTAT)
+        parse = psutil._psplatform.cext.linux_schedstat
+        with mock.patch("psutil._pslinux.cext.linux_schedstat",
+                        side_effect=lambda _: parse(path)):
+            ret = psutil.cpu_sched_stats()
+            self.assertEqual(ret.run_time, 5.0)
+            self.assertEqual(ret.run_delay, 2.0)
+            self.assertEqual(ret.timeslices, 1000)
+            ret = psutil.cpu_sched_stats(percpu=True)
+            self.assertEqual(ret.run_time, [2.0, 3.0])
+            self.assertEqual(ret.run_delay, [0.5, 1.5])
+            self.assertEqual(ret.timeslices, [900, 100])
+
+    def test_no_schedstat(self):
+        with mock.patch("psutil._pslinux.cext.linux_schedstat",
+                        side_effect=FileNotFoundError):
+            ret = psutil.cpu_sched_stats()
+            self.assertIsNone(ret.run_delay)
+            self.assertEqual(psutil.cpu_sched_stats(percpu=True).run_delay,
+                             [])
+            self.assertIsNone(psutil.cpu_sched_stats_rate(0.001).run_delay)
+
+    def test_rate(self):
+        ntuple = psutil._psplatform.scpusched
+        t1 = ntuple(1, 0, [2.0, 3.0], [0.5, 1.5], [900, 100])
+        t2 = ntuple(3, 1, [3.0, 5.0], [0.5, 3.5], [1100, 100])
+        self.addCleanup(setattr, psutil, "_last_cpu_sched_stats", None)
+        psutil._last_cpu_sched_stats = (100.0, t1)
+        with mock.patch("psutil._psplatform.cpu_sched_stats",
+                        return_value=t2):
+            with mock.patch("psutil._timer", return_value=102.0):
+                ret = psutil.cpu_sched_stats_rate(percpu=True)
+            self.assertEqual(ret, (3, 1, [0.5, 1.0], [0.0, 1.0], [100, 0]))
+            psutil._last_cpu_sched_stats = (100.0, t1)
+            with mock.patch("psutil._timer", return_value=102.0):
+                ret = psutil.cpu_sched_stats_rate()
+            self.assertEqual(ret, (3, 1, 1.5, 1.0, 100))
+            # second call, nothing changed
+            with mock.patch("psutil._timer", return_value=103.0):
+                ret = psutil.cpu_sched_stats_rate()
+            self.assertEqual(ret, (3, 1, 0.0, 0.0, 0.0))
+        self.assertRaises(ValueError, psutil.cpu_sched_stats_rate, -1)
+
+
+@unittest.skipIf(not LINUX, "LINUX only")
+class TestSystemCPUAffinityHistogram(PsutilTestCase):
+
+    def test_against_cpu_affinity(self):
+        me = psutil.Process()
+        ret = psutil.cpu_affinity_histogram(pids=[me.pid], threads=False)
+        self.assertEqual(ret.tasks, 1)
+        self.assertEqual(
+            [cpu for cpu, n in enumerate(ret.percpu) if n], me.cpu_affinity())
+
+    def test_threads(self):
+        ret = psutil.cpu_affinity_histogram(pids=[os.getpid()])
+        self.assertEqual(ret.tasks, psutil.Process().num_threads())
+
+    def test_all(self):
+        ret = psutil.cpu_affinity_histogram()
+        assert ret.tasks > 0, ret
+        self.assertGreaterEqual(len(ret.percpu), psutil.cpu_count())
+        for n in ret.percpu:
+            assert 0 <= n <= ret.tasks, ret
+        pinned = psutil.cpu_affinity_histogram(pinned_only=True)
+        for n in pinned.percpu:
+            assert 0 <= n <= pinned.tasks, pinned
+
+    def test_gone_pids(self):
+        sproc = self.spawn_testproc()
+        self.assertEqual(psutil.cpu_affinity_histogram(
+            pids=[sproc.pid], threads=False).tasks, 1)
+        sproc.terminate()
+        sproc.wait()
+        ret = psutil.cpu_affinity_histogram(pids=[sproc.pid])
+        self.assertEqual(ret.tasks, 0)
+        ret = psutil.cpu_affinity_histogram(pids=[sproc.pid], threads=False)
+        self.assertEqual(ret.tasks, 0)
+
+
+@unittest.skipIf(not LINUX, "LINUX only")
+class TestSystemCPUPowerStates(PsutilTestCase):
+
+    def setUp(self):
+        super(TestSystemCPUPowerStates, self).setUp()
+        self.root = self.get_testfn()
+        self.write("online", "0-1\n")
+        for cpu in (0, 1):
+            self.write("cpu%s/cpuidle/state0/name" % cpu, "POLL\n")
+            self.write("cpu%s/cpuidle/state0/latency" % cpu, "0\n")
+            self.write("cpu%s/cpuidle/state1/name" % cpu, "C1\n")
+            self.write("cpu%s/cpuidle/state1/latency" % cpu, "2\n")
+            self.write("cpu%s/cpufreq/stats/time_in_state" % cpu, "")
+        self.set_cpu(0, usage=(10, 20), time=(1000000, 2000000),
+                     freq={800000: 100, 2400000: 300})
+        self.set_cpu(1, usage=(1, 2), time=(0, 4000000),
+                     freq={800000: 50, 2400000: 50})
+        patcher = mock.patch("psutil._pslinux.CPU_SYSFS_PATH", self.root)
+        patcher.start()
+        self.addCleanup(patcher.stop)
+        self.addCleanup(psutil._psplatform._cpu_power_files.close)
+        self.addCleanup(setattr, psutil, "_last_cpu_power_states", None)
+
+    def write(self, path, content):
+        path = os.path.join(self.root, path)
+        if not os.path.isdir(os.path.dirname(path)):
+            os.makedirs(os.path.dirname(path))
+        with open(path, "w") as f:
+            f.write(content)
+
+    def set_cpu(self, cpu, usage, time, freq):
+        for n in (0, 1):
+            self.write("cpu%s/cpuidle/state%s/usage" % (cpu, n),
+                       "%s\n" % usage[n])
+            self.write("cpu%s/cpuidle/state%s/time" % (cpu, n),
+                       "%s\n" % time[n])
+        self.write("cpu%s/cpufreq/stats/time_in_state" % cpu,
+                   "".join("%s %s\n" % x for x in sorted(freq.items())))
+
+    def test_percpu(self):
+        ret = psutil.cpu_power_states()
+        self.assertEqual(len(ret), 2)
+        self.assertEqual(ret[0].idle, [
+            ("POLL", 0.0, 10, 1.0),
+            ("C1", 0.000002, 20, 2.0)])
+        self.assertEqual(ret[0].freq, {800.0: 1.0, 2400.0: 3.0})
+        self.assertEqual(ret[1].idle[1].time, 4.0)
+
+    def test_sum(self):
+        ret = psutil.cpu_power_states(percpu=False)
+        self.assertEqual(ret.idle, [
+            ("POLL", 0.0, 11, 1.0),
+            ("C1", 0.000002, 22, 6.0)])
+        self.assertEqual(ret.freq, {800.0: 1.5, 2400.0: 3.5})
+
+    def test_fds_are_reused(self):
+        psutil.cpu_power_states()
+        self.set_cpu(0, usage=(11, 21), time=(1000001, 2000001),
+                     freq={800000: 101, 2400000: 301})
+        with mock.patch("psutil._pslinux.os.open") as m:
+            ret = psutil.cpu_power_states()
+            assert not m.called
+        self.assertEqual(ret[0].idle[0].usage, 11)
+        self.assertEqual(ret[0].freq, {800.0: 1.01, 2400.0: 3.01})
+
+    def test_hotplug(self):
+        self.assertEqual(len(psutil.cpu_power_states()), 2)
+        self.write("online", "0\n")
+        self.assertEqual(len(psutil.cpu_power_states()), 1)
+        self.write("online", "0-1\n")
+        self.assertEqual(len(psutil.cpu_power_states()), 2)
+        # a file which disappears is re-opened
+        os.remove(os.path.join(self.root, "cpu1/cpuidle/state1/time"))
+        os.remove(os.path.join(self.root, "cpu1/cpuidle/state1/usage"))
+        with mock.patch("psutil._pslinux.cext.linux_read_files",
+                        side_effect=[[b"0-1\n"] + [errno.ENODEV] * 10,
+                                     [b"0-1\n"] + [b"1\n"] * 4 +
+                                     [b"800000 1\n"] + [b"1\n"] * 2 +
+                                     [b"800000 1\n"]]) as m:
+            ret = psutil.cpu_power_states()
+            self.assertEqual(m.call_count, 2)
+        self.assertEqual([len(x.idle) for x in ret], [2, 1])
+
+    def test_open_error(self):
+        # a file which can't be opened (e.g. EMFILE): no fd is kept and
+        # the files are opened on every call instead
+        orig_open = os.open
+
+        def open_mock(path, *args):
+            if path.endswith("cpu0/cpuidle/state1/time"):
+                raise OSError(errno.EMFILE, "")
+            return orig_open(path, *args)
+
+        with mock.patch("psutil._pslinux.os.open", side_effect=open_mock):
+            ret = psutil.cpu_power_states()
+        files = psutil._psplatform._cpu_power_files.files
+        self.assertEqual(len(files), 2 * (4 + 1))
+        assert all(isinstance(x, bytes) for x in files), files
+        self.assertEqual(len(ret[0].idle), 2)
+        self.assertEqual(ret[0].freq, {800.0: 1.0, 2400.0: 3.0})
+        self.assertEqual(ret[1].idle, [
+            ("POLL", 0.0, 1, 0.0),
+            ("C1", 0.000002, 2, 4.0)])
+
+    def test_max_fds(self):
+        with mock.patch("psutil._pslinux.CPU_POWER_MAX_FDS", 5):
+            with mock.patch("psutil._pslinux.os.open") as m:
+                ret = psutil.cpu_power_states()
+                assert not m.called
+        files = psutil._psplatform._cpu_power_files.files
+        assert all(isinstance(x, bytes) for x in files), files
+        self.assertEqual(ret[0].idle[0].usage, 10)
+        self.set_cpu(0, usage=(11, 21), time=(1000001, 2000001),
+                     freq={800000: 101, 2400000: 301})
+        ret = psutil.cpu_power_states()
+        self.assertEqual(ret[0].idle[0].usage, 11)
+        self.assertEqual(ret[0].freq, {800.0: 1.01, 2400.0: 3.01})
+
+    def test_scan_error(self):
+        # an unexpected error leaves no partial state behind
+        with mock.patch("psutil._pslinux.cat",
+                        side_effect=["POLL", "0", "C1", "2", "POLL",
+                                     OSError(errno.EIO, "")]):
+            self.assertRaises(OSError, psutil.cpu_power_states)
+        files = psutil._psplatform._cpu_power_files
+        self.assertIsNone(files.online)
+        self.assertEqual(files.files, [])
+        self.assertEqual(len(psutil.cpu_power_states()), 2)
+
+    def test_not_available(self):
+        self.write("online", "2\n")
+        self.assertRaises(NotImplementedError, psutil.cpu_power_states)
+
+    def test_percent(self):
+        psutil._last_cpu_power_states = None
+        with mock.patch("psutil._timer", return_value=100.0):
+            ret = psutil.cpu_power_states_percent()
+        self.assertEqual(ret[0].active, 100.0)
+        self.assertEqual(ret[0].idle, {"POLL": 0.0, "C1": 0.0})
+        self.assertEqual(ret[0].freq, {800.0: 0.0, 2400.0: 0.0})
+        # 2 seconds later
+        self.set_cpu(0, usage=(10, 30), time=(1000000, 3000000),
+                     freq={800000: 150, 2400000: 450})
+        self.set_cpu(1, usage=(1, 2), time=(0, 4000000),
+                     freq={800000: 250, 2400000: 50})
+        with mock.patch("psutil._timer", return_value=102.0):
+            ret = psutil.cpu_power_states_percent()
+        self.assertEqual(ret[0].active, 50.0)
+        self.assertEqual(list(ret[0].idle.items()),
+                         [("POLL", 0.0), ("C1", 50.0)])
+        self.assertEqual(ret[0].freq, {800.0: 25.0, 2400.0: 75.0})
+        self.assertEqual(ret[1].active, 100.0)
+        self.assertEqual(ret[1].freq, {800.0: 100.0, 2400.0: 0.0})
+
+    def test_percent_sum(self):
+        t1 = psutil.cpu_power_states()
+        self.set_cpu(0, usage=(10, 30), time=(1000000, 3000000),
+                     freq={800000: 150, 2400000: 450})
+        psutil._last_cpu_power_states = (100.0, t1)
+        with mock.patch("psutil._timer", return_value=102.0):
+            ret = psutil.cpu_power_states_percent(percpu=False)
+        self.assertEqual(ret.active, 75.0)
+        self.assertEqual(list(ret.idle.items()),
+                         [("POLL", 0.0), ("C1", 25.0)])
+        self.assertEqual(ret.freq, {800.0: 12.5, 2400.0: 37.5})
+
+    def test_percent_blocking(self):
+        with mock.patch("psutil.time.sleep") as m:
+            ret = psutil.cpu_power_states_percent(interval=0.5)
+            m.assert_called_once_with(0.5)
+        self.assertEqual(len(ret), 2)
+        self.assertRaises(ValueError, psutil.cpu_power_states_percent, -1)
+
+
+@unittest.skipIf(not LINUX, "LINUX only")
+class TestSystemCPUTopology(PsutilTestCase):
+
+    def setUp(self):
+        super(TestSystemCPUTopology, self).setUp()
+        # 2 sockets, 2 cores per socket, 2 threads per core, a NUMA
+        # node per socket
+        self.root = self.get_testfn()
+        os.makedirs(self.root)
+        with open(os.path.join(self.root, "online"), "w") as f:
+            f.write("0-7\n")
+        for cpu in range(8):
+            path = os.path.join(self.root, "cpu%s" % cpu)
+            os.makedirs(os.path.join(path, "topology"))
+            os.makedirs(os.path.join(path, "node%s" % (cpu // 4)))
+            with open(os.path.join(path, "topology/core_id"), "w") as f:
+                f.write("%s\n" % (cpu % 4 // 2))
+            with open(os.path.join(path, "topology/physical_package_id"),
+                      "w") as f:
+                f.write("%s\n" % (cpu // 4))
+        patcher = mock.patch("psutil._pslinux.CPU_SYSFS_PATH", self.root)
+        patcher.start()
+        self.addCleanup(patcher.stop)
+        self.addCleanup(psutil._psplatform._cpu_topology_cache.clear)
+        psutil._psplatform._cpu_topology_cache.clear()
+
+    def test_cpu_topology(self):
+        self.assertEqual(psutil._psplatform.cpu_topology(), [
+            ((0, 0), 0, 0), ((0, 0), 0, 0), ((0, 1), 0, 0), ((0, 1), 0, 0),
+            ((1, 0), 1, 1), ((1, 0), 1, 1), ((1, 1), 1, 1), ((1, 1), 1, 1)])
+        # cached
+        with mock.patch("psutil._pslinux.cext.linux_read_files") as m:
+            psutil._psplatform.cpu_topology()
+            assert not m.called
+        # CPU hotplug
+        with open(os.path.join(self.root, "online"), "w") as f:
+            f.write("0-3\n")
+        self.assertEqual(len(psutil._psplatform.cpu_topology()), 4)
+
+    def test_cpu_topology_missing_files(self):
+        shutil.rmtree(os.path.join(self.root, "cpu1"))
+        ret = psutil._psplatform.cpu_topology()
+        self.assertEqual(ret[1], ((0, 1), 0, 0))
+
+    def test_cpu_percent_per(self):
+        def times(user, idle):
+            nfields = len(psutil._psplatform.scputimes._fields)
+            return [psutil._psplatform.scputimes(
+                *([x, 0, 0, idle - x] + [0] * (nfields - 4)))
+                for x in user]
+
+        psutil.cpu_times()  # set scputimes fields
+        # user times of each CPU over 10 seconds
+        t1 = times([0] * 8, 0)
+        t2 = times([10, 0, 5, 5, 0, 0, 0, 1], 10)
+        for fun in (psutil.cpu_percent, psutil.cpu_times_percent):
+            for per in ("core", "socket", "numa"):
+                with mock.patch("psutil.cpu_times", side_effect=[t1, t2]):
+                    ret = fun(interval=0.001, per=per)
+                if fun is psutil.cpu_times_percent:
+                    ret = dict((k, v.user) for k, v in ret.items())
+                if per == "core":
+                    self.assertEqual(list(ret.items()), [
+                        ((0, 0), 50.0), ((0, 1), 50.0), ((1, 0), 0.0),
+                        ((1, 1), 5.0)])
+                else:
+                    self.assertEqual(dict(ret), {0: 50.0, 1: 2.5})
+
+
 @unittest.skipIf(not LINUX, "LINUX only")
 class TestLoadAvg(PsutilTestCase):
 
@@ -951,6 +1591,82 @@ class TestLoadAvg(PsutilTestCase):
         self.assertAlmostEqual(float(proc_value[2]), psutil_value[2], delta=1)
 
 
+@unittest.skipIf(not LINUX, "LINUX only")
+class TestSystemCollect(PsutilTestCase):
+
+    def count_opens(self, fun):
+        paths = []
+
+        def wrapper(path):
+            paths.append(os.path.basename(path))
+            return open_binary(path)
+
+        with mock.patch("psutil._pslinux.open_binary", side_effect=wrapper):
+            fun()
+        return collections.Counter(paths)
+
+    def test_read_once(self):
+        names = ["cpu_times", "per_cpu_times", "cpu_stats", "boot_time",
+                 "virtual_memory", "swap_memory", "cpu_sched_stats"]
+        psutil.cpu_times()  # set scputimes
+        opens = self.count_opens(lambda: psutil.collect(names))
+        self.assertEqual(opens["stat"], 1)
+        self.assertEqual(opens["meminfo"], 1)
+        self.assertEqual(opens["vmstat"], 1)
+
+    def test_read_many_times_outside_snapshot(self):
+        def fun():
+            psutil.cpu_times()
+            psutil.cpu_stats()
+            psutil.boot_time()
+
+        psutil.cpu_times()  # set scputimes
+        self.assertEqual(self.count_opens(fun)["stat"], 3)
+
+    def test_snapshot(self):
+        system_snapshot = psutil._pslinux.system_snapshot
+        with system_snapshot():
+            a = psutil.cpu_times()
+            with system_snapshot():
+                b = psutil.cpu_times()
+            time.sleep(0.05)
+            c = psutil.cpu_times()
+            self.assertEqual(a, b)
+            self.assertEqual(a, c)
+        self.assertIsNone(psutil._pslinux._snapshot.files)
+
+    def test_snapshot_per_thread(self):
+        ret = []
+        t = threading.Thread(
+            target=lambda: ret.append(getattr(
+                psutil._pslinux._snapshot, "files", None)))
+        with psutil._pslinux.system_snapshot():
+            psutil.cpu_stats()
+            t.start()
+            t.join()
+        self.assertEqual(ret, [None])
+
+    @mock.patch("psutil._pslinux.BOOT_TIME", None)  # set by boot_time()
+    def test_results(self):
+        with mock_open_content(
+                "/proc/stat",
+                textwrap.dedent("""\
+                    cpu  100 0 100 800 0 0 0 0 0 0
+                    cpu0 100 0 100 800 0 0 0 0 0 0
+                    intr 50 0 0
+                    ctxt 60
+                    btime 1600000000
+                    processes 100
+                    procs_running 2
+                    procs_blocked 1
+                    softirq 70 0 0
+                    """).encode()):
+            psutil.cpu_times()  # set scputimes
+            ret = psutil.collect(["cpu_stats", "boot_time"])
+        self.assertEqual(ret["cpu_stats"], (60, 50, 70, 0))
+        self.assertEqual(ret["boot_time"], 1600000000.0)
+
+
 # =====================================================================
 # --- system network
 # =====================================================================
@@ -1095,6 +1811,24 @@ class TestSystemNetIOCounters(PsutilTestCase):
             self.assertAlmostEqual(
                 stats.dropout, ifconfig_ret['dropout'], delta=10)
 
+    def test_filters(self):
+        content = textwrap.dedent("""\
+            Inter-|   Receive
+             face |bytes    packets errs drop fifo frame compressed multicast
+                lo: 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16
+              eth0: 10 20 30 40 50 60 70 80 90 100 110 120 130 140 150 160
+             veth1: garbage
+            """)
+        with mock_open_content("/proc/net/dev", content):
+            ret = psutil.net_io_counters(pernic=True, nowrap=False,
+                                         include=["lo", "eth*"])
+            self.assertEqual(sorted(ret), ["eth0", "lo"])
+            self.assertEqual(ret["eth0"].bytes_recv, 10)
+            ret = psutil.net_io_counters(nowrap=False,
+                                         exclude=re.compile("^veth"))
+            self.assertEqual(ret.bytes_sent, 9 + 90)
+            self.assertRaises(ValueError, psutil.net_io_counters)
+
 
 @unittest.skipIf(not LINUX, "LINUX only")
 class TestSystemNetConnections(PsutilTestCase):
@@ -1124,6 +1858,192 @@ class TestSystemNetConnections(PsutilTestCase):
             assert m.called
 
 
+@unittest.skipIf(not LINUX, "LINUX only")
+class TestSystemPortOwners(PsutilTestCase):
+
+    def listen(self, family=socket.AF_INET, type=socket.SOCK_STREAM):
+        sock = socket.socket(family, type)
+        self.addCleanup(sock.close)
+        sock.bind(("127.0.0.1" if family == socket.AF_INET else "::1", 0))
+        if type == socket.SOCK_STREAM:
+            sock.listen(5)
+        return sock
+
+    def test_tcp(self):
+        sock = self.listen()
+        port = sock.getsockname()[1]
+        ret = psutil.port_owners(port)
+        self.assertEqual(len(ret), 1)
+        conn = ret[0]
+        self.assertEqual(conn.pid, os.getpid())
+        self.assertEqual(conn.fd, sock.fileno())
+        self.assertEqual(conn.status, psutil.CONN_LISTEN)
+        self.assertEqual(conn.laddr, ("127.0.0.1", port))
+        self.assertEqual(conn.raddr, ())
+        conns = [x for x in psutil.net_connections(kind="tcp")
+                 if x.laddr and x.laddr.port == port]
+        self.assertEqual(ret, conns)
+        self.assertEqual(psutil.port_owners(port, proto="tcp6"), [])
+        self.assertEqual(psutil.port_owners(port, proto="udp"), [])
+
+    def test_tcp_state(self):
+        sock = self.listen()
+        port = sock.getsockname()[1]
+        client = socket.create_connection(("127.0.0.1", port))
+        self.addCleanup(client.close)
+        conn, _ = sock.accept()
+        self.addCleanup(conn.close)
+        ret = psutil.port_owners(port, state=psutil.CONN_ESTABLISHED)
+        self.assertEqual([(x.fd, x.raddr) for x in ret],
+                         [(conn.fileno(), client.getsockname())])
+        ret = psutil.port_owners(port, state=None)
+        self.assertEqual(sorted(x.fd for x in ret),
+                         sorted([sock.fileno(), conn.fileno()]))
+
+    def test_udp(self):
+        sock = self.listen(type=socket.SOCK_DGRAM)
+        port = sock.getsockname()[1]
+        ret = psutil.port_owners(port, proto="udp")
+        self.assertEqual([(x.fd, x.status) for x in ret],
+                         [(sock.fileno(), psutil.CONN_NONE)])
+        # connected sockets are not "listening"
+        sock.connect(("127.0.0.1", 9))
+        self.assertEqual(psutil.port_owners(port, proto="udp"), [])
+        ret = psutil.port_owners(port, proto="udp", state=None)
+        self.assertEqual([x.fd for x in ret], [sock.fileno()])
+
+    def test_not_found(self):
+        sock = self.listen()
+        port = sock.getsockname()[1]
+        sock.close()
+        self.assertEqual(psutil.port_owners(port), [])
+
+    def test_unknown_owner(self):
+        sock = self.listen()
+        port = sock.getsockname()[1]
+        with mock.patch("psutil._pslinux.cext.linux_socket_owners",
+                        return_value=[]):
+            ret = psutil.port_owners(port)
+        self.assertEqual([(x.fd, x.pid) for x in ret], [(-1, None)])
+
+    def test_time_wait(self):
+        # TIME_WAIT sockets have no owner and all have inode 0: they
+        # must not be looked up nor collapsed into one
+        sock = self.listen()
+        port = sock.getsockname()[1]
+        for x in range(2):
+            client = socket.create_connection(("127.0.0.1", port))
+            conn, _ = sock.accept()
+            # the side closing first enters TIME_WAIT
+            conn.close()
+            client.close()
+        with mock.patch("psutil._pslinux.cext.linux_socket_owners",
+                        wraps=psutil._psplatform.cext.linux_socket_owners
+                        ) as m:
+            ret = psutil.port_owners(port, state=psutil.CONN_TIME_WAIT)
+            assert not m.called
+        self.assertEqual([(x.fd, x.pid) for x in ret], [(-1, None)] * 2)
+        ret = psutil.port_owners(port, state=None)
+        self.assertEqual(sorted((x.fd, x.status) for x in ret),
+                         sorted([(-1, psutil.CONN_TIME_WAIT)] * 2 +
+                                [(sock.fileno(), psutil.CONN_LISTEN)]))
+
+    def test_invalid_args(self):
+        self.assertRaises(ValueError, psutil.port_owners, 80, proto="unix")
+        self.assertRaises(ValueError, psutil.port_owners, 80, proto="all")
+        self.assertRaises(ValueError, psutil.port_owners, 80, proto="?")
+        self.assertRaises(ValueError, psutil.port_owners, 65536)
+
+    def test_cext(self):
+        cext = psutil._psplatform.cext
+        sock = self.listen()
+        inode = os.fstat(sock.fileno()).st_ino
+        procfs = psutil._pslinux.get_procfs_path()
+        self.assertEqual(cext.linux_socket_owners(procfs, []), [])
+        self.assertEqual(
+            cext.linux_socket_owners(procfs, [inode, inode, 1]),
+            [(inode, os.getpid(), sock.fileno())])
+        dup = os.dup(sock.fileno())
+        self.addCleanup(os.close, dup)
+        ret = cext.linux_socket_owners(procfs, [inode])
+        self.assertEqual(sorted(x[2] for x in ret),
+                         sorted([sock.fileno(), dup]))
+        self.assertRaises(TypeError, cext.linux_socket_owners, procfs, 1)
+        self.assertRaises(TypeError, cext.linux_socket_owners, procfs, ["1"])
+        self.assertRaises(FileNotFoundError, cext.linux_socket_owners,
+                          self.get_testfn(), [inode])
+
+
+@unittest.skipIf(not LINUX, "LINUX only")
+class TestSystemFileUsers(PsutilTestCase):
+
+    def mine(self, path):
+        return [(x.fd, x.type) for x in psutil.file_users(path)
+                if x.pid == os.getpid()]
+
+    def test_fd(self):
+        testfn = self.get_testfn()
+        with open(testfn, "wb") as f:
+            self.assertEqual(self.mine(testfn), [(f.fileno(), "fd")])
+            ret = [x for x in psutil.file_users(testfn)
+                   if x.pid == os.getpid()]
+            self.assertEqual(ret[0].path, os.path.realpath(testfn))
+        self.assertEqual(self.mine(testfn), [])
+
+    def test_mmap(self):
+        testfn = self.get_testfn()
+        with open(testfn, "wb") as f:
+            f.write(b"x" * mmap.PAGESIZE * 2)
+        with open(testfn, "rb") as f:
+            m1 = mmap.mmap(f.fileno(), mmap.PAGESIZE, access=mmap.ACCESS_READ)
+            self.addCleanup(m1.close)
+            m2 = mmap.mmap(f.fileno(), mmap.PAGESIZE, access=mmap.ACCESS_READ,
+                           offset=mmap.PAGESIZE)
+            self.addCleanup(m2.close)
+        # mappings of the same file are listed once (mmap objects also
+        # hold a dup()ed fd, which is listed as such)
+        ret = [x for x in self.mine(testfn) if x[1] == "mmap"]
+        if os.access("/proc/self/map_files", os.R_OK):
+            self.assertEqual(ret, [(-1, "mmap")])
+        else:
+            self.assertEqual(ret, [])
+
+    def test_cwd_root_exe(self):
+        self.assertIn((-1, "cwd"), self.mine(os.getcwd()))
+        self.assertIn((-1, "root"), self.mine("/"))
+        self.assertIn((-1, "exe"), self.mine(psutil.Process().exe()))
+
+    def test_mount(self):
+        testfn = self.get_testfn()
+        mount = os.path.realpath(testfn)
+        while not os.path.ismount(mount):
+            mount = os.path.dirname(mount)
+        f = open(testfn, "wb")
+        self.addCleanup(f.close)
+        os.remove(testfn)
+        # deleted files are still found by mount point
+        ret = [x for x in psutil.file_users(mount)
+               if x.pid == os.getpid() and x.fd == f.fileno()]
+        self.assertEqual(len(ret), 1)
+        self.assertTrue(ret[0].path.endswith(" (deleted)"), ret[0].path)
+
+    def test_not_found(self):
+        self.assertRaises(FileNotFoundError, psutil.file_users,
+                          self.get_testfn())
+
+    def test_cext(self):
+        cext = psutil._psplatform.cext
+        procfs = psutil._pslinux.get_procfs_path()
+        testfn = self.get_testfn()
+        with open(testfn, "wb") as f:
+            st = os.fstat(f.fileno())
+            ret = cext.linux_file_users(procfs, st.st_dev, st.st_ino, 0)
+            self.assertIn((os.getpid(), f.fileno(), "fd",
+                           os.path.realpath(testfn)), ret)
+        self.assertRaises(FileNotFoundError, cext.linux_file_users,
+                          self.get_testfn(), st.st_dev, st.st_ino, 0)
+
+
 # =====================================================================
 # --- system disks
 # =====================================================================
@@ -1196,6 +2116,21 @@ class TestSystemDiskPartitions(PsutilTestCase):
 @unittest.skipIf(not LINUX, "LINUX only")
 class TestSystemDiskIoCounters(PsutilTestCase):
 
+    def test_filters(self):
+        content = textwrap.dedent("""\
+               3    0   hda 1 2 3 4 5 6 7 8 9 10 11
+               3    1   hda1 1 2 3 4
+               7    0   loop0 x x x x x x x x x x x
+            """)
+        with mock_open_content('/proc/diskstats', content):
+            ret = psutil.disk_io_counters(perdisk=True, nowrap=False,
+                                          exclude="loop*")
+            self.assertEqual(sorted(ret), ["hda", "hda1"])
+            ret = psutil.disk_io_counters(perdisk=True, nowrap=False,
+                                          include=re.compile(r"\d$"),
+                                          exclude="loop*")
+            self.assertEqual(list(ret), ["hda1"])
+
     def test_emulate_kernel_2_4(self):
         # Tests /proc/diskstats parsing format for 2.4 kernels, see:
         # https://github.com/giampaolo/psutil/issues/767
@@ -1363,13 +2298,17 @@ class TestRootFsDeviceFinder(PsutilTestCase):
             b = finder.ask_sys_class_block()
         c = finder.ask_sys_dev_block()
 
-        base = a or b or c
+        d = finder.ask_block_topology()
+
+        base = a or b or c or d
         if base and a:
             self.assertEqual(base, a)
         if base and b:
             self.assertEqual(base, b)
         if base and c:
             self.assertEqual(base, c)
+        if base and d:
+            self.assertEqual(base, d)
 
     @unittest.skipIf(not which("findmnt"), "findmnt utility not available")
     @unittest.skipIf(GITHUB_ACTIONS, "unsupported on GITHUB_ACTIONS")
@@ -1391,6 +2330,180 @@ class TestRootFsDeviceFinder(PsutilTestCase):
                 self.assertEqual(part.device, "/dev/root")
 
 
+@unittest.skipIf(not LINUX, "LINUX only")
+class TestBlockTopology(PsutilTestCase):
+
+    def new_topology(self):
+        topo = BlockTopology()
+        self.addCleanup(topo.close)
+        return topo
+
+    def fake_topology(self):
+        # sda1 and sdb1 are part of an MD RAID 1 (md0) which hosts an LVM
+        # volume (dm-0); sdc has no partitions
+        topo = self.new_topology()
+        # pretend uevents are not available and nothing changed
+        topo._sock_pid = os.getpid()
+        topo._topo = psutil._pslinux._blocktopo(
+            disks=set(["sda", "sdb", "sdc", "md0", "dm-0"]),
+            partitions={"sda1": "sda", "sdb1": "sdb"},
+            devnos={(8, 1): "sda1", (253, 0): "dm-0"},
+            slaves={"md0": ["sda1", "sdb1"], "dm-0": ["md0"]},
+            generation=topo._generation())
+        return topo
+
+    def test_disks(self):
+        topo = self.new_topology().get()
+        self.assertEqual(
+            topo.disks,
+            set(x.replace('!', '/') for x in os.listdir("/sys/block")))
+        for part, disk in topo.partitions.items():
+            self.assertIn(disk, topo.disks)
+            assert os.path.exists("/sys/block/%s/%s" % (
+                disk.replace('/', '!'), part.replace('/', '!')))
+
+    def test_devnos(self):
+        topo = self.new_topology().get()
+        self.assertEqual(set(topo.devnos.values()),
+                         topo.disks | set(topo.partitions))
+        with open("/proc/partitions") as f:
+            for line in f.readlines()[2:]:
+                major, minor, _, name = line.split()
+                self.assertEqual(topo.devnos[(int(major), int(minor))], name)
+
+    def test_is_storage_device(self):
+        topo = self.new_topology().get()
+        for name in topo.disks:
+            assert psutil._pslinux.is_storage_device(name), name
+        for name in topo.partitions:
+            assert not psutil._pslinux.is_storage_device(name), name
+
+    def test_physical_disks(self):
+        topo = self.fake_topology()
+        self.assertEqual(topo.physical_disks("dm-0"), ["sda", "sdb"])
+        self.assertEqual(topo.physical_disks("md0"), ["sda", "sdb"])
+        self.assertEqual(topo.physical_disks("sda1"), ["sda"])
+        self.assertEqual(topo.physical_disks("sdc"), ["sdc"])
+        self.assertEqual(topo.physical_disks("foo"), [])
+
+    def test_lookup_miss(self):
+        # unknown names trigger a refresh, but only once
+        topo = self.fake_topology()
+        with mock.patch.object(topo, "_scan",
+                               return_value=(set(), {}, {}, {})) as m:
+            self.assertIsNone(topo.is_disk("sdz"))
+            self.assertIsNone(topo.is_disk("sdz"))
+            self.assertEqual(m.call_count, 1)
+            self.assertIsNone(topo.name_from_devno(8, 100))
+            self.assertEqual(m.call_count, 2)
+            # negative entries survive refreshes which change nothing
+            for x in range(10):
+                self.assertIsNone(topo.is_disk("sdz"))
+                self.assertIsNone(topo.is_disk("sdy"))
+            self.assertEqual(m.call_count, 3)
+        # ...but not a topology change
+        with mock.patch.object(topo, "_scan",
+                               return_value=(set(["sdz"]), {}, {}, {})) as m:
+            topo.refresh()
+            self.assertTrue(topo.is_disk("sdz"))
+            self.assertIsNone(topo.is_disk("sdy"))
+            self.assertEqual(m.call_count, 2)
+
+    def test_no_sysfs(self):
+        topo = self.new_topology()
+        with mock.patch("psutil._pslinux._block_topology", topo):
+            with mock.patch("os.listdir",
+                            side_effect=FileNotFoundError) as m1:
+                self.assertEqual(topo.get()[:4], (set(), {}, {}, {}))
+                with mock.patch("os.access", return_value=True) as m2:
+                    assert psutil._pslinux.is_storage_device("sda")
+                assert m1.called
+                m2.assert_called_once_with("/sys/block/sda", os.F_OK)
+
+    def test_uevent_invalidation(self):
+        topo = self.new_topology()
+        topo.get()
+        if topo._sock is None:
+            raise self.skipTest("uevents not available")
+        events = [b"add@/devices/virtual/net/veth0\0ACTION=add\0"
+                  b"SUBSYSTEM=net\0",
+                  b"add@/devices/virtual/block/loop9\0ACTION=add\0"
+                  b"SUBSYSTEM=block\0"]
+        topo._sock.close()
+        topo._sock = mock.Mock()
+        topo._sock.recv.side_effect = \
+            [events[0], socket.error(errno.EAGAIN, "")]
+        with mock.patch.object(topo, "refresh") as m:
+            topo.get()
+            assert not m.called
+        topo._sock.recv.side_effect = \
+            [events[0], events[1], socket.error(errno.EAGAIN, "")]
+        with mock.patch.object(topo, "refresh") as m:
+            topo.get()
+            assert m.called
+        # queue overflow
+        topo._sock.recv.side_effect = socket.error(errno.ENOBUFS, "")
+        with mock.patch.object(topo, "refresh") as m:
+            topo.get()
+            assert m.called
+
+    def test_uevents_never_received(self):
+        # containers with their own netns: the socket works but the
+        # kernel never sends events to it
+        topo = self.new_topology()
+        topo.get()
+        if topo._sock is not None:
+            topo._sock.close()
+        topo._sock = mock.Mock()
+        topo._sock.recv.side_effect = socket.error(errno.EAGAIN, "")
+        with mock.patch.object(topo, "refresh") as m:
+            topo.get()
+            assert not m.called
+        with mock.patch.object(topo, "_generation", return_value=b"x"):
+            with mock.patch.object(topo, "refresh") as m:
+                topo.get()
+                assert m.called
+
+    def test_generation_invalidation(self):
+        # no uevents: /proc/partitions content is used
+        topo = self.new_topology()
+        with mock.patch.object(topo, "_open_socket", return_value=None):
+            topo.get()
+        self.assertIsNone(topo._sock)
+        with mock.patch.object(topo, "refresh") as m:
+            topo.get()
+            assert not m.called
+        with mock.patch.object(topo, "_generation", return_value=b"x"):
+            with mock.patch.object(topo, "refresh") as m:
+                topo.get()
+                assert m.called
+
+    def test_disk_mount_disks(self):
+        ret = psutil.disk_mount_disks(all=True)
+        perdisk = psutil.disk_io_counters(perdisk=True)
+        topo = self.new_topology().get()
+        for mountpoint, disks in ret.items():
+            for disk in disks:
+                self.assertIn(disk, topo.disks)
+                if perdisk:
+                    self.assertIn(disk, perdisk)
+        part = psutil.disk_partitions()
+        if part and part[0].device.startswith("/dev/"):
+            self.assertIn(part[0].mountpoint, ret)
+
+    def test_disk_mount_disks_mocked(self):
+        topo = self.fake_topology()
+        st = mock.Mock(st_mode=stat.S_IFBLK, st_rdev=os.makedev(253, 0))
+        parts = [psutil._common.sdiskpart(
+            "/dev/mapper/vg-root", "/", "ext4", "rw", 255, 4096)]
+        with mock.patch("psutil._pslinux._block_topology", topo):
+            with mock.patch("psutil._pslinux.disk_partitions",
+                            return_value=parts):
+                with mock.patch("os.stat", return_value=st):
+                    self.assertEqual(psutil.disk_mount_disks(),
+                                     {"/": ["sda", "sdb"]})
+
+
 # =====================================================================
 # --- misc
 # =====================================================================
@@ -1404,6 +2517,11 @@ class TestMisc(PsutilTestCase):
         psutil_value = psutil.boot_time()
         self.assertEqual(int(vmstat_value), int(psutil_value))
 
+    def test_boot_id(self):
+        with open("/proc/sys/kernel/random/boot_id") as f:
+            self.assertEqual(psutil._pslinux.boot_id(), f.read().strip())
+        self.assertEqual(psutil._pslinux.boot_id(), psutil._boot_id())
+
     def test_no_procfs_on_import(self):
         my_procfs = self.get_testfn()
         os.mkdir(my_procfs)
@@ -1569,6 +2687,35 @@ class TestMisc(PsutilTestCase):
             pt.as_dict()
             self.assertNotIn(tid, psutil.pids())
 
+    def test_pids(self):
+        pids = sorted(int(x) for x in os.listdir("/proc") if x.isdigit())
+        self.assertEqual(psutil._psplatform.pids(), pids)
+        arr = psutil._psplatform.pids_array()
+        self.assertEqual(arr.typecode, 'i')
+        self.assertEqual(arr.tolist(), pids)
+
+    def test_pids_custom_procfs_path(self):
+        tdir = self.get_testfn()
+        os.mkdir(tdir)
+        for name in ("1", "10", "2", "self", "1a", "0x1", "007"):
+            os.mkdir(os.path.join(tdir, name))
+        with mock.patch("psutil._pslinux.get_procfs_path",
+                        return_value=tdir):
+            self.assertEqual(psutil._psplatform.pids(), [1, 2, 10])
+        with mock.patch("psutil._pslinux.get_procfs_path",
+                        return_value=tdir + "/foo"):
+            self.assertRaises(FileNotFoundError, psutil._psplatform.pids)
+
+    def test_pids_diff(self):
+        cext = psutil._psplatform.cext
+        cur = array.array('i', [1, 2, 5, 7, 9])
+        prev = array.array('i', [9, 3, 1, 3, 8])
+        new, gone = cext.linux_pids_diff(prev, cur)
+        self.assertEqual(array.array('i', new).tolist(), [2, 5, 7])
+        self.assertEqual(array.array('i', gone).tolist(), [3, 8])
+        self.assertEqual(cext.linux_pids_diff(cur, cur), (b"", b""))
+        self.assertRaises(ValueError, cext.linux_pids_diff, b"123", cur)
+
     def test_pid_exists_no_proc_status(self):
         # Internally pid_exists relies on /proc/{pid}/status.
         # Emulate a case where this file is empty in which case
@@ -1878,6 +3025,44 @@ class TestProcess(PsutilTestCase):
             self.assertEqual(pss, 3 * 1024)
             self.assertEqual(swap, 15 * 1024)
 
+    @retry_on_failure()
+    def test_memory_info_status(self):
+        p = psutil.Process()
+        mem = p.memory_info_status()
+        rss = p.memory_info().rss
+        self.assertAlmostEqual(
+            mem.rss_anon + mem.rss_file + mem.rss_shmem, rss,
+            delta=1024 * 1024)
+        self.assertGreaterEqual(mem.hwm, rss - 1024 * 1024)
+        self.assertAlmostEqual(
+            mem.swap, p.memory_full_info().swap, delta=1024 * 1024)
+
+    def test_memory_info_status_mocked(self):
+        # Linux < 4.5 (no RssAnon, RssFile, RssShmem lines)
+        with mock_open_content(
+            "/proc/%s/status" % os.getpid(),
+            textwrap.dedent("""\
+                Name:\tpython
+                VmPeak:\t  1000 kB
+                VmHWM:\t    800 kB
+                VmRSS:\t    700 kB
+                VmSwap:\t    12 kB
+                Threads:\t1
+                """).encode()) as m:
+            mem = psutil._pslinux.Process(os.getpid()).memory_info_status()
+            assert m.called
+        self.assertEqual(mem, psutil._pslinux.pmemstatus(
+            rss_anon=0, rss_file=0, rss_shmem=0, swap=12 * 1024,
+            hwm=800 * 1024))
+
+    def test_memory_info_status_oneshot(self):
+        p = psutil.Process()
+        with p.oneshot():
+            p.num_threads()
+            with mock.patch("psutil._pslinux.open_binary") as m:
+                p.memory_info_status()
+                assert not m.called
+
     # On PYPY file descriptors are not closed fast enough.
     @unittest.skipIf(PYPY, "unreliable on PYPY")
     def test_open_files_mode(self):
@@ -2034,30 +3219,117 @@ class TestProcess(PsutilTestCase):
         # which no longer exists by the time we open() it (race
         # condition). threads() is supposed to ignore that instead
         # of raising NSP.
-        def open_mock_1(name, *args, **kwargs):
-            if name.startswith('/proc/%s/task' % os.getpid()):
-                raise IOError(errno.ENOENT, "")
-            else:
-                return orig_open(name, *args, **kwargs)
+        def read_files_mock(paths):
+            return [errno.ENOENT for x in paths]
 
-        orig_open = open
-        patch_point = 'builtins.open' if PY3 else '__builtin__.open'
-        with mock.patch(patch_point, side_effect=open_mock_1) as m:
+        patch_point = 'psutil._pslinux.cext.linux_read_files'
+        with mock.patch(patch_point, side_effect=read_files_mock) as m:
             ret = psutil.Process().threads()
             assert m.called
             self.assertEqual(ret, [])
 
         # ...but if it bumps into something != ENOENT we want an
         # exception.
-        def open_mock_2(name, *args, **kwargs):
-            if name.startswith('/proc/%s/task' % os.getpid()):
-                raise IOError(errno.EPERM, "")
-            else:
-                return orig_open(name, *args, **kwargs)
+        def read_files_mock_2(paths):
+            return [errno.EPERM for x in paths]
 
-        with mock.patch(patch_point, side_effect=open_mock_2):
+        with mock.patch(patch_point, side_effect=read_files_mock_2):
             self.assertRaises(psutil.AccessDenied, psutil.Process().threads)
 
+    def test_sample_thread_states(self):
+        # a thread blocked reading from a pipe
+        r, w = os.pipe()
+        self.addCleanup(os.close, r)
+        self.addCleanup(os.close, w)
+        before = set(os.listdir("/proc/self/task"))
+        t = threading.Thread(target=os.read, args=(r, 1))
+        t.start()
+        try:
+            tid = call_until(
+                lambda: set(os.listdir("/proc/self/task")) - before,
+                "ret")
+            tid = list(tid)[0]
+            # wait until the thread is actually blocked in read()
+            syscall = call_until(
+                lambda: psutil._common.cat(
+                    "/proc/self/task/%s/syscall" % tid).split()[0],
+                "ret not in ('running', '-1')")
+            syscall = int(syscall)
+            with open("/proc/self/task/%s/wchan" % tid) as f:
+                wchan = f.read() or None
+            ret = psutil.Process().sample_thread_states(hz=100, duration=0.1)
+        finally:
+            os.write(w, b"x")
+            t.join()
+        self.assertAlmostEqual(sum(x.percent for x in ret), 100, delta=1)
+        for x in ret:
+            self.assertIn(x.status, VALID_PROC_STATUSES)
+            self.assertGreater(x.samples, 0)
+        # the calling thread is the one sampling
+        self.assertIn(psutil.STATUS_RUNNING, [x.status for x in ret])
+        blocked = [x for x in ret if x.syscall == syscall]
+        self.assertEqual(len(blocked), 1)
+        self.assertEqual(blocked[0].status, psutil.STATUS_SLEEPING)
+        self.assertEqual(blocked[0].wchan, wchan)
+        self.assertEqual(ret, sorted(ret, key=lambda x: x.samples,
+                                     reverse=True))
+
+    def test_sample_thread_states_cext(self):
+        cext = psutil._psplatform.cext
+        with ThreadTask():
+            nthreads = len(os.listdir("/proc/self/task"))
+            taken, hist = cext.linux_sample_thread_states(
+                "/proc/self/task", 5, 0.001)
+        self.assertEqual(taken, 5)
+        self.assertEqual(sum(x[3] for x in hist), 5 * nthreads)
+        for state, wchan, syscall, count in hist:
+            self.assertIn(chr(state), psutil._pslinux.PROC_STATUSES)
+            self.assertIsInstance(wchan, str)
+            self.assertGreaterEqual(syscall, -3)
+        self.assertRaises(FileNotFoundError,
+                          cext.linux_sample_thread_states,
+                          "/proc/0/task", 1, 0.1)
+
+    def test_sample_thread_states_errors(self):
+        p = psutil.Process()
+        self.assertRaises(ValueError, p.sample_thread_states, hz=0)
+        self.assertRaises(ValueError, p.sample_thread_states, duration=-1)
+        sproc = self.spawn_testproc()
+        proc = psutil.Process(sproc.pid)
+        proc.kill()
+        proc.wait()
+        self.assertRaises(psutil.NoSuchProcess, proc.sample_thread_states)
+
+    def test_sample_thread_states_not_in_as_dict(self):
+        self.assertNotIn("sample_thread_states", psutil.Process().as_dict())
+
+    def test_ns_pids(self):
+        with open("/proc/self/status") as f:
+            for line in f:
+                if line.startswith("NSpid:"):
+                    nspids = [int(x) for x in line.split()[1:]]
+                    break
+            else:
+                raise self.skipTest("NSpid not available")
+        ret = psutil.Process().ns_pids()
+        self.assertEqual(ret, nspids)
+        self.assertEqual(ret[0], os.getpid())
+
+    def test_ns_pids_mocked(self):
+        # Linux < 4.1
+        with mock_open_content(
+                "/proc/%s/status" % os.getpid(),
+                b"Name:\tpython\nPid:\t1\nPPid:\t0\n") as m:
+            self.assertRaises(NotImplementedError,
+                              psutil._pslinux.Process(os.getpid()).ns_pids)
+            assert m.called
+        with mock_open_content(
+                "/proc/%s/status" % os.getpid(),
+                b"Name:\tsleep\nNSpid:\t25098\t4\t1\nNSsid:\t1\n"):
+            self.assertEqual(
+                psutil._pslinux.Process(os.getpid()).ns_pids(),
+                [25098, 4, 1])
+
     def test_exe_mocked(self):
         with mock.patch('psutil._pslinux.readlink',
                         side_effect=OSError(errno.ENOENT, "")) as m1:
@@ -2213,6 +3485,170 @@ class TestProcess(PsutilTestCase):
                 assert not p.connections()
                 assert m.called
 
+    def test_cpu_affinity_mask(self):
+        p = psutil.Process()
+        mask = p.cpu_affinity_mask()
+        cpus = [x for x in range(mask.bit_length()) if mask & (1 << x)]
+        self.assertEqual(cpus, p.cpu_affinity())
+
+    def test_cpu_affinity_mask_size_cached(self):
+        # The kernel cpumask size discovered by the first call is
+        # reused by the following ones, for processes and threads.
+        get_mask = psutil._psplatform.cext.proc_cpu_affinity_get_mask
+        data = get_mask(os.getpid())
+        self.assertEqual(len(data) % struct.calcsize("l"), 0)
+        with ThreadTask():
+            for tid in os.listdir("/proc/self/task"):
+                self.assertEqual(get_mask(int(tid)), data)
+
+
+@unittest.skipIf(not LINUX, "LINUX only")
+class TestProcessWorkingSet(PsutilTestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.pfns_available = False
+        if os.geteuid() == 0:
+            cext = psutil._psplatform.cext
+            pfns, present = cext.linux_pagemap_pfns(
+                "/proc/self/maps", "/proc/self/pagemap")
+            cls.pfns_available = bool(pfns)
+
+    def spawn_allocator(self, busy):
+        # allocate 64M and keep on touching them (if busy) or sleep
+        src = textwrap.dedent("""
+            import time
+            buf = bytearray(64 * 1024 * 1024)
+            while True:
+                for i in range(0, len(buf), 4096):
+                    buf[i] = 1
+                if not %s:
+                    time.sleep(60)
+            """ % busy)
+        sproc = self.pyrun(src)
+        p = psutil.Process(sproc.pid)
+        call_until(lambda: p.memory_info().rss,
+                   "ret >= 64 * 1024 * 1024")
+        return p
+
+    def test_not_in_as_dict(self):
+        # it blocks and has side effects
+        self.assertNotIn("working_set", psutil.Process().as_dict())
+        self.assertRaises(ValueError, psutil.Process().as_dict,
+                          ["working_set"])
+
+    def test_pagemap_pfns(self):
+        cext = psutil._psplatform.cext
+        pfns, present = cext.linux_pagemap_pfns(
+            "/proc/self/maps", "/proc/self/pagemap")
+        assert present > 0
+        self.assertEqual(len(pfns) % 8, 0)
+        pfns = struct.unpack("%sQ" % (len(pfns) // 8), pfns)
+        self.assertEqual(list(pfns), sorted(set(pfns)))
+        assert len(pfns) <= present
+        if self.pfns_available:
+            assert 0 not in pfns
+        else:
+            self.assertEqual(pfns, ())
+
+    def test_pagemap_pfns_nsp(self):
+        cext = psutil._psplatform.cext
+        with self.assertRaises(OSError) as cm:
+            cext.linux_pagemap_pfns("/proc/0/maps", "/proc/0/pagemap")
+        self.assertEqual(cm.exception.errno, errno.ENOENT)
+
+    def test_page_idle_fake_bitmap(self):
+        cext = psutil._psplatform.cext
+        pfns = [1, 63, 64, 200, 1000, 100000]
+        data = struct.pack("%sQ" % len(pfns), *pfns)
+        testfn = self.get_testfn()
+        with open(testfn, "wb"):
+            pass
+        cext.linux_page_idle_mark(testfn, data)
+        with open(testfn, "rb") as f:
+            words = f.read()
+        for pfn in pfns:
+            word = struct.unpack("Q", words[pfn // 64 * 8:pfn // 64 * 8 + 8])
+            assert word[0] & (1 << (pfn % 64)), pfn
+        self.assertEqual(cext.linux_page_idle_count(testfn, data), 0)
+        # simulate access to PFN 63 and 64 (2 different words)
+        with open(testfn, "r+b") as f:
+            f.write(struct.pack("Q", 1 << 1))
+            f.write(struct.pack("Q", 0))
+        self.assertEqual(cext.linux_page_idle_count(testfn, data), 2)
+        # PFNs past the end of the bitmap are considered idle
+        self.assertEqual(cext.linux_page_idle_count(
+            testfn, struct.pack("Q", 10 ** 9)), 0)
+        self.assertRaises(ValueError, cext.linux_page_idle_count,
+                          testfn, b"x")
+        with self.assertRaises(OSError) as cm:
+            cext.linux_page_idle_mark(testfn + "-none", data)
+        self.assertEqual(cm.exception.errno, errno.ENOENT)
+
+    @retry_on_failure()
+    def test_clear_refs(self):
+        busy = self.spawn_allocator(True)
+        idle = self.spawn_allocator(False)
+        mb64 = 64 * 1024 * 1024
+        self.assertGreater(busy.working_set(0.5, method="clear_refs"),
+                           mb64 * 0.9)
+        self.assertLess(idle.working_set(0.5, method="clear_refs"),
+                        mb64 * 0.5)
+        ret = psutil.working_set_many(
+            [busy.pid, idle.pid, self.spawn_testproc().pid], 0.5,
+            method="clear_refs")
+        self.assertEqual(len(ret), 3)
+        self.assertGreater(ret[busy.pid], mb64 * 0.9)
+        self.assertLess(ret[idle.pid], mb64 * 0.5)
+
+    def test_page_idle_fake_bitmap_api(self):
+        testfn = self.get_testfn()
+        with open(testfn, "wb"):
+            pass
+        p = psutil.Process()
+        with mock.patch("psutil._pslinux.PAGE_IDLE_BITMAP", testfn):
+            if not self.pfns_available:
+                self.assertRaises(psutil.AccessDenied, p.working_set, 0,
+                                  method="page_idle")
+                return
+            ret = p.working_set(0, method="page_idle")
+        # pages are never accessed for real, but the ones faulted in
+        # while sleeping are not in the bitmap
+        self.assertEqual(ret % psutil._pslinux.PAGESIZE, 0)
+        self.assertLess(ret, p.memory_info().rss)
+        assert os.path.getsize(testfn) > 0
+
+    def test_page_idle_not_available(self):
+        p = psutil.Process()
+        with mock.patch("psutil._pslinux.PAGE_IDLE_BITMAP", "/dev/foo"):
+            self.assertRaises(NotImplementedError, p.working_set, 0,
+                              method="page_idle")
+            with mock.patch("psutil._pslinux._clear_refs") as m:
+                p.working_set(0)
+                assert m.called
+
+    def test_working_set_many_errors(self):
+        sproc = self.spawn_testproc()
+        pids = [os.getpid(), sproc.pid]
+        with mock.patch("psutil._pslinux._clear_refs",
+                        side_effect=PermissionError(errno.EACCES, "")):
+            self.assertEqual(psutil.working_set_many(
+                pids, 0, method="clear_refs"), {})
+            self.assertRaises(psutil.AccessDenied,
+                              psutil.Process().working_set, 0,
+                              method="clear_refs")
+        sproc.terminate()
+        sproc.wait()
+        ret = psutil.working_set_many(pids, 0, method="clear_refs")
+        self.assertEqual(list(ret), [os.getpid()])
+
+    def test_invalid_args(self):
+        p = psutil.Process()
+        self.assertRaises(ValueError, p.working_set, 0, method="foo")
+        self.assertRaises(ValueError, p.working_set, -1)
+        self.assertRaises(ValueError, psutil.working_set_many, [], -1)
+        self.assertEqual(psutil.working_set_many([], 0), {})
+
 
 @unittest.skipIf(not LINUX, "LINUX only")
 class TestProcessAgainstStatus(PsutilTestCase):
@@ -2291,6 +3727,293 @@ class TestProcessAgainstStatus(PsutilTestCase):
         else:
             assert m.called
 
+    def test_oneshot_many_prefetch(self):
+        # stat, status and statm files are read once, in one go
+        p1 = psutil.Process()
+        p2 = psutil.Process(os.getppid())
+        with psutil.oneshot_many([p1, p2]):
+            with mock.patch("psutil._pslinux.bcat") as m1:
+                with mock.patch("psutil._pslinux.open_binary") as m2:
+                    for p in (p1, p2):
+                        p.name()
+                        p.ppid()
+                        p.status()
+                        p.num_threads()
+                        p.memory_info()
+                        p.uids()
+            assert not m1.called
+            assert not m2.called
+            self.assertEqual(p1.memory_info(), p1._proc.memory_info())
+        self.assertEqual(p1.name(), p1._proc.name())
+
+    def test_read_files(self):
+        cext = psutil._psplatform.cext
+        path = ("/proc/%s/stat" % os.getpid()).encode()
+        data, err = cext.linux_read_files([path, b"/proc/foo/stat"])
+        with open(path, "rb") as f:
+            self.assertEqual(data.split()[:2], f.read().split()[:2])
+        self.assertEqual(err, errno.ENOENT)
+        self.assertEqual(cext.linux_read_files([]), [])
+        self.assertRaises(TypeError, cext.linux_read_files, [None])
+
+    def test_read_files_dirfd_and_fd(self):
+        cext = psutil._psplatform.cext
+        dirfd = os.open("/proc/%s" % os.getpid(), os.O_RDONLY)
+        self.addCleanup(os.close, dirfd)
+        fd = os.open("/proc/%s/cmdline" % os.getpid(), os.O_RDONLY)
+        self.addCleanup(os.close, fd)
+        stat, cmdline, err = cext.linux_read_files(
+            [(dirfd, b"stat"), fd, (dirfd, b"foo")])
+        self.assertEqual(int(stat.split()[0]), os.getpid())
+        self.assertEqual(cmdline.split(b"\0")[0],
+                         psutil.Process().cmdline()[0].encode())
+        self.assertEqual(err, errno.ENOENT)
+        # fds are read from offset 0 and left open
+        self.assertEqual(cext.linux_read_files([fd]), [cmdline])
+
+    def test_read_files_big(self):
+        # files bigger than the initial buffer, including seq_file
+        # based ones which are returned in chunks
+        cext = psutil._psplatform.cext
+        path = ("/proc/%s/smaps" % os.getpid()).encode()
+        with open(__file__, "rb") as f:
+            expected = f.read()
+        assert len(expected) > 65536, len(expected)
+        data, smaps = cext.linux_read_files([__file__.encode(), path])
+        self.assertEqual(data, expected)
+        assert len(smaps) > 4096, len(smaps)
+        # make sure we got all the records, not just the first chunk
+        with open(path, "rb") as f:
+            self.assertEqual(smaps.splitlines()[-1],
+                             f.read().splitlines()[-1])
+
+    def test_read_files_many(self):
+        # more files than a single batch
+        cext = psutil._psplatform.cext
+        path = ("/proc/%s/status" % os.getpid()).encode()
+        ret = cext.linux_read_files([path] * 1000)
+        self.assertEqual(len(ret), 1000)
+        line = ("Pid:\t%d\n" % os.getpid()).encode()
+        for data in ret:
+            self.assertIn(line, data)
+
+    def test_read_files_io_uring(self):
+        # io_uring is opt-in; use a subprocess as its io-wq workers show
+        # up as threads of the calling process
+        code = textwrap.dedent("""
+            import os, psutil
+            cext = psutil._psplatform.cext
+            path = ("/proc/%d/status" % os.getpid()).encode()
+            paths = [path, b"/proc/foo/stat"] * 500 + [__file__.encode()]
+            for ret in (cext.linux_read_files(paths),
+                        cext.linux_read_files(paths, 1)):
+                line = ("Pid:\\t%d\\n" % os.getpid()).encode()
+                assert all(line in x for x in ret[:-1:2]), ret
+                assert ret[1:-1:2] == [2] * 500, ret
+            print(len(ret))
+            """).replace("__file__", repr(os.path.abspath(__file__)))
+        env = dict(PYTHON_EXE_ENV, PSUTIL_IO_URING="1")
+        self.assertEqual(sh([PYTHON_EXE, "-c", code], env=env), "1001")
+
+    def test_ppid_map(self):
+        ppids = psutil._psplatform.ppid_map()
+        self.assertEqual(ppids[os.getpid()], os.getppid())
+        with mock.patch("psutil._pslinux.cext.linux_read_files",
+                        side_effect=lambda paths: [errno.ENOENT] * len(paths)):
+            self.assertEqual(psutil._psplatform.ppid_map(), {})
+
+    def test_pid_namespace_map(self):
+        nspids = psutil.Process().ns_pids()
+        if len(nspids) > 1:
+            raise self.skipTest("running in a nested PID namespace")
+        pidns = os.stat("/proc/self/ns/pid").st_ino
+        ret = psutil.pid_namespace_map()
+        self.assertEqual(ret[(pidns, os.getpid())], os.getpid())
+        self.assertEqual(ret[(pidns, 1)], 1)
+        with mock.patch("psutil._pslinux.cext.linux_read_files",
+                        side_effect=lambda paths: [errno.ENOENT] * len(paths)):
+            self.assertEqual(psutil.pid_namespace_map(), {})
+
+    def test_pid_namespace_map_no_nspid(self):
+        # Linux < 4.1: fail before reading all status files
+        with mock.patch("psutil._pslinux._has_nspid", return_value=False):
+            with mock.patch("psutil._pslinux.cext.linux_read_files") as m:
+                self.assertRaises(NotImplementedError,
+                                  psutil.pid_namespace_map)
+                assert not m.called
+
+    @unittest.skipIf(not which("unshare"), "unshare not available")
+    @unittest.skipIf(os.geteuid() != 0, "root only")
+    def test_pid_namespace_map_nested(self):
+        # unshare forks "sleep" as PID 1 of a new PID namespace; it
+        # ignores SIGTERM while waiting for it
+        sproc = spawn_testproc(
+            ["unshare", "--pid", "--fork", "--kill-child", "sleep", "60"])
+        self.addCleanup(terminate, sproc, sig=signal.SIGKILL)
+        try:
+            child = call_until(lambda: psutil.Process(sproc.pid).children(),
+                               "ret")[0]
+            call_until(child.name, "ret == 'sleep'")
+        except psutil.NoSuchProcess:
+            raise self.skipTest("unshare failed (not permitted?)")
+        self.assertEqual(child.ns_pids(), [child.pid, 1])
+        pidns = os.stat("/proc/%s/ns/pid" % child.pid).st_ino
+        ret = psutil.pid_namespace_map()
+        self.assertEqual(ret[(pidns, 1)], child.pid)
+        # the child is also mapped in our namespace
+        ourns = os.stat("/proc/self/ns/pid").st_ino
+        self.assertEqual(ret[(ourns, child.pid)], child.pid)
+
+    def test_threads_batched_read(self):
+        with ThreadTask():
+            with mock.patch("psutil._pslinux.cext.linux_read_files",
+                            wraps=psutil._psplatform.cext.linux_read_files
+                            ) as m:
+                threads = psutil.Process().threads()
+            self.assertEqual(m.call_count, 1)
+            self.assertEqual(
+                sorted(x.id for x in threads),
+                sorted(int(x) for x in os.listdir("/proc/self/task")))
+
+
+@unittest.skipIf(not LINUX, "LINUX only")
+class TestExitAccountant(PsutilTestCase):
+
+    @staticmethod
+    def task(pid, name, tgid=None, status=0, utime=1000000, rss=1024,
+             read_bytes=0):
+        return (pid, pid if tgid is None else tgid, 1, 0, name, status,
+                1700000000, 2000000, utime, 500000, 10, 1, rss, 0, 0,
+                read_bytes, 0, 1, 2, 1000000000, 0, 0)
+
+    def test_real(self):
+        if os.geteuid() != 0:
+            raise self.skipTest("root only")
+        try:
+            acc = psutil.ExitAccountant()
+            acc.start()
+        except NotImplementedError:
+            raise self.skipTest("TASKSTATS not available")
+        self.addCleanup(acc.stop)
+        sproc = self.spawn_testproc(["sh", "-c", "exit 3"])
+        sproc.wait()
+        tasks = call_until(
+            acc.tasks, "[x for x in ret if x.pid == %s]" % sproc.pid)
+        task = [x for x in tasks if x.pid == sproc.pid][0]
+        self.assertEqual(task.name, "sh")
+        self.assertEqual(task.exitcode, 3)
+        self.assertEqual(task.ppid, os.getpid())
+        self.assertEqual(task.uid, os.getuid())
+        self.assertGreater(task.peak_rss, 0)
+        self.assertGreaterEqual(task.elapsed, 0)
+        self.assertAlmostEqual(task.create_time, time.time(), delta=60)
+        self.assertGreaterEqual(acc.summary()["sh"].processes, 1)
+        acc.stop()
+        acc.stop()  # no-op
+        # data is kept after stop()
+        self.assertIn(task, acc.tasks(reset=True))
+        self.assertEqual(acc.tasks(), [])
+
+    def test_read_bounded(self):
+        # a read returns also if notifications keep coming
+        if os.geteuid() != 0:
+            raise self.skipTest("root only")
+        cext = psutil._psplatform.cext
+        cpumask = psutil.ExitAccountant()._cpumask
+        try:
+            fd, family = cext.linux_taskstats_open(cpumask)
+        except OSError:
+            raise self.skipTest("TASKSTATS not available")
+        self.addCleanup(cext.linux_taskstats_close, fd, family, cpumask)
+        sh(["sh", "-c", "for i in $(seq 600); do /bin/true; done"])
+        counts = []
+        while True:
+            tasks, overruns = cext.linux_taskstats_read(fd, family, 0)
+            if not tasks and not overruns:
+                break
+            counts.append(len(tasks))
+        self.assertGreaterEqual(sum(counts), 600)
+        self.assertGreater(len(counts), 1)
+
+    def test_summary(self):
+        acc = psutil.ExitAccountant(cpus=[0], max_tasks=2)
+        acc._add([self.task(10, "make", utime=3000000, rss=4096),
+                  self.task(11, "cc", read_bytes=100),
+                  self.task(12, "cc", tgid=11, rss=2048, read_bytes=50),
+                  self.task(13, "cc", status=9)], 0)
+        acc._add([], 2)
+        self.assertEqual(acc.overruns, 2)
+        tasks = acc.tasks()
+        self.assertEqual([x.pid for x in tasks], [12, 13])
+        self.assertEqual(tasks[1].exitcode, -9)
+        self.assertEqual(tasks[0].tgid, 11)
+        self.assertEqual(tasks[0].elapsed, 2.0)
+        self.assertEqual(tasks[0].cpu_delay, 1.0)
+        ret = acc.summary(reset=True)
+        self.assertEqual(sorted(ret), ["cc", "make"])
+        self.assertEqual(ret["make"].processes, 1)
+        self.assertEqual(ret["make"].user, 3.0)
+        self.assertEqual(ret["make"].peak_rss, 4096 * 1024)
+        self.assertEqual(ret["cc"].processes, 2)
+        self.assertEqual(ret["cc"].threads, 3)
+        self.assertEqual(ret["cc"].user, 3.0)
+        self.assertEqual(ret["cc"].system, 1.5)
+        self.assertEqual(ret["cc"].peak_rss, 2048 * 1024)
+        self.assertEqual(ret["cc"].read_bytes, 150)
+        self.assertEqual(ret["cc"].cpu_delay, 3.0)
+        self.assertEqual(acc.summary(), {})
+
+    def test_cpumask(self):
+        acc = psutil.ExitAccountant(cpus=[0, 2])
+        with mock.patch("psutil._pslinux.cext.linux_taskstats_open",
+                        side_effect=PermissionError(errno.EPERM, "")) as m:
+            self.assertRaises(PermissionError, acc.start)
+            m.assert_called_once_with("0,2")
+        self.assertRaises(ValueError, psutil.ExitAccountant, cpus=[])
+        self.assertEqual(
+            psutil.ExitAccountant(cpus=range(100))._cpumask, "0-99")
+        self.assertEqual(
+            psutil.ExitAccountant(cpus=[7, 3, 1, 2, 3, 5])._cpumask,
+            "1-3,5,7")
+
+    def test_long_cpumask(self):
+        if os.geteuid() != 0:
+            raise self.skipTest("root only")
+        cext = psutil._psplatform.cext
+        try:
+            fd, family = cext.linux_taskstats_open("0")
+        except OSError:
+            raise self.skipTest("TASKSTATS not available")
+        cext.linux_taskstats_close(fd, family, "0")
+        # longer than the old fixed size request buffer
+        cpumask = ",".join(["0"] * 200)
+        fd, family = cext.linux_taskstats_open(cpumask)
+        cext.linux_taskstats_close(fd, family, cpumask)
+        # the error ack echoes the request back
+        with self.assertRaises(OSError) as cm:
+            cext.linux_taskstats_open("0-" + "9" * 300)
+        self.assertNotEqual(cm.exception.errno, errno.EBADMSG)
+
+    def test_not_implemented(self):
+        acc = psutil.ExitAccountant()
+        with mock.patch("psutil._pslinux.cext.linux_taskstats_open",
+                        side_effect=OSError(errno.ENOENT, "")):
+            self.assertRaises(NotImplementedError, acc.start)
+
+    def test_read_error(self):
+        acc = psutil.ExitAccountant()
+        cext = psutil._psplatform.cext
+        with mock.patch.object(cext, "linux_taskstats_open",
+                               return_value=(-1, 0)):
+            with mock.patch.object(cext, "linux_taskstats_read",
+                                   side_effect=OSError(errno.EBADF, "")):
+                with mock.patch.object(cext, "linux_taskstats_close") as m:
+                    with acc:
+                        acc._thread.join()
+                        self.assertRaises(OSError, acc.summary)
+                        self.assertEqual(acc.summary(), {})
+                    m.assert_called_once_with(-1, 0, acc._cpumask)
+
 
 # =====================================================================
 # --- test utils
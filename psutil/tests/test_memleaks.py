@@ -33,13 +33,22 @@ from psutil import WINDOWS
 from psutil._compat import ProcessLookupError
 from psutil._compat import super
 from psutil.tests import HAS_CPU_AFFINITY
+from psutil.tests import HAS_CPU_AFFINITY_HISTOGRAM
+from psutil.tests import HAS_CPU_AFFINITY_MASK
 from psutil.tests import HAS_CPU_FREQ
+from psutil.tests import HAS_DISK_MOUNT_DISKS
 from psutil.tests import HAS_ENVIRON
 from psutil.tests import HAS_IONICE
+from psutil.tests import HAS_KERNEL_MEMORY
+from psutil.tests import HAS_MEMORY_INFO_STATUS
 from psutil.tests import HAS_MEMORY_MAPS
 from psutil.tests import HAS_NET_IO_COUNTERS
+from psutil.tests import HAS_PID_NAMESPACE_MAP
 from psutil.tests import HAS_PROC_CPU_NUM
 from psutil.tests import HAS_PROC_IO_COUNTERS
+from psutil.tests import HAS_PROC_NS_PIDS
+from psutil.tests import HAS_PROC_SAMPLE_THREAD_STATES
+from psutil.tests import HAS_PROC_WORKING_SET
 from psutil.tests import HAS_RLIMIT
 from psutil.tests import HAS_SENSORS_BATTERY
 from psutil.tests import HAS_SENSORS_FANS
@@ -199,6 +208,16 @@ class TestProcessObjectLeaks(TestMemoryLeak):
     def test_memory_full_info(self):
         self.execute(self.proc.memory_full_info)
 
+    @unittest.skipIf(not HAS_MEMORY_INFO_STATUS, "not supported")
+    @fewtimes_if_linux()
+    def test_memory_info_status(self):
+        self.execute(self.proc.memory_info_status)
+
+    @unittest.skipIf(not HAS_PROC_NS_PIDS, "not supported")
+    @fewtimes_if_linux()
+    def test_ns_pids(self):
+        self.execute(self.proc.ns_pids)
+
     @unittest.skipIf(not POSIX, "POSIX only")
     @fewtimes_if_linux()
     def test_terminal(self):
@@ -223,6 +242,10 @@ class TestProcessObjectLeaks(TestMemoryLeak):
         self.execute_w_exc(
             ValueError, lambda: self.proc.cpu_affinity([-1]))
 
+    @unittest.skipIf(not HAS_CPU_AFFINITY_MASK, "not supported")
+    def test_cpu_affinity_mask(self):
+        self.execute(self.proc.cpu_affinity_mask)
+
     @fewtimes_if_linux()
     def test_open_files(self):
         with open(get_testfn(), 'w'):
@@ -233,6 +256,16 @@ class TestProcessObjectLeaks(TestMemoryLeak):
     def test_memory_maps(self):
         self.execute(self.proc.memory_maps)
 
+    @unittest.skipIf(not HAS_PROC_WORKING_SET, "not supported")
+    @fewtimes_if_linux()
+    def test_working_set(self):
+        self.execute(lambda: self.proc.working_set(0))
+
+    @unittest.skipIf(not HAS_PROC_SAMPLE_THREAD_STATES, "not supported")
+    @fewtimes_if_linux()
+    def test_sample_thread_states(self):
+        self.execute(lambda: self.proc.sample_thread_states(duration=0))
+
     @unittest.skipIf(not LINUX, "LINUX only")
     @unittest.skipIf(not HAS_RLIMIT, "not supported")
     def test_rlimit(self):
@@ -364,6 +397,11 @@ class TestModuleFunctionsLeaks(TestMemoryLeak):
     def test_cpu_stats(self):
         self.execute(psutil.cpu_stats)
 
+    @fewtimes_if_linux()
+    @unittest.skipIf(not LINUX, "LINUX only")
+    def test_cpu_sched_stats(self):
+        self.execute(lambda: psutil.cpu_sched_stats(percpu=True))
+
     @fewtimes_if_linux()
     # TODO: remove this once 1892 is fixed
     @unittest.skipIf(MACOS and platform.machine() == 'arm64',
@@ -372,6 +410,12 @@ class TestModuleFunctionsLeaks(TestMemoryLeak):
     def test_cpu_freq(self):
         self.execute(psutil.cpu_freq)
 
+    @fewtimes_if_linux()
+    @unittest.skipIf(not HAS_CPU_AFFINITY_HISTOGRAM, "not supported")
+    def test_cpu_affinity_histogram(self):
+        self.execute(lambda: psutil.cpu_affinity_histogram(
+            pids=[os.getpid()]))
+
     @unittest.skipIf(not WINDOWS, "WINDOWS only")
     def test_getloadavg(self):
         psutil.getloadavg()
@@ -387,10 +431,35 @@ class TestModuleFunctionsLeaks(TestMemoryLeak):
     def test_swap_memory(self):
         self.execute(psutil.swap_memory)
 
+    @fewtimes_if_linux()
+    @unittest.skipIf(not HAS_KERNEL_MEMORY, "not supported")
+    def test_kernel_memory(self):
+        self.execute(psutil.kernel_memory)
+
+    @fewtimes_if_linux()
+    @unittest.skipIf(not LINUX, "LINUX only")
+    def test_vm_events(self):
+        self.execute(psutil.vm_events)
+
+    @fewtimes_if_linux()
+    @unittest.skipIf(not LINUX, "LINUX only")
+    def test_vm_events_sampler(self):
+        self.execute(psutil.VmEventsSampler().sample)
+
     def test_pid_exists(self):
         times = FEW_TIMES if POSIX else self.times
         self.execute(lambda: psutil.pid_exists(os.getpid()), times=times)
 
+    @unittest.skipIf(not HAS_PID_NAMESPACE_MAP, "not supported")
+    @fewtimes_if_linux()
+    def test_pid_namespace_map(self):
+        self.execute(psutil.pid_namespace_map)
+
+    @fewtimes_if_linux()
+    @unittest.skipIf(not LINUX, "LINUX only")
+    def test_file_users(self):
+        self.execute(lambda: psutil.file_users(os.getcwd()))
+
     # --- disk
 
     def test_disk_usage(self):
@@ -400,6 +469,11 @@ class TestModuleFunctionsLeaks(TestMemoryLeak):
     def test_disk_partitions(self):
         self.execute(psutil.disk_partitions)
 
+    @fewtimes_if_linux()
+    @unittest.skipIf(not HAS_DISK_MOUNT_DISKS, "not supported")
+    def test_disk_mount_disks(self):
+        self.execute(lambda: psutil.disk_mount_disks(all=True))
+
     @unittest.skipIf(LINUX and not os.path.exists('/proc/diskstats'),
                      '/proc/diskstats not available on this Linux version')
     @fewtimes_if_linux()
@@ -412,6 +486,10 @@ class TestModuleFunctionsLeaks(TestMemoryLeak):
     def test_pids(self):
         self.execute(psutil.pids)
 
+    def test_pids_since(self):
+        pids = psutil.pids()
+        self.execute(lambda: psutil.pids_since(pids))
+
     # --- net
 
     @fewtimes_if_linux()
@@ -427,6 +505,13 @@ class TestModuleFunctionsLeaks(TestMemoryLeak):
         with create_sockets():
             self.execute(lambda: psutil.net_connections(kind='all'))
 
+    @fewtimes_if_linux()
+    @unittest.skipIf(not LINUX, "LINUX only")
+    def test_port_owners(self):
+        with create_sockets() as socks:
+            port = socks[0].getsockname()[1]  # AF_INET, SOCK_STREAM
+            self.execute(lambda: psutil.port_owners(port, proto="inet"))
+
     def test_net_if_addrs(self):
         # Note: verified that on Windows this was a false positive.
         tolerance = 80 * 1024 if WINDOWS else self.tolerance
@@ -458,12 +543,43 @@ class TestModuleFunctionsLeaks(TestMemoryLeak):
     def test_boot_time(self):
         self.execute(psutil.boot_time)
 
+    @fewtimes_if_linux()
+    def test_collect(self):
+        self.execute(lambda: psutil.collect(
+            ["cpu_times", "cpu_stats", "boot_time", "virtual_memory"]))
+
     def test_users(self):
         self.execute(psutil.users)
 
     def test_set_debug(self):
         self.execute(lambda: psutil._set_debug(False))
 
+    @unittest.skipIf(not LINUX, "LINUX only")
+    def test_linux_read_files(self):
+        path = "/proc/%s/stat" % os.getpid()
+        paths = [path.encode(), b"/proc/foo/stat"]
+        self.execute(lambda: cext.linux_read_files(paths))
+        # batched, dirfd relative and already opened fds
+        self.execute(lambda: cext.linux_read_files(paths * 100))
+        dirfd = os.open("/proc/%s" % os.getpid(), os.O_RDONLY)
+        self.addCleanup(os.close, dirfd)
+        self.execute(lambda: cext.linux_read_files(
+            [(dirfd, b"stat"), (dirfd, b"foo"), dirfd]))
+        self.execute_w_exc(TypeError, lambda: cext.linux_read_files([None]))
+
+    @unittest.skipIf(not LINUX, "LINUX only")
+    def test_linux_pids(self):
+        self.execute(lambda: cext.linux_pids("/proc"))
+        self.execute_w_exc(OSError, lambda: cext.linux_pids("/foo"))
+
+    @unittest.skipIf(not LINUX, "LINUX only")
+    def test_linux_pids_diff(self):
+        cur = psutil._psplatform.pids_array()
+        prev = cur[::2]
+        self.execute(lambda: cext.linux_pids_diff(prev, cur))
+        self.execute_w_exc(
+            ValueError, lambda: cext.linux_pids_diff(b"x", cur))
+
     if WINDOWS:
 
         # --- win services
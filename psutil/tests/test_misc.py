@@ -15,8 +15,10 @@ import errno
 import json
 import os
 import pickle
+import re
 import socket
 import stat
+import textwrap
 import unittest
 
 import psutil
@@ -285,6 +287,52 @@ class TestMisc(PsutilTestCase):
             self.assertIn("version conflict", str(cm.exception).lower())
 
 
+class TestImport(PsutilTestCase):
+    """Importing psutil should be cheap, as it's done over and over
+    again by short-lived scripts.
+    """
+
+    def run_python(self, src):
+        return sh([PYTHON_EXE, "-c", textwrap.dedent(src)],
+                  env=PYTHON_EXE_ENV)
+
+    def test_import_time(self):
+        # Import psutil in 5 fresh interpreters and fail only if the
+        # median is exceptionally slow. For the actual numbers see
+        # "make print-import-time".
+        src = """
+            import time
+            t = time.time()
+            import psutil
+            print(time.time() - t)
+            """
+        times = sorted(float(self.run_python(src)) for x in range(5))
+        median = times[len(times) // 2]
+        self.assertLess(median, 1.0)
+
+    @unittest.skipIf(not LINUX, "LINUX only")
+    def test_import_no_fs_reads(self):
+        # Make sure no /proc or /sys file is read at import time.
+        src = """
+            try:
+                import builtins
+            except ImportError:
+                import __builtin__ as builtins
+            orig_open = builtins.open
+            opened = []
+
+            def open(name, *args, **kwargs):
+                opened.append(name)
+                return orig_open(name, *args, **kwargs)
+
+            builtins.open = open
+            import psutil
+            builtins.open = orig_open
+            print([x for x in opened if str(x).startswith(("/proc", "/sys"))])
+            """
+        self.assertEqual(self.run_python(src), "[]")
+
+
 # ===================================================================
 # --- psutil/_common.py utils
 # ===================================================================
@@ -429,6 +477,26 @@ class TestMemoizeDecorator(PsutilTestCase):
 
 class TestCommonModule(PsutilTestCase):
 
+    def test_name_filter(self):
+        from psutil._common import name_filter
+        self.assertIsNone(name_filter())
+        match = name_filter(include="eth*")
+        self.assertTrue(match("eth0"))
+        self.assertFalse(match("veth0"))
+        match = name_filter(include=["eth*", "lo"], exclude="eth1")
+        self.assertTrue(match("lo"))
+        self.assertTrue(match("eth0"))
+        self.assertFalse(match("eth1"))
+        self.assertFalse(match("lo0"))
+        match = name_filter(exclude=[re.compile("^dm-"), "loop*"])
+        self.assertTrue(match("sda"))
+        self.assertFalse(match("dm-0"))
+        self.assertFalse(match("loop1"))
+        # regexes are searched
+        self.assertFalse(name_filter(exclude=re.compile(r"\d"))("sda1"))
+        self.assertRaises(TypeError, name_filter, include=1)
+        self.assertRaises(TypeError, name_filter, exclude=[None])
+
     def test_memoize_when_activated(self):
         class Foo:
 
@@ -787,6 +855,14 @@ class TestWrapNumbers(PsutilTestCase):
         wrap_numbers.cache_clear('disk_io')
         wrap_numbers.cache_clear('?!?')
 
+    def test_cache_clear_filtered(self):
+        input = {'disk1': nt(5, 5, 5)}
+        wrap_numbers(input, 'disk_io')
+        wrap_numbers(input, 'disk_io:foo')
+        wrap_numbers(input, 'disk_io2')
+        wrap_numbers.cache_clear('disk_io')
+        self.assertEqual(list(wrap_numbers.cache_info()[0]), ['disk_io2'])
+
     @unittest.skipIf(not HAS_NET_IO_COUNTERS, 'not supported')
     def test_cache_clear_public_apis(self):
         if not psutil.disk_io_counters() or not psutil.net_io_counters():
@@ -809,6 +885,137 @@ class TestWrapNumbers(PsutilTestCase):
         self.assertEqual(caches, ({}, {}, {}))
 
 
+# ===================================================================
+# --- Tests for BaselineStore class.
+# ===================================================================
+
+
+class TestBaselineStore(PsutilTestCase):
+
+    GLOBALS = ("_last_cpu_times", "_last_per_cpu_times",
+               "_last_cpu_times_2", "_last_per_cpu_times_2")
+
+    def setUp(self):
+        self.saved = dict((x, getattr(psutil, x)) for x in self.GLOBALS)
+        self.reset()
+        self.path = self.get_testfn()
+
+    def tearDown(self):
+        for name, value in self.saved.items():
+            setattr(psutil, name, value)
+        wrap_numbers.cache_clear()
+
+    def reset(self):
+        for name in self.GLOBALS:
+            setattr(psutil, name, None)
+        wrap_numbers.cache_clear()
+
+    def test_cpu_percent(self):
+        with psutil.BaselineStore(self.path) as store:
+            self.assertEqual(psutil.cpu_percent(), 0.0)
+            psutil.cpu_times_percent(percpu=True)
+            self.assertFalse(store.load())  # nothing saved yet
+        saved = (psutil._last_cpu_times, psutil._last_per_cpu_times_2)
+        self.reset()
+        with psutil.BaselineStore(self.path) as store:
+            self.assertEqual(psutil._last_cpu_times, saved[0])
+            self.assertEqual(psutil._last_per_cpu_times_2, saved[1])
+            self.assertIsNone(psutil._last_per_cpu_times)
+            self.assertEqual(psutil._last_cpu_times._fields,
+                             psutil.cpu_times()._fields)
+            psutil.cpu_percent()
+
+    def test_loaded_baselines_not_overwritten(self):
+        psutil.cpu_percent()
+        with psutil.BaselineStore(self.path):
+            pass
+        psutil.cpu_percent()
+        last = psutil._last_cpu_times
+        self.assertTrue(psutil.BaselineStore(self.path).load())
+        self.assertIs(psutil._last_cpu_times, last)
+
+    def test_wrap_numbers(self):
+        wrap_numbers({'disk1': nt(100, 100, 100)}, 'disk_io')
+        wrap_numbers({'disk1': nt(100, 100, 10)}, 'disk_io')
+        with psutil.BaselineStore(self.path):
+            pass
+        self.reset()
+        self.assertTrue(psutil.BaselineStore(self.path).load())
+        self.assertEqual(wrap_numbers({'disk1': nt(100, 100, 20)}, 'disk_io'),
+                         {'disk1': (100, 100, 120)})
+        self.assertEqual(wrap_numbers({'disk1': nt(100, 100, 5)}, 'disk_io'),
+                         {'disk1': (100, 100, 125)})
+
+    def test_rates(self):
+        store = psutil.BaselineStore(self.path)
+        with mock.patch("psutil._timer", return_value=100):
+            self.assertEqual(store.rates("x", nt(10, 10, 10)), (0, 0, 0))
+            self.assertEqual(store.rates("y", {'a': nt(1, 1, 1)}),
+                             {'a': (0, 0, 0)})
+        store.save()
+        store = psutil.BaselineStore(self.path)
+        self.assertTrue(store.load())
+        with mock.patch("psutil._timer", return_value=102):
+            self.assertEqual(store.rates("x", nt(20, 10, 0)), (5, 0, 0))
+            ret = store.rates("y", {'a': nt(5, 1, 1), 'b': nt(1, 1, 1)})
+        self.assertEqual(ret, {'a': (2, 0, 0), 'b': (0, 0, 0)})
+        self.assertIsInstance(ret['a'], nt)
+
+    def test_reboot(self):
+        psutil.cpu_percent()
+        with psutil.BaselineStore(self.path):
+            pass
+        self.reset()
+        with mock.patch("psutil._boot_id", return_value="foo"):
+            self.assertFalse(psutil.BaselineStore(self.path).load())
+        self.assertIsNone(psutil._last_cpu_times)
+
+    def test_invalid_file(self):
+        store = psutil.BaselineStore(self.path)
+        self.assertFalse(store.load())  # missing
+        for data in (b"", b"foo", b"x" * 100):
+            with open(self.path, "wb") as f:
+                f.write(data)
+            self.assertFalse(store.load())
+        # truncated
+        psutil.cpu_percent()
+        store.save()
+        with open(self.path, "rb") as f:
+            data = f.read()
+        with open(self.path, "wb") as f:
+            f.write(data[:-1])
+        self.reset()
+        self.assertFalse(store.load())
+        self.assertIsNone(psutil._last_cpu_times)
+
+    @unittest.skipIf(not POSIX, "POSIX only")
+    def test_permissions(self):
+        psutil.BaselineStore(self.path).save()
+        self.assertEqual(stat.S_IMODE(os.stat(self.path).st_mode), 0o600)
+
+    def test_overlapping_runs(self):
+        # save() replaces the file rather than rewriting it in place,
+        # so a concurrent reader keeps seeing a complete version
+        store = psutil.BaselineStore(self.path)
+        store.rates("x", nt(1, 1, 1))
+        store.save()
+        with open(self.path, "rb") as f:
+            store.rates("y", dict((str(i), nt(i, i, i)) for i in range(100)))
+            store.save()
+            data = f.read()
+        self.assertNotIn(b'"y"', data)
+        copy = self.get_testfn()
+        with open(copy, "wb") as f:
+            f.write(data)
+        self.assertTrue(psutil.BaselineStore(copy).load())
+        self.assertTrue(psutil.BaselineStore(self.path).load())
+        # no temporary files left behind
+        dirname, basename = os.path.split(os.path.abspath(self.path))
+        self.assertEqual(
+            [x for x in os.listdir(dirname) if x.startswith(basename)],
+            [basename])
+
+
 # ===================================================================
 # --- Example script tests
 # ===================================================================
@@ -23,6 +23,7 @@ from psutil import MACOS
 from psutil import OPENBSD
 from psutil import POSIX
 from psutil import SUNOS
+from psutil._compat import ChildProcessError
 from psutil.tests import HAS_NET_IO_COUNTERS
 from psutil.tests import PYTHON_EXE
 from psutil.tests import PsutilTestCase
@@ -410,6 +411,27 @@ class TestSystemAPIs(PsutilTestCase):
                               psutil._psposix.wait_pid, os.getpid())
             assert m.called
 
+    def test_wait_pid_rusage(self):
+        ru = resource.struct_rusage(
+            (1.5, 0.5, 2048, 0, 0, 0, 100, 2, 0, 0, 0, 0, 0, 0, 10, 3))
+        with mock.patch("psutil._psposix.os.wait4",
+                        return_value=(1, 0, ru)) as m:
+            code, ret = psutil._psposix.wait_pid(os.getpid(), rusage=True)
+            assert m.called
+        self.assertEqual(code, 0)
+        maxrss = 2048 if MACOS else 2048 * 1024
+        self.assertEqual(ret, psutil._common.prusage(
+            1.5, 0.5, maxrss, 100, 2, 10, 3))
+
+    def test_wait_pid_rusage_non_children(self):
+        with mock.patch("psutil._psposix.os.wait4",
+                        side_effect=ChildProcessError) as m:
+            self.assertEqual(
+                psutil._psposix.wait_pid(os.getpid(), rusage=True,
+                                         _pid_exists=lambda pid: False),
+                (None, None))
+            assert m.called
+
     # AIX can return '-' in df output instead of numbers, e.g. for /proc
     @unittest.skipIf(AIX, "unreliable on AIX")
     @retry_on_failure()
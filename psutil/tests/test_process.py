@@ -202,6 +202,44 @@ class TestProcess(PsutilTestCase):
             self.assertEqual(child_ret, signal.SIGTERM)
             self.assertEqual(child_ret, signal.SIGTERM)
 
+    @unittest.skipIf(not POSIX, "POSIX only")
+    def test_wait_rusage(self):
+        # burn some CPU and touch ~50MB of memory
+        cmd = [PYTHON_EXE, "-c",
+               "import time; x = bytearray(50 * 1024 * 1024); "
+               "t = time.time()\nwhile time.time() - t < 0.1: pass"]
+        p = self.spawn_psproc(cmd)
+        code, ru = p.wait(rusage=True)
+        self.assertEqual(code, 0)
+        self.assertEqual(ru._fields, psutil._common.prusage._fields)
+        self.assertGreater(ru.user + ru.system, 0)
+        self.assertGreater(ru.maxrss, 50 * 1024 * 1024)
+        self.assertGreater(ru.minor_faults, 0)
+        for value in ru:
+            self.assertGreaterEqual(value, 0)
+        # cached
+        self.assertEqual(p.wait(rusage=True), (code, ru))
+        self.assertEqual(p.wait(), code)
+        self.assertProcessGone(p)
+        # reaped without rusage
+        p = self.spawn_psproc([PYTHON_EXE, "-c", "pass"])
+        self.assertEqual(p.wait(), 0)
+        self.assertEqual(p.wait(rusage=True), (0, None))
+
+    @unittest.skipIf(not POSIX, "POSIX only")
+    def test_wait_rusage_signaled(self):
+        p = self.spawn_psproc()
+        self.assertRaises(psutil.TimeoutExpired, p.wait, 0, rusage=True)
+        p.terminate()
+        code, ru = p.wait(rusage=True)
+        self.assertEqual(code, -signal.SIGTERM)
+        self.assertIsNotNone(ru)
+
+    @unittest.skipIf(not WINDOWS, "WINDOWS only")
+    def test_wait_rusage_windows(self):
+        p = self.spawn_psproc()
+        self.assertRaises(NotImplementedError, p.wait, rusage=True)
+
     def test_wait_timeout(self):
         p = self.spawn_psproc()
         p.name()
@@ -1276,6 +1314,40 @@ class TestProcess(PsutilTestCase):
             self.assertEqual(p1.ppid(), p1_ppid)
             self.assertEqual(p2.ppid(), p2_ppid)
 
+    def test_oneshot_many(self):
+        p1, p2 = self.spawn_children_pair()
+        procs = [psutil.Process(), p1, p2]
+        ppids = [p.ppid() for p in procs]
+        with mock.patch("psutil._psplatform.Process.cpu_times") as m:
+            with psutil.oneshot_many(procs):
+                for p in procs:
+                    assert hasattr(p, "_cache")
+                    p.cpu_times()
+                    p.cpu_times()
+                self.assertEqual([p.ppid() for p in procs], ppids)
+            self.assertEqual(m.call_count, 3)
+        for p in procs:
+            assert not hasattr(p, "_cache")
+
+    def test_oneshot_many_nested(self):
+        p = psutil.Process()
+        with mock.patch("psutil._psplatform.Process.oneshot_exit") as m:
+            with p.oneshot():
+                with psutil.oneshot_many([p]):
+                    pass
+                assert not m.called
+                assert hasattr(p, "_cache")
+            self.assertEqual(m.call_count, 1)
+
+    def test_oneshot_many_gone(self):
+        sproc = self.spawn_testproc()
+        p = psutil.Process(sproc.pid)
+        p.kill()
+        p.wait()
+        with psutil.oneshot_many([psutil.Process(), p]):
+            self.assertRaises(psutil.NoSuchProcess, p.name)
+            self.assertRaises(psutil.NoSuchProcess, p.memory_info)
+
     def test_halfway_terminated_process(self):
         # Test that NoSuchProcess exception gets raised in case the
         # process dies after we create the Process object.
@@ -1591,6 +1663,17 @@ class TestPopen(PsutilTestCase):
         assert proc.stdin.closed
         self.assertEqual(proc.returncode, 0)
 
+    @unittest.skipIf(not POSIX, "POSIX only")
+    def test_wait_rusage(self):
+        cmd = [PYTHON_EXE, "-c", "import sys; sys.exit(3)"]
+        with psutil.Popen(cmd, env=PYTHON_EXE_ENV) as proc:
+            code, ru = proc.wait(rusage=True)
+        self.assertEqual(code, 3)
+        self.assertEqual(proc.returncode, 3)
+        self.assertGreater(ru.maxrss, 0)
+        self.assertEqual(proc.wait(rusage=True), (3, ru))
+        self.assertEqual(proc.wait(), 3)
+
     def test_kill_terminate(self):
         # subprocess.Popen()'s terminate(), kill() and send_signal() do
         # not raise exception after the process is gone. psutil.Popen
@@ -0,0 +1,338 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""
+Stress tests: call the public API from multiple threads and processes
+at the same time, while a "spawner" thread keeps creating and reaping
+short-lived processes. Make sure no unexpected exception is raised and
+that the results are consistent. Also print the number of calls per
+second achieved with an increasing number of threads.
+These tests are slow, so they're not run by default (see
+"make test-stress"). Their duration can be tuned via the
+PSUTIL_STRESS_DURATION env var (seconds per test).
+"""
+
+from __future__ import division
+from __future__ import print_function
+
+import os
+import subprocess
+import sys
+import threading
+import time
+import traceback
+import unittest
+
+import psutil
+from psutil import LINUX
+from psutil import POSIX
+from psutil._compat import long
+from psutil.tests import HAS_NET_IO_COUNTERS
+from psutil.tests import PYPY
+from psutil.tests import PYTHON_EXE
+from psutil.tests import PYTHON_EXE_ENV
+from psutil.tests import VALID_PROC_STATUSES
+from psutil.tests import PsutilTestCase
+from psutil.tests import process_namespace
+from psutil.tests import serialrun
+from psutil.tests import system_namespace
+
+
+DURATION = float(os.environ.get("PSUTIL_STRESS_DURATION", 3))
+NUM_THREADS = (1, 2, 4, 8)
+# how long to wait for a worker thread to stop before assuming it's
+# deadlocked
+JOIN_TIMEOUT = 60
+# attrs passed to process_iter() by all threads; note that Process
+# instances (and their "info" attribute) are shared between threads
+PROC_ITER_ATTRS = ['pid', 'ppid', 'name', 'status', 'create_time']
+# allowed exceptions when dealing with a process population which
+# keeps changing
+PROC_ERRORS = (psutil.NoSuchProcess, psutil.AccessDenied)
+# skip these system APIs as they're too slow to be called in a loop
+SLOW_SYSAPIS = ('net_connections', 'sensors_temperatures', 'sensors_fans',
+                'cpu_affinity_histogram')
+
+
+class Spawner(threading.Thread):
+    """A thread which keeps spawning short-lived processes, and
+    reaping them some time after they exit (so that some of them
+    stay around as zombies for a while).
+    """
+
+    def __init__(self):
+        super(Spawner, self).__init__(name="spawner")
+        self.daemon = True
+        self.spawned = 0
+        self._stop_ev = threading.Event()
+        self._cmd = [PYTHON_EXE, "-c", "import time; time.sleep(0.05)"]
+
+    def run(self):
+        procs = []
+        while not self._stop_ev.is_set():
+            procs.append(subprocess.Popen(self._cmd, env=PYTHON_EXE_ENV))
+            self.spawned += 1
+            if len(procs) > 10:
+                procs.pop(0).wait()
+            time.sleep(0.005)
+        for proc in procs:
+            proc.wait()
+
+    def stop(self):
+        self._stop_ev.set()
+        self.join()
+
+
+class Worker(threading.Thread):
+    """A thread which calls *fun* in a loop until told to stop,
+    recording the number of calls and the exceptions raised.
+    """
+
+    def __init__(self, fun, start_ev):
+        super(Worker, self).__init__()
+        self.daemon = True
+        self.fun = fun
+        self.calls = 0
+        self.errors = []
+        self._start_ev = start_ev
+        self._stop_ev = threading.Event()
+
+    def run(self):
+        self._start_ev.wait()
+        while not self._stop_ev.is_set():
+            try:
+                self.fun()
+            except Exception:
+                self.errors.append(traceback.format_exc())
+                if len(self.errors) > 10:
+                    break
+            self.calls += 1
+
+    def stop(self, timeout=None):
+        self._stop_ev.set()
+        self.join(timeout)
+
+
+@serialrun
+@unittest.skipIf(PYPY, "unreliable on PYPY")
+class TestStress(PsutilTestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.spawner = Spawner()
+        cls.spawner.start()
+        # Switch threads more often, so that race conditions are more
+        # likely to show up.
+        if hasattr(sys, "setswitchinterval"):
+            cls._switchinterval = sys.getswitchinterval()
+            sys.setswitchinterval(0.00001)
+
+    @classmethod
+    def tearDownClass(cls):
+        if hasattr(sys, "setswitchinterval"):
+            sys.setswitchinterval(cls._switchinterval)
+        cls.spawner.stop()
+        assert cls.spawner.spawned > 0
+
+    def run_threads(self, fun, nthreads, duration=DURATION):
+        """Run *fun* in *nthreads* threads for *duration* seconds,
+        fail in case of exception or deadlock and return the number of
+        calls per second.
+        """
+        start_ev = threading.Event()
+        workers = [Worker(fun, start_ev) for x in range(nthreads)]
+        for w in workers:
+            w.start()
+        t = time.time()
+        start_ev.set()
+        try:
+            time.sleep(duration)
+        finally:
+            for w in workers:
+                w.stop(timeout=JOIN_TIMEOUT)
+        elapsed = time.time() - t
+        stuck = [w for w in workers if w.is_alive()]
+        if stuck:
+            self.fail("%s of %s thread(s) still running after %s secs "
+                      "(deadlock?)" % (len(stuck), nthreads, JOIN_TIMEOUT))
+        errors = [err for w in workers for err in w.errors]
+        if errors:
+            self.fail("%s exception(s) raised in %s thread(s); first one "
+                      "was:\n%s" % (len(errors), nthreads, errors[0]))
+        return sum(w.calls for w in workers) / elapsed
+
+    def run_scaling(self, fun, title):
+        """Run *fun* with an increasing number of threads and print
+        the throughput achieved compared to a single thread. Only
+        exceptions and deadlocks make it fail: the throughput depends
+        on the machine load.
+        """
+        base = None
+        lines = []
+        for n in NUM_THREADS:
+            rate = self.run_threads(fun, n)
+            if base is None:
+                base = rate
+            lines.append("    %s threads: %10.1f calls/sec  x%.2f" % (
+                n, rate, rate / base))
+        print("\n%s:\n%s" % (title, "\n".join(lines)), file=sys.stderr)
+
+    # --- system APIs
+
+    def test_system_apis(self):
+        def fun():
+            for getter, name in system_namespace.iter(getters):
+                getter()
+
+        getters = [x for x in system_namespace.getters
+                   if x[0] not in SLOW_SYSAPIS]
+        self.run_scaling(fun, "system APIs")
+
+    def test_cpu_percent(self):
+        # cpu_percent() and cpu_times_percent() share global state
+        # between calls (and threads)
+        def fun():
+            for value in [psutil.cpu_percent()] + \
+                    psutil.cpu_percent(percpu=True):
+                assert 0.0 <= value <= 100.0, value
+            for value in psutil.cpu_times_percent():
+                assert 0.0 <= value <= 100.0, value
+
+        self.run_scaling(fun, "cpu_percent()")
+
+    def test_virtual_memory(self):
+        def fun():
+            mem = psutil.virtual_memory()
+            assert mem.total == total, mem
+            assert 0 <= mem.available <= mem.total, mem
+            assert 0.0 <= mem.percent <= 100.0, mem
+
+        total = psutil.virtual_memory().total
+        self.run_scaling(fun, "virtual_memory()")
+
+    @unittest.skipIf(not HAS_NET_IO_COUNTERS, "not supported")
+    def test_io_counters_monotonic(self):
+        # net_io_counters() and disk_io_counters() use wrap_numbers(),
+        # which keeps shared state. Within a thread, values must never
+        # go backwards.
+        def fun():
+            last = local.__dict__.setdefault('last', {})
+            for name, nt in psutil.net_io_counters(pernic=True).items():
+                prev = last.get(name)
+                if prev is not None:
+                    assert nt.bytes_recv >= prev.bytes_recv, (prev, nt)
+                    assert nt.bytes_sent >= prev.bytes_sent, (prev, nt)
+                last[name] = nt
+            psutil.disk_io_counters(perdisk=True)
+
+        local = threading.local()
+        self.run_scaling(fun, "net_io_counters() + disk_io_counters()")
+
+    def test_pids(self):
+        def fun():
+            pids = psutil.pids()
+            assert pids == sorted(set(pids)), pids
+            for pid in pids:
+                assert isinstance(pid, (int, long)), pid
+
+        self.run_scaling(fun, "pids()")
+
+    # --- process APIs
+
+    def test_process_iter(self):
+        # process_iter() updates a global Process instances table
+        def fun():
+            prev = -1
+            for proc in psutil.process_iter(PROC_ITER_ATTRS):
+                assert proc.pid > prev, (proc.pid, prev)
+                prev = proc.pid
+                assert sorted(proc.info) == sorted(PROC_ITER_ATTRS), \
+                    proc.info
+                if proc.info['pid'] is not None:
+                    assert proc.info['pid'] == proc.pid, proc.info
+
+        self.run_scaling(fun, "process_iter()")
+
+    def test_process_apis(self):
+        # call all Process getters against new and cached processes
+        def fun():
+            for proc in psutil.process_iter():
+                ns = process_namespace(proc)
+                for getter, name in ns.iter(ns.getters, clear_cache=False):
+                    try:
+                        getter()
+                    except PROC_ERRORS:
+                        break
+
+        self.run_threads(fun, max(NUM_THREADS))
+
+    def test_shared_process_oneshot(self):
+        # Multiple threads using the same Process instance, both inside
+        # and outside oneshot() (see issue #1948).
+        def fun():
+            with proc.oneshot():
+                self.assertEqual(proc.name(), name)
+                self.assertEqual(proc.ppid(), ppid)
+                proc.cpu_times()
+                proc.memory_info()
+            self.assertEqual(proc.name(), name)
+            self.assertIn(proc.status(), VALID_PROC_STATUSES)
+            assert proc.cpu_percent() >= 0.0
+
+        proc = psutil.Process()
+        name = proc.name()
+        ppid = proc.ppid()
+        self.run_scaling(fun, "Process.oneshot() (same instance)")
+
+    def test_children(self):
+        def fun():
+            for child in me.children():
+                try:
+                    self.assertEqual(child.ppid(), me.pid)
+                except PROC_ERRORS:
+                    pass
+
+        me = psutil.Process()
+        self.run_threads(fun, max(NUM_THREADS))
+
+    @unittest.skipIf(not POSIX, "POSIX only")
+    def test_multiple_processes(self):
+        # Same as above, using processes instead of threads.
+        src = (
+            "import time, psutil\n"
+            "stop_at = time.time() + %s\n"
+            "while time.time() < stop_at:\n"
+            "    for p in psutil.process_iter(%r):\n"
+            "        pass\n"
+            "    for p in psutil.process_iter():\n"
+            "        try:\n"
+            "            p.as_dict()\n"
+            "        except psutil.NoSuchProcess:\n"
+            "            pass\n" % (DURATION, PROC_ITER_ATTRS))
+        procs = [subprocess.Popen([PYTHON_EXE, "-c", src],
+                                  env=PYTHON_EXE_ENV,
+                                  stderr=subprocess.PIPE)
+                 for x in range(max(NUM_THREADS))]
+        for proc in procs:
+            _, stderr = proc.communicate()
+            self.assertEqual(proc.returncode, 0, msg=stderr)
+
+    @unittest.skipIf(not LINUX, "LINUX only")
+    def test_threads(self):
+        def fun():
+            for proc in psutil.process_iter():
+                try:
+                    proc.threads()
+                    proc.num_threads()
+                except PROC_ERRORS:
+                    pass
+
+        self.run_threads(fun, max(NUM_THREADS))
+
+
+if __name__ == '__main__':
+    from psutil.tests.runner import run_from_name
+    run_from_name(__file__)
@@ -12,10 +12,12 @@ import errno
 import os
 import platform
 import pprint
+import re
 import shutil
 import signal
 import socket
 import sys
+import threading
 import time
 import unittest
 
@@ -99,6 +101,88 @@ class TestProcessAPIs(PsutilTestCase):
                 self.assertGreaterEqual(p.info['pid'], 0)
             assert m.called
 
+    def test_process_iter_lazy(self):
+        with self.assertRaises(ValueError):
+            list(psutil.process_iter(attrs=['foo'], lazy=True))
+        with mock.patch("psutil._psplatform.Process.cpu_times",
+                        side_effect=psutil.AccessDenied(0, "")) as m:
+            flag = object()
+            for p in psutil.process_iter(
+                    attrs=["pid", "cpu_times", "pid"], ad_value=flag,
+                    lazy=True):
+                self.assertEqual(list(p.info), ["pid", "cpu_times"])
+                self.assertEqual(p.info['pid'], p.pid)
+                self.assertNotIn('name', p.info)
+                self.assertRaises(KeyError, lambda: p.info['name'])
+            assert not m.called
+            self.assertIs(p.info['cpu_times'], flag)
+            assert m.called
+
+    def test_process_iter_lazy_fetch_once(self):
+        # attributes are retrieved on access, only once and within a
+        # oneshot() context
+        me = psutil.Process()
+        with mock.patch("psutil._psplatform.Process.oneshot_enter") as m1:
+            with mock.patch("psutil._psplatform.Process.name",
+                            return_value="foo") as m2:
+                for p in psutil.process_iter(attrs=["name"], lazy=True):
+                    if p.pid == me.pid:
+                        assert not m2.called
+                        self.assertEqual(p.info['name'], "foo")
+                        self.assertEqual(p.info['name'], "foo")
+                        self.assertEqual(m2.call_count, 1)
+                        break
+        assert m1.called
+        self.assertEqual(dict(p.info), {'name': 'foo'})
+
+    def test_process_iter_lazy_shared_cache(self):
+        # attributes accessed at different times share the same
+        # oneshot() cache
+        orig = psutil._psplatform.Process.memory_info
+        with mock.patch("psutil._psplatform.Process.memory_info",
+                        autospec=True, side_effect=orig) as m:
+            for p in psutil.process_iter(
+                    attrs=["memory_info", "memory_percent"], lazy=True):
+                if p.pid == os.getpid():
+                    p.info["memory_info"]
+                    p.info["memory_percent"]
+                    break
+        self.assertEqual(m.call_count, 1)
+
+    def test_process_iter_lazy_no_lock(self):
+        # the yielded process is not locked while the loop body runs
+        for p in psutil.process_iter(attrs=["name"], lazy=True):
+            if p.pid == os.getpid():
+                p.info["name"]
+                t = threading.Thread(target=p.as_dict, args=(["name"], ))
+                t.start()
+                t.join(GLOBAL_TIMEOUT)
+                self.assertFalse(t.is_alive())
+                break
+        else:
+            raise self.fail("process not found")
+
+    def test_process_iter_lazy_all_attrs(self):
+        for p in psutil.process_iter(attrs=[], lazy=True):
+            if p.pid == os.getpid():
+                info = dict(p.info)
+                self.assertEqual(set(info), set(p.as_dict()))
+                self.assertEqual(info['name'], p.name())
+                break
+        else:
+            raise self.fail("process not found")
+
+    def test_process_iter_lazy_gone(self):
+        sproc = self.spawn_testproc()
+        for p in psutil.process_iter(attrs=["name"], lazy=True):
+            if p.pid == sproc.pid:
+                p.kill()
+                p.wait()
+                self.assertIsNone(p.info["name"])
+                break
+        else:
+            raise self.fail("process not found")
+
     @unittest.skipIf(PYPY and WINDOWS,
                      "spawn_testproc() unreliable on PYPY + WINDOWS")
     def test_wait_procs(self):
@@ -191,6 +275,27 @@ class TestProcessAPIs(PsutilTestCase):
         for pid in pids:
             self.assertFalse(psutil.pid_exists(pid), msg=pid)
 
+    def test_pids_since(self):
+        pids = psutil.pids()
+        sproc = self.spawn_testproc()
+        cur, new, gone = psutil.pids_since(pids + [-1])
+        self.assertIn(sproc.pid, cur)
+        self.assertIn(sproc.pid, new)
+        self.assertIn(-1, gone)
+        self.assertEqual(cur, sorted(cur))
+        self.assertEqual(new, sorted(set(cur) - set(pids)))
+        self.assertEqual(gone, sorted(set(pids + [-1]) - set(cur)))
+
+        p = psutil.Process(sproc.pid)
+        p.kill()
+        p.wait()
+        cur2, new, gone = psutil.pids_since(set(cur))
+        self.assertNotIn(sproc.pid, cur2)
+        self.assertIn(sproc.pid, gone)
+        cur, new, gone = psutil.pids_since([])
+        self.assertEqual(new, cur)
+        self.assertEqual(gone, [])
+
 
 class TestMiscAPIs(PsutilTestCase):
 
@@ -200,6 +305,21 @@ class TestMiscAPIs(PsutilTestCase):
         self.assertGreater(bt, 0)
         self.assertLess(bt, time.time())
 
+    def test_collect(self):
+        names = ["cpu_times", "per_cpu_times", "cpu_stats", "cpu_count",
+                 "boot_time", "virtual_memory", "swap_memory"]
+        ret = psutil.collect(names)
+        self.assertEqual(sorted(ret), sorted(names))
+        self.assertEqual(type(ret["cpu_times"]), type(psutil.cpu_times()))
+        self.assertEqual(len(ret["per_cpu_times"]),
+                         len(psutil.cpu_times(percpu=True)))
+        self.assertEqual(ret["cpu_count"], psutil.cpu_count())
+        self.assertEqual(ret["virtual_memory"].total,
+                         psutil.virtual_memory().total)
+        self.assertEqual(psutil.collect([]), {})
+        self.assertRaises(ValueError, psutil.collect, ["foo"])
+        self.assertRaises(TypeError, psutil.collect, "cpu_times")
+
     @unittest.skipIf(CI_TESTING and not psutil.users(), "unreliable on CI")
     def test_users(self):
         users = psutil.users()
@@ -489,6 +609,28 @@ class TestCpuAPIs(PsutilTestCase):
                 self._test_cpu_percent(sum(cpu), last, new)
             last = new
 
+    def test_cpu_percent_per(self):
+        self.assertEqual(
+            len(psutil.cpu_percent(interval=0.001, per="cpu")),
+            psutil.cpu_count())
+        self.assertEqual(
+            len(psutil.cpu_times_percent(interval=0.001, per="cpu")),
+            psutil.cpu_count())
+        for per in ("core", "socket", "numa"):
+            try:
+                ret = psutil.cpu_percent(interval=0.001, per=per)
+            except NotImplementedError:
+                assert not LINUX
+                continue
+            self.assertGreaterEqual(len(ret), 1)
+            for percent in ret.values():
+                self._test_cpu_percent(percent, None, None)
+            for cpu in psutil.cpu_times_percent(per=per).values():
+                for percent in cpu:
+                    self._test_cpu_percent(percent, None, None)
+        self.assertRaises(ValueError, psutil.cpu_percent, per="foo")
+        self.assertRaises(ValueError, psutil.cpu_times_percent, per="foo")
+
     def test_per_cpu_times_percent_negative(self):
         # see: https://github.com/giampaolo/psutil/issues/645
         psutil.cpu_times_percent(percpu=True)
@@ -679,6 +821,17 @@ class TestDiskAPIs(PsutilTestCase):
             assert key, key
             check_ntuple(ret[key])
 
+    def test_disk_io_counters_filters(self):
+        disks = psutil.disk_io_counters(perdisk=True)
+        if not disks:
+            return self.skipTest("no disks available")
+        name = sorted(disks)[0]
+        ret = psutil.disk_io_counters(perdisk=True, include=[name])
+        self.assertEqual(list(ret), [name])
+        ret = psutil.disk_io_counters(perdisk=True, exclude=name)
+        self.assertEqual(sorted(ret), sorted(disks)[1:])
+        self.assertIsNone(psutil.disk_io_counters(include="?!?"))
+
     def test_disk_io_counters_no_disks(self):
         # Emulate a case where no disks are installed, see:
         # https://github.com/giampaolo/psutil/issues/1062
@@ -720,6 +873,24 @@ class TestNetAPIs(PsutilTestCase):
             self.assertIsInstance(key, str)
             check_ntuple(ret[key])
 
+    @unittest.skipIf(not HAS_NET_IO_COUNTERS, 'not supported')
+    def test_net_io_counters_filters(self):
+        nics = psutil.net_io_counters(pernic=True)
+        if not nics:
+            return self.skipTest("no NICs available")
+        name = sorted(nics)[0]
+        ret = psutil.net_io_counters(pernic=True, include=name)
+        self.assertEqual(list(ret), [name])
+        ret = psutil.net_io_counters(pernic=True, exclude=[name])
+        self.assertEqual(sorted(ret), sorted(nics)[1:])
+        ret = psutil.net_io_counters(pernic=True, include="*",
+                                     exclude=re.compile(".*"))
+        self.assertEqual(ret, {})
+        self.assertIsNone(psutil.net_io_counters(include="?!?"))
+        self.assertEqual(list(psutil.net_if_addrs(include=name)), [name])
+        self.assertNotIn(name, psutil.net_if_stats(exclude=name))
+        self.assertRaises(TypeError, psutil.net_io_counters, include=[1])
+
     @unittest.skipIf(not HAS_NET_IO_COUNTERS, 'not supported')
     def test_net_io_counters_no_nics(self):
         # Emulate a case where no NICs are installed, see:
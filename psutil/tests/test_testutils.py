@@ -26,6 +26,7 @@ from psutil import POSIX
 from psutil._common import open_binary
 from psutil._common import open_text
 from psutil._common import supports_ipv6
+from psutil._compat import PY3
 from psutil.tests import CI_TESTING
 from psutil.tests import COVERAGE
 from psutil.tests import HAS_CONNECTIONS_UNIX
@@ -417,6 +418,55 @@ class TestMemLeakClass(TestMemoryLeak):
         with self.assertRaises(AssertionError):
             self.execute_w_exc(ZeroDivisionError, fun_2)
 
+    @unittest.skipIf(not PY3, "tracemalloc not available")
+    def test_alloc_stats(self):
+        def fun():
+            # transient allocation
+            "x" * 64 * 1024
+
+        self.alloc_stats = []
+        self.execute(fun, times=10)
+        self.assertEqual(len(self.alloc_stats), 1)
+        test_id, stats = self.alloc_stats[0]
+        self.assertEqual(test_id, self.id())
+        self.assertEqual(stats.calls, 10)
+        self.assertGreaterEqual(stats.blocks, 1)
+        self.assertLess(stats.objects, 1)  # str is not GC-tracked
+        self.assertGreaterEqual(stats.peak, 64 * 1024)
+        self.assertEqual(stats.fds, 0)
+
+    @unittest.skipIf(not PY3, "tracemalloc not available")
+    def test_alloc_stats_churn(self):
+        # objects which are allocated and freed on every call are
+        # counted, although nothing is retained
+        class Foo:
+            pass
+
+        def fun():
+            for x in range(1000):
+                obj = Foo()
+            del obj
+
+        stats = self._get_alloc_stats(fun, times=10)
+        self.assertGreaterEqual(stats.blocks, 1000)
+        self.assertGreaterEqual(stats.objects, 1000)
+
+    @unittest.skipIf(not PY3, "tracemalloc not available")
+    def test_alloc_stats_noop(self):
+        stats = self._get_alloc_stats(lambda: None, times=10)
+        self.assertLess(stats.blocks, 1)
+        self.assertLess(stats.objects, 1)
+
+    @unittest.skipIf(not PY3, "tracemalloc not available")
+    def test_alloc_stats_retained(self):
+        def fun():
+            ls.append([])
+
+        ls = []
+        stats = self._get_alloc_stats(fun, times=100)
+        self.assertGreaterEqual(stats.blocks, 1)
+        self.assertGreaterEqual(stats.objects, 1)
+
 
 class TestTestingUtils(PsutilTestCase):
 
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""
+Run the memory leak test suite (psutil/tests/test_memleaks.py) and print
+an allocation budget for every API, sorted by allocated blocks:
+
+- BLOCKS: memory blocks allocated by a call, including the ones freed
+  before returning (per-call average)
+- OBJS: GC-tracked Python objects created by a call, freed or not
+  (per-call average)
+- PEAK: transient memory allocated while executing a single call
+- FDS: file descriptors / handles left open
+
+Leaks (memory retained across calls) are detected by the test suite
+itself; this measures allocation churn.
+
+Requires Python >= 3.4 (tracemalloc).
+
+$ make print-alloc-budget
+API                                     CALLS   BLOCKS     OBJS     PEAK  FDS
+-----------------------------------------------------------------------------
+Process.memory_maps                        30 44689.20 16762.60   553.1K    0
+psutil.kernel_memory                       30  3154.20  1280.60   123.7K    0
+psutil.net_connections                     30  1769.60   836.60    78.3K    0
+psutil.pid_namespace_map                   30  1070.60   628.20    75.3K    0
+Process.connections                        30   704.00   279.80    73.0K    0
+...
+"""
+
+from __future__ import division
+from __future__ import print_function
+
+import argparse
+import sys
+import unittest
+
+from psutil._common import bytes2human
+from psutil._common import print_color
+from psutil.tests import TestMemoryLeak
+from psutil.tests import test_memleaks
+
+
+TIMES = 30
+templ = "%-38s %6s %8s %8s %8s %4s"
+prefixes = {
+    "TestProcessObjectLeaks": "Process",
+    "TestTerminatedProcessLeaks": "Process (terminated)",
+    "TestProcessDualImplementation": "Process (dual impl.)",
+    "TestModuleFunctionsLeaks": "psutil",
+}
+
+
+def api_name(test_id):
+    _, clsname, meth = test_id.rsplit('.', 2)
+    if meth.startswith("test_"):
+        meth = meth[5:]
+    return "%s.%s" % (prefixes.get(clsname, clsname), meth)
+
+
+def collect(times):
+    """Run all memleak tests and return a {api: alloc_stats} dict.
+    If a test calls execute() more than once, the worst result is kept.
+    """
+    results = []
+    TestMemoryLeak.alloc_stats = results
+    TestMemoryLeak.verbose = False
+    suite = unittest.defaultTestLoader.loadTestsFromModule(test_memleaks)
+    for test in unittest.TestSuite(suite):
+        for case in test:
+            type(case).times = times
+    runner = unittest.TextTestRunner(stream=sys.stderr, verbosity=0)
+    result = runner.run(suite)
+    ret = {}
+    for test_id, stats in results:
+        name = api_name(test_id)
+        if name not in ret or stats.blocks > ret[name].blocks:
+            ret[name] = stats
+    return ret, result
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument('-t', '--times', type=int, default=TIMES)
+    args = parser.parse_args()
+    assert args.times >= 1, args.times
+    if sys.version_info < (3, 4):
+        sys.exit("tracemalloc module is not available")
+
+    budget, result = collect(args.times)
+    header = templ % ("API", "CALLS", "BLOCKS", "OBJS", "PEAK", "FDS")
+    print_color(header, color=None, bold=True)
+    print("-" * len(header))
+    for name, stats in sorted(budget.items(),
+                              key=lambda x: (x[1].blocks, x[0]), reverse=True):
+        s = templ % (name, stats.calls, "%.2f" % stats.blocks,
+                     "%.2f" % stats.objects, bytes2human(stats.peak),
+                     stats.fds)
+        if stats.fds:
+            print_color(s, color="red")
+        else:
+            print(s)
+    if not result.wasSuccessful():
+        print_color("\nWARN: %s memory leak test(s) failed" % (
+            len(result.failures) + len(result.errors)), color="red")
+
+
+if __name__ == '__main__':
+    main()
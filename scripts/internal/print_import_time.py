@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+
+# Copyright (c) 2009, Giampaolo Rodola'. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""
+Benchmark "import psutil" in fresh interpreters and print how long it
+takes and which /proc and /sys files are read while importing it (the
+goal is none, as short-lived scripts pay for them on every run).
+
+$ make print-import-time
+RUNS            MIN       MEDIAN          MAX
+---------------------------------------------
+10         10.42 ms     10.97 ms     12.80 ms
+
+/proc and /sys files read on import: 0
+"""
+
+from __future__ import division
+from __future__ import print_function
+
+import argparse
+import json
+import subprocess
+import sys
+
+from psutil._common import print_color
+
+
+TIMES = 10
+templ = "%-6s %12s %12s %12s"
+CODE = """
+import json
+import os
+import time
+try:
+    import builtins
+except ImportError:
+    import __builtin__ as builtins
+
+opened = []
+
+def wrap(fun):
+    def wrapper(name, *args, **kwargs):
+        if str(name).startswith(("/proc", "/sys")):
+            opened.append(str(name))
+        return fun(name, *args, **kwargs)
+    return wrapper
+
+builtins.open = wrap(builtins.open)
+os.open = wrap(os.open)
+t = time.time()
+import psutil  # noqa
+elapsed = time.time() - t
+print(json.dumps({"elapsed": elapsed, "opened": opened}))
+"""
+
+
+def run():
+    out = subprocess.check_output([sys.executable, "-c", CODE])
+    return json.loads(out.decode())
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument('-t', '--times', type=int, default=TIMES)
+    args = parser.parse_args()
+    assert args.times > 0, args.times
+
+    results = [run() for x in range(args.times)]
+    times = sorted(x["elapsed"] * 1000 for x in results)
+    s = templ % ("RUNS", "MIN", "MEDIAN", "MAX")
+    print_color(s, color=None, bold=True)
+    print("-" * len(s))
+    print(templ % (len(times), "%.2f ms" % times[0],
+                   "%.2f ms" % times[len(times) // 2],
+                   "%.2f ms" % times[-1]))
+
+    opened = results[0]["opened"]
+    print("")
+    print("/proc and /sys files read on import: %s" % len(opened))
+    for name in opened:
+        print_color("    " + name, color="red")
+
+
+if __name__ == '__main__':
+    main()
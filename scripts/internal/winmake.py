@@ -475,6 +475,12 @@ def test_memleaks():
     sh("%s psutil\\tests\\test_memleaks.py" % PYTHON)
 
 
+def test_stress():
+    """Run multi-threaded stress tests"""
+    build()
+    sh("%s psutil\\tests\\test_stress.py" % PYTHON)
+
+
 def install_git_hooks():
     """Install GIT pre-commit hook."""
     if os.path.isdir('.git'):
@@ -577,6 +583,7 @@ def parse_args():
     sp.add_parser('test-misc', help="run misc tests")
     sp.add_parser('test-platform', help="run windows only tests")
     sp.add_parser('test-process', help="run process tests")
+    sp.add_parser('test-stress', help="run multi-threaded stress tests")
     sp.add_parser('test-system', help="run system tests")
     sp.add_parser('test-unicode', help="run unicode tests")
     sp.add_parser('test-testutils', help="run test utils tests")
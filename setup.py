@@ -303,11 +303,27 @@ elif LINUX:
     # see: https://github.com/giampaolo/psutil/issues/659
     if not unix_can_compile("#include <linux/ethtool.h>"):
         macros.append(("PSUTIL_ETHTOOL_MISSING_TYPES", 1))
+    # io_uring(7) with IORING_OP_OPENAT / IORING_OP_CLOSE (Linux >= 5.6)
+    if unix_can_compile(
+            "#include <linux/io_uring.h>\n"
+            "int main() { return IORING_OP_CLOSE; }"):
+        macros.append(("PSUTIL_HAVE_IO_URING", 1))
 
     macros.append(("PSUTIL_LINUX", 1))
     ext = Extension(
         'psutil._psutil_linux',
-        sources=sources + ['psutil/_psutil_linux.c'],
+        sources=sources + [
+            'psutil/_psutil_linux.c',
+            'psutil/arch/linux/fdscan.c',
+            'psutil/arch/linux/kmem.c',
+            'psutil/arch/linux/pageidle.c',
+            'psutil/arch/linux/pids.c',
+            'psutil/arch/linux/readfiles.c',
+            'psutil/arch/linux/schedstat.c',
+            'psutil/arch/linux/taskstats.c',
+            'psutil/arch/linux/tstates.c',
+            'psutil/arch/linux/vmstat.c',
+        ],
         define_macros=macros,
         **py_limited_api)
 